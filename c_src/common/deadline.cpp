@@ -0,0 +1,48 @@
+#include "deadline.h"
+#include <time.h>
+
+XAPIAN_ERLANG_NS_BEGIN
+
+/* How often DeadlineMatchDecider asks the clock. */
+#define DEADLINE_CHECK_INTERVAL 16
+
+
+uint64_t
+monotonicNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000
+         + static_cast<uint64_t>(ts.tv_nsec) / 1000;
+}
+
+
+Deadline::Deadline(uint32_t timeout)
+{
+    m_at = timeout ? (monotonicNow() + static_cast<uint64_t>(timeout) * 1000) : 0;
+}
+
+
+bool
+Deadline::isExpired() const
+{
+    return isSet() && monotonicNow() >= m_at;
+}
+
+
+bool
+DeadlineMatchDecider::operator()(const Xapian::Document& doc) const
+{
+    if (m_is_expired)
+        return false;
+
+    if (++m_call_count % DEADLINE_CHECK_INTERVAL == 0 
+        && m_deadline.isExpired())
+    {
+        m_is_expired = true;
+        return false;
+    }
+    return mp_next == NULL || (*mp_next)(doc);
+}
+
+XAPIAN_ERLANG_NS_END
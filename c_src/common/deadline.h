@@ -0,0 +1,108 @@
+#ifndef XAPIAN_DEADLINE_H
+#define XAPIAN_DEADLINE_H
+
+#include <xapian.h>
+#include <stdint.h>
+
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * The monotonic clock in microseconds.
+ */
+uint64_t
+monotonicNow();
+
+
+/**
+ * A moment, after which a long operation should be stopped.
+ * Erlang passes a relative timeout in milliseconds, 0 means "no limit".
+ * The monotonic clock is used.
+ */
+class Deadline
+{
+    /* In microseconds, 0 if the limit is not set. */
+    uint64_t m_at;
+
+    public:
+    Deadline() : m_at(0) {}
+
+    explicit
+    Deadline(uint32_t timeout);
+
+    /**
+     * A deadline, which has already passed. Used in tests.
+     */
+    static Deadline
+    passed()
+    {
+        Deadline deadline;
+        deadline.m_at = 1;
+        return deadline;
+    }
+
+    bool
+    isSet() const
+    {
+        return m_at != 0;
+    }
+
+    /**
+     * Returns false, if the limit is not set.
+     */
+    bool
+    isExpired() const;
+};
+
+
+/**
+ * Accepts documents, until the deadline is passed.
+ * After that, all candidates are rejected and the match finishes 
+ * with what it has already collected.
+ *
+ * It truncates the result, but it does not stop the matcher: Xapian 1.2
+ * calls the decider after the weight of a candidate is calculated, and
+ * the posting lists are still read until the end. So, the time of 
+ * the match is not bounded by the deadline, only cheaper after it.
+ * An exception would stop it, but the collected documents would be lost.
+ * The clock is checked once per @ref DEADLINE_CHECK_INTERVAL calls.
+ * Before the deadline, documents are checked by @a p_next, if it is set.
+ */
+class DeadlineMatchDecider : public Xapian::MatchDecider
+{
+    const Deadline& m_deadline;
+    const Xapian::MatchDecider* mp_next;
+    mutable uint32_t m_call_count;
+    mutable bool m_is_expired;
+
+    public:
+    DeadlineMatchDecider(const Deadline& deadline, 
+                         const Xapian::MatchDecider* p_next = NULL)
+        : m_deadline(deadline), mp_next(p_next), 
+          m_call_count(0), m_is_expired(false)
+    {}
+
+    /**
+     * Returns false, if neither the deadline nor @a p_next is set,
+     * that is, the decider is not needed.
+     */
+    bool
+    isUsed() const
+    {
+        return m_deadline.isSet() || mp_next != NULL;
+    }
+
+    bool operator()(const Xapian::Document& doc) const;
+
+    /**
+     * Returns true, if at least one document was rejected.
+     */
+    bool
+    isExpired() const
+    {
+        return m_is_expired;
+    }
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
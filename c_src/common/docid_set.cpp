@@ -0,0 +1,139 @@
+#include "docid_set.h"
+#include <algorithm>
+
+XAPIAN_ERLANG_NS_BEGIN
+
+/* A sorted array of more low bits takes more space than a bitmap. */
+#define DOCID_SET_MAX_ARRAY_SIZE 4096
+#define DOCID_SET_BITMAP_WORDS   2048
+
+
+void
+DocIdSet::append(Xapian::docid docid)
+{
+    const uint16_t high = static_cast<uint16_t>(docid >> 16);
+    const uint16_t low  = static_cast<uint16_t>(docid & 0xFFFF);
+    if (m_containers.empty() || m_containers.back().key != high)
+    {
+        m_containers.push_back(Container());
+        m_containers.back().key = high;
+    }
+
+    Container& c = m_containers.back();
+    if (c.bitmap.empty())
+    {
+        c.array.push_back(low);
+        if (c.array.size() > DOCID_SET_MAX_ARRAY_SIZE)
+            convertToBitmap(c);
+    }
+    else
+        c.bitmap[low >> 5] |= 1u << (low & 31);
+    m_size++;
+}
+
+
+void
+DocIdSet::convertToBitmap(Container& c)
+{
+    c.bitmap.assign(DOCID_SET_BITMAP_WORDS, 0);
+    for (size_t i = 0; i < c.array.size(); i++)
+    {
+        const uint16_t low = c.array[i];
+        c.bitmap[low >> 5] |= 1u << (low & 31);
+    }
+    std::vector<uint16_t>().swap(c.array);
+}
+
+
+void
+DocIdSet::compact()
+{
+    std::vector<Container>(m_containers).swap(m_containers);
+    for (size_t i = 0; i < m_containers.size(); i++)
+    {
+        std::vector<uint16_t>& array = m_containers[i].array;
+        std::vector<uint16_t>(array).swap(array);
+    }
+}
+
+
+size_t
+DocIdSet::memory() const
+{
+    size_t bytes = sizeof(DocIdSet)
+                 + m_containers.capacity() * sizeof(Container);
+    for (size_t i = 0; i < m_containers.size(); i++)
+    {
+        const Container& c = m_containers[i];
+        bytes += c.array.capacity()  * sizeof(uint16_t)
+               + c.bitmap.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+
+void
+DocIdSet::release(DocIdSet* p_set)
+{
+    if (p_set != NULL && --p_set->m_refs == 0)
+        delete p_set;
+}
+
+
+Xapian::docid
+DocIdSet::Cursor::skipTo(Xapian::docid docid)
+{
+    const std::vector<Container>& containers = mp_set->m_containers;
+    const uint16_t high = static_cast<uint16_t>(docid >> 16);
+    uint32_t low = docid & 0xFFFF;
+
+    // Containers before the current one are passed already.
+    while (m_container < containers.size()
+        && containers[m_container].key < high)
+    {
+        m_container++;
+        m_pos = 0;
+    }
+
+    for (; m_container < containers.size(); m_container++, m_pos = 0)
+    {
+        const Container& c = containers[m_container];
+        // All docids of the next containers are greater.
+        if (c.key > high)
+            low = 0;
+        const Xapian::docid base = static_cast<Xapian::docid>(c.key) << 16;
+
+        if (c.bitmap.empty())
+        {
+            std::vector<uint16_t>::const_iterator i = std::lower_bound(
+                c.array.begin() + m_pos, c.array.end(), low);
+            m_pos = static_cast<uint32_t>(i - c.array.begin());
+            if (i != c.array.end())
+                return base | *i;
+        }
+        else
+        {
+            uint32_t bit = std::max(low, m_pos);
+            while (bit < DOCID_SET_BITMAP_WORDS * 32)
+            {
+                uint32_t word = c.bitmap[bit >> 5] >> (bit & 31);
+                if (word == 0)
+                {
+                    // Go to the next word.
+                    bit = (bit | 31) + 1;
+                    continue;
+                }
+                while ((word & 1) == 0)
+                {
+                    word >>= 1;
+                    bit++;
+                }
+                m_pos = bit;
+                return base | bit;
+            }
+        }
+    }
+    return 0;
+}
+
+XAPIAN_ERLANG_NS_END
@@ -0,0 +1,112 @@
+#ifndef XAPIAN_DOCID_SET_H
+#define XAPIAN_DOCID_SET_H
+
+// External imports
+#include <xapian.h>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// Internal imports
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * A compressed set of docids, as Roaring bitmaps are.
+ *
+ * Docids are split by the high 16 bits into containers. A container keeps
+ * the low 16 bits as a sorted array, while it has few docids,
+ * and as a bitmap of 65536 bits otherwise. Both forms take at most 8KB.
+ *
+ * The set is filled once and is shared by posting sources,
+ * it is counted by references. References are not atomic,
+ * the set is used by one thread.
+ */
+class DocIdSet
+{
+    struct Container
+    {
+        uint16_t                key;
+        std::vector<uint16_t>   array;
+        std::vector<uint32_t>   bitmap;
+    };
+
+    std::vector<Container>  m_containers;
+    Xapian::doccount        m_size;
+    unsigned                m_refs;
+
+    /// Copy is not allowed.
+    DocIdSet(const DocIdSet&);
+    DocIdSet& operator=(const DocIdSet&);
+
+    static void
+    convertToBitmap(Container& c);
+
+    public:
+    /**
+     * Walks over the set forward.
+     */
+    class Cursor
+    {
+        const DocIdSet* mp_set;
+        size_t          m_container;
+        /* An index in the array or a bit in the bitmap. */
+        uint32_t        m_pos;
+
+        public:
+        Cursor(const DocIdSet* p_set)
+        : mp_set(p_set), m_container(0), m_pos(0)
+        {}
+
+        /**
+         * Returns the first docid, which is not less than @a docid,
+         * or 0 at the end. Docids must not decrease between calls.
+         */
+        Xapian::docid
+        skipTo(Xapian::docid docid);
+    };
+
+    /**
+     * The creator has the first reference.
+     */
+    DocIdSet() : m_size(0), m_refs(1) {}
+
+    /**
+     * Docids are added in the ascending order.
+     */
+    void
+    append(Xapian::docid docid);
+
+    /**
+     * Free the reserved space, it is called after the last @ref append.
+     */
+    void
+    compact();
+
+    Xapian::doccount
+    size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * Returns the count of allocated bytes.
+     */
+    size_t
+    memory() const;
+
+    void
+    retain()
+    {
+        m_refs++;
+    }
+
+    /**
+     * Deletes the set, when the last reference is released.
+     */
+    static void
+    release(DocIdSet* p_set);
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
@@ -0,0 +1,54 @@
+#include "field_encoder.h"
+
+XAPIAN_ERLANG_NS_BEGIN
+
+FieldEncoder&
+FieldEncoder::operator<<(const std::string& str)
+{
+    if (!m_is_compact)
+    {
+        m_result << str;
+        return *this;
+    }
+
+    const uint32_t len = static_cast<uint32_t>( str.length() );
+    m_result.putVarint(len);
+    m_result.put(str.data(), len);
+    return *this;
+}
+
+
+FieldEncoder&
+FieldEncoder::operator<<(uint32_t value)
+{
+    if (m_is_compact)
+        m_result.putVarint(value);
+    else
+        m_result << value;
+    return *this;
+}
+
+
+void
+FieldEncoder::positions(const Xapian::TermIterator& iter)
+{
+    const Xapian::termcount count = iter.positionlist_count();
+    *this << static_cast<uint32_t>(count);
+    if (count == 0)
+        return;
+
+    /* Positions are sorted, only differences are written. */
+    Xapian::termpos prev = 0;
+    for (Xapian::PositionIterator
+            piter = iter.positionlist_begin(),
+            pend = iter.positionlist_end();
+        piter != pend;
+        piter++)
+    {
+        const Xapian::termpos pos = *piter;
+        *this << static_cast<uint32_t>(m_is_compact ? pos - prev : pos);
+        prev = pos;
+    }
+}
+
+XAPIAN_ERLANG_NS_END
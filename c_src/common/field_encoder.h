@@ -0,0 +1,70 @@
+#ifndef XAPIAN_FIELD_ENCODER_H
+#define XAPIAN_FIELD_ENCODER_H
+
+// External imports
+#include <xapian.h>
+#include <string>
+#include <stdint.h>
+
+// Internal imports
+#include "xapian_config.h"
+#include "result_encoder.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * Encodes fields of retrieved documents and terms.
+ *
+ * By default, it is the same as ResultEncoder: integers are 4 native bytes,
+ * strings have a 4-byte length.
+ * The compact mode is selected by the retrieval schema (GET_COMPACT or
+ * TERM_COMPACT). In this mode integers and lengths of strings are LEB128
+ * varints, sorted lists of positions are delta-coded.
+ * Floats and single bytes are always written as is.
+ *
+ * @see xapian_common:read_varint/1
+ */
+class FieldEncoder
+{
+    ResultEncoder&  m_result;
+    bool            m_is_compact;
+
+    public:
+    FieldEncoder(ResultEncoder& result)
+        : m_result(result), m_is_compact(false)
+    {}
+
+    void
+    setCompact()
+    {
+        m_is_compact = true;
+    }
+
+    FieldEncoder&
+    operator<<(const std::string& str);
+
+    FieldEncoder&
+    operator<<(uint32_t value);
+
+    FieldEncoder&
+    operator<<(uint8_t value)
+    {
+        m_result << value;
+        return *this;
+    }
+
+    FieldEncoder&
+    operator<<(double value)
+    {
+        m_result << value;
+        return *this;
+    }
+
+    /**
+     * Write the count of positions of the current term and positions.
+     */
+    void
+    positions(const Xapian::TermIterator& iter);
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
@@ -0,0 +1,138 @@
+#include "filter_cache.h"
+
+XAPIAN_ERLANG_NS_BEGIN
+
+// -------------------------------------------------------------------
+// DocIdSetPostingSource
+// -------------------------------------------------------------------
+
+DocIdSetPostingSource::DocIdSetPostingSource(DocIdSet* p_set)
+: mp_set(p_set), m_cursor(p_set), m_docid(0), m_is_started(false)
+{
+    mp_set->retain();
+}
+
+
+DocIdSetPostingSource::~DocIdSetPostingSource()
+{
+    DocIdSet::release(mp_set);
+}
+
+
+Xapian::doccount
+DocIdSetPostingSource::get_termfreq_min() const
+{
+    return mp_set->size();
+}
+
+
+Xapian::doccount
+DocIdSetPostingSource::get_termfreq_est() const
+{
+    return mp_set->size();
+}
+
+
+Xapian::doccount
+DocIdSetPostingSource::get_termfreq_max() const
+{
+    return mp_set->size();
+}
+
+
+void
+DocIdSetPostingSource::next(Xapian::weight /*min_wt*/)
+{
+    if (!m_is_started)
+    {
+        m_is_started = true;
+        m_docid = m_cursor.skipTo(1);
+    }
+    else if (m_docid != 0)
+    {
+        // The last docid has no next one.
+        const Xapian::docid next_docid = m_docid + 1;
+        m_docid = next_docid == 0 ? 0 : m_cursor.skipTo(next_docid);
+    }
+}
+
+
+void
+DocIdSetPostingSource::skip_to(Xapian::docid did, Xapian::weight /*min_wt*/)
+{
+    if (m_is_started && (m_docid == 0 || did <= m_docid))
+        return;
+    m_is_started = true;
+    m_docid = m_cursor.skipTo(did);
+}
+
+
+bool
+DocIdSetPostingSource::at_end() const
+{
+    return m_is_started && m_docid == 0;
+}
+
+
+Xapian::docid
+DocIdSetPostingSource::get_docid() const
+{
+    return m_docid;
+}
+
+
+void
+DocIdSetPostingSource::init(const Xapian::Database& /*db*/)
+{
+    m_cursor = DocIdSet::Cursor(mp_set);
+    m_docid = 0;
+    m_is_started = false;
+}
+
+
+Xapian::PostingSource*
+DocIdSetPostingSource::clone() const
+{
+    return new DocIdSetPostingSource(mp_set);
+}
+
+
+std::string
+DocIdSetPostingSource::get_description() const
+{
+    return "DocIdSetPostingSource()";
+}
+
+
+// -------------------------------------------------------------------
+// DocIdSetCollector
+// -------------------------------------------------------------------
+
+bool
+DocIdSetCollector::operator()(const Xapian::Document& doc) const
+{
+    // The document is not read, the docid is known without it.
+    m_set.append(doc.get_docid());
+    return false;
+}
+
+
+// -------------------------------------------------------------------
+// FilterSources
+// -------------------------------------------------------------------
+
+FilterSources::~FilterSources()
+{
+    for (size_t i = 0; i < m_sources.size(); i++)
+        delete m_sources[i];
+}
+
+
+Xapian::Query
+FilterSources::query(DocIdSet* p_set)
+{
+    m_sources.push_back(new DocIdSetPostingSource(p_set));
+    return Xapian::Query(m_sources.back());
+}
+
+XAPIAN_ERLANG_NS_END
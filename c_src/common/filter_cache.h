@@ -0,0 +1,156 @@
+#ifndef XAPIAN_FILTER_CACHE_H
+#define XAPIAN_FILTER_CACHE_H
+
+// External imports
+#include <xapian.h>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+// Internal imports
+#include "docid_set.h"
+#include "lru_cache.h"
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * Gives docids of a cached filter to the matcher.
+ * All documents have the weight 0.
+ */
+class DocIdSetPostingSource : public Xapian::PostingSource
+{
+    DocIdSet*           mp_set;
+    DocIdSet::Cursor    m_cursor;
+    Xapian::docid       m_docid;
+    bool                m_is_started;
+
+    public:
+    explicit
+    DocIdSetPostingSource(DocIdSet* p_set);
+
+    ~DocIdSetPostingSource();
+
+    Xapian::doccount get_termfreq_min() const;
+    Xapian::doccount get_termfreq_est() const;
+    Xapian::doccount get_termfreq_max() const;
+
+    void next(Xapian::weight min_wt);
+    void skip_to(Xapian::docid did, Xapian::weight min_wt);
+    bool at_end() const;
+    Xapian::docid get_docid() const;
+
+    void init(const Xapian::Database& db);
+
+    /**
+     * Clones share the set.
+     */
+    Xapian::PostingSource* clone() const;
+
+    std::string get_description() const;
+};
+
+
+/**
+ * Appends docids of all matching documents to the set and rejects them.
+ * Documents are checked in the ascending order of docids,
+ * the MSet stays empty.
+ */
+class DocIdSetCollector : public Xapian::MatchDecider
+{
+    DocIdSet&   m_set;
+
+    public:
+    explicit
+    DocIdSetCollector(DocIdSet& set) : m_set(set) {}
+
+    bool operator()(const Xapian::Document& doc) const;
+};
+
+
+/**
+ * Owns posting sources, while the query with them is built.
+ *
+ * Xapian::Query keeps a pointer on the source, but copies of its
+ * subqueries, which are made by compound queries, have their own clones.
+ * So, the source is needed only until the compound query is created.
+ */
+class FilterSources
+{
+    std::vector<DocIdSetPostingSource*> m_sources;
+
+    /// Copy is not allowed.
+    FilterSources(const FilterSources&);
+    FilterSources& operator=(const FilterSources&);
+
+    public:
+    FilterSources() {}
+    ~FilterSources();
+
+    /**
+     * Returns a query over @a p_set.
+     */
+    Xapian::Query
+    query(DocIdSet* p_set);
+};
+
+
+/**
+ * The cache holds a reference on each set.
+ */
+struct DocIdSetCacheTraits
+{
+    static void
+    release(DocIdSet*& p_set)
+    {
+        DocIdSet::release(p_set);
+    }
+
+    static size_t
+    memory(DocIdSet* const& p_set)
+    {
+        return p_set->memory();
+    }
+};
+
+
+/**
+ * A bounded LRU cache of docid sets of filter subqueries.
+ * It is limited by the count of entries and, optionally, by the memory
+ * of sets in bytes.
+ *
+ * The key is the encoded subquery, as it was sent by Erlang.
+ * Xapian 1.2 has no revision of the database, that is why the cache
+ * is cleared by Driver, when the database is changed or opened.
+ *
+ * It is disabled by default.
+ */
+class FilterCache : public LruCache<DocIdSet*, DocIdSetCacheTraits>
+{
+    typedef LruCache<DocIdSet*, DocIdSetCacheTraits> Base;
+
+    public:
+    /**
+     * Returns the cached set or NULL.
+     * The set is owned by the cache.
+     */
+    DocIdSet*
+    get(const std::string& key)
+    {
+        DocIdSet* p_set = NULL;
+        return Base::get(key, p_set) ? p_set : NULL;
+    }
+
+    /**
+     * Takes the reference on @a p_set.
+     * A set, which is larger than the memory limit, is not cached.
+     */
+    void
+    put(const std::string& key, DocIdSet* p_set)
+    {
+        if (!Base::put(key, p_set))
+            DocIdSet::release(p_set);
+    }
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
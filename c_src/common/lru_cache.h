@@ -0,0 +1,211 @@
+#ifndef XAPIAN_LRU_CACHE_H
+#define XAPIAN_LRU_CACHE_H
+
+// External imports
+#include <list>
+#include <map>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+// Internal imports
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * Values are copied into the cache and are not counted in memory.
+ */
+template <class Value>
+struct LruCacheTraits
+{
+    /**
+     * Called, when the value leaves the cache.
+     */
+    static void
+    release(Value& /* value */) {}
+
+    /**
+     * The memory of the value in bytes.
+     */
+    static size_t
+    memory(const Value& /* value */)
+    {
+        return 0;
+    }
+};
+
+
+/**
+ * A bounded LRU cache with string keys.
+ * It is limited by the count of entries and, optionally, by the memory
+ * of values in bytes, as @a Traits count it.
+ *
+ * Keys are encoded parameters, as they were sent by Erlang.
+ * It is disabled, while the capacity is 0.
+ */
+template <class Value, class Traits = LruCacheTraits<Value> >
+class LruCache
+{
+    struct Entry
+    {
+        std::string     key;
+        Value           value;
+    };
+
+    typedef std::list<Entry> Entries;
+    typedef std::map<std::string, typename Entries::iterator> Index;
+
+    /* The most recently used entry is the first one. */
+    Entries     m_entries;
+    Index       m_index;
+    uint32_t    m_capacity;
+    uint32_t    m_size;
+    size_t      m_memory;
+    /* 0, if the memory is not limited. */
+    size_t      m_max_memory;
+
+    uint32_t    m_hits;
+    uint32_t    m_misses;
+    uint32_t    m_evictions;
+
+    /// Copy is not allowed.
+    LruCache(const LruCache&);
+    LruCache& operator=(const LruCache&);
+
+    void
+    evictLast()
+    {
+        Entry& entry = m_entries.back();
+        m_memory -= Traits::memory(entry.value);
+        Traits::release(entry.value);
+        m_index.erase(entry.key);
+        m_entries.pop_back();
+        m_size--;
+        m_evictions++;
+    }
+
+    /**
+     * Evicts entries until @a count more values with @a memory bytes
+     * fit the limits.
+     */
+    void
+    evict(uint32_t count, size_t memory)
+    {
+        while (m_size != 0 && (m_size + count > m_capacity
+            || (m_max_memory != 0 && m_memory + memory > m_max_memory)))
+            evictLast();
+    }
+
+    public:
+    explicit
+    LruCache(uint32_t capacity = 0)
+    : m_capacity(capacity), m_size(0), m_memory(0), m_max_memory(0),
+      m_hits(0), m_misses(0), m_evictions(0)
+    {}
+
+    ~LruCache()
+    {
+        clear();
+    }
+
+    bool
+    isEnabled() const
+    {
+        return m_capacity != 0;
+    }
+
+    /**
+     * Returns true and sets @a value, if the key is cached.
+     */
+    bool
+    get(const std::string& key, Value& value)
+    {
+        if (m_capacity == 0)
+            return false;
+
+        typename Index::iterator i = m_index.find(key);
+        if (i == m_index.end())
+        {
+            m_misses++;
+            return false;
+        }
+
+        // Move to the front.
+        m_entries.splice(m_entries.begin(), m_entries, i->second);
+        value = i->second->value;
+        m_hits++;
+        return true;
+    }
+
+    /**
+     * Returns false, if the value is not cached: the cache is disabled,
+     * the key is already cached or the value is larger than the memory
+     * limit. The value is not released then.
+     */
+    bool
+    put(const std::string& key, const Value& value)
+    {
+        const size_t memory = Traits::memory(value);
+        if (m_capacity == 0 || m_index.find(key) != m_index.end()
+         || (m_max_memory != 0 && memory > m_max_memory))
+            return false;
+
+        evict(1, memory);
+
+        Entry entry;
+        entry.key   = key;
+        entry.value = value;
+        m_entries.push_front(entry);
+        m_index[key] = m_entries.begin();
+        m_size++;
+        m_memory += memory;
+        return true;
+    }
+
+    void
+    clear()
+    {
+        typename Entries::iterator i;
+        for (i = m_entries.begin(); i != m_entries.end(); ++i)
+            Traits::release(i->value);
+        m_index.clear();
+        m_entries.clear();
+        m_size = 0;
+        m_memory = 0;
+    }
+
+    /**
+     * 0 disables the cache.
+     */
+    void
+    setCapacity(uint32_t capacity)
+    {
+        m_capacity = capacity;
+        evict(0, 0);
+    }
+
+    /**
+     * 0 removes the limit.
+     */
+    void
+    setMaxMemory(size_t max_memory)
+    {
+        m_max_memory = max_memory;
+        evict(0, 0);
+    }
+
+    uint32_t capacity() const   { return m_capacity; }
+    size_t maxMemory() const    { return m_max_memory; }
+    uint32_t size() const       { return m_size; }
+    uint32_t hits() const       { return m_hits; }
+    uint32_t misses() const     { return m_misses; }
+    uint32_t evictions() const  { return m_evictions; }
+
+    /**
+     * Bytes of cached values.
+     */
+    size_t memory() const       { return m_memory; }
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
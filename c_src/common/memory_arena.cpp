@@ -0,0 +1,100 @@
+// External imports
+#include <assert.h>
+
+// Internal imports
+#include "memory_arena.h"
+#include "xapian_exception.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/* The header of the chunk is followed by aligned data. */
+#define CHUNK_HEADER_LEN align(sizeof(Chunk))
+
+
+ArenaMemoryManager::ArenaMemoryManager(
+    MemoryManager& upstream,
+    size_t chunk_len)
+: m_upstream(upstream), m_chunk_len(chunk_len),
+  m_chunks(NULL), m_pos(NULL), m_end(NULL),
+  m_alloc_count(0), m_upstream_alloc_count(0)
+{}
+
+
+ArenaMemoryManager::~ArenaMemoryManager()
+{
+    while (m_chunks != NULL)
+    {
+        Chunk* next = m_chunks->next;
+        m_upstream.free(m_chunks);
+        m_chunks = next;
+    }
+}
+
+
+/**
+ * Start a new chunk, which has at least @a min_len free bytes.
+ * The rest of the current chunk is wasted.
+ */
+void
+ArenaMemoryManager::grow(size_t min_len)
+{
+    const size_t data_len = min_len > m_chunk_len ? min_len : m_chunk_len;
+    const size_t size = CHUNK_HEADER_LEN + data_len;
+    Chunk* chunk = static_cast<Chunk*>( m_upstream.alloc(size) );
+    if (chunk == NULL)
+        throw MemoryAllocationDriverError(POS, size);
+    m_upstream_alloc_count++;
+
+    chunk->next = m_chunks;
+    chunk->size = size;
+    m_chunks    = chunk;
+    m_pos       = reinterpret_cast<char*>( chunk ) + CHUNK_HEADER_LEN;
+    m_end       = reinterpret_cast<char*>( chunk ) + size;
+}
+
+
+void*
+ArenaMemoryManager::alloc(size_t size)
+{
+    size = align(size);
+    if (static_cast<size_t>(m_end - m_pos) < size)
+        grow(size);
+
+    void* pos = m_pos;
+    m_pos += size;
+    m_alloc_count++;
+    return pos;
+}
+
+
+void
+ArenaMemoryManager::free(void* /*pos*/)
+{}
+
+
+void
+ArenaMemoryManager::reset()
+{
+    if (m_chunks == NULL)
+        return;
+
+    /* The oldest chunk is the last one in the list. */
+    while (m_chunks->next != NULL)
+    {
+        Chunk* next = m_chunks->next;
+        m_upstream.free(m_chunks);
+        m_chunks = next;
+    }
+
+    /* A dedicated chunk for a large block is not kept. */
+    if (m_chunks->size > CHUNK_HEADER_LEN + m_chunk_len)
+    {
+        m_upstream.free(m_chunks);
+        m_chunks = NULL;
+        m_pos = m_end = NULL;
+        return;
+    }
+    m_pos = reinterpret_cast<char*>( m_chunks ) + CHUNK_HEADER_LEN;
+    m_end = reinterpret_cast<char*>( m_chunks ) + m_chunks->size;
+}
+
+XAPIAN_ERLANG_NS_END
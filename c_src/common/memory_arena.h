@@ -0,0 +1,110 @@
+#ifndef XAPIAN_MEMORY_ARENA_H
+#define XAPIAN_MEMORY_ARENA_H
+
+// External imports
+#include <cstddef>
+
+// Internal imports
+#include "xapian_config.h"
+#include "memory_manager.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/* The default size of a chunk, requested from the upstream manager. */
+#define ARENA_CHUNK_LEN 65536
+
+/* Blocks are aligned on this boundary. */
+#define ARENA_ALIGN 16
+
+
+/**
+ * A bump-pointer allocator for memory, that lives for one request.
+ *
+ * Blocks are carved from large chunks of the upstream manager.
+ * @ref free does nothing, all blocks are released at once with @ref reset.
+ * The first chunk is kept between requests, so a typical request does
+ * not call the upstream manager at all.
+ *
+ * It is not thread-safe: each thread or instance needs its own arena.
+ *
+ * Only segments of ResultEncoder are allocated here. Element contexts
+ * are refcounted and can be attached to resources, which outlive
+ * the request, and std::string temporaries use std::allocator inside
+ * Xapian, so both stay on the heap.
+ */
+class ArenaMemoryManager : public MemoryManager
+{
+    struct Chunk
+    {
+        Chunk*  next;
+        size_t  size;
+    };
+
+    MemoryManager&  m_upstream;
+    const size_t    m_chunk_len;
+
+    /* The list of chunks, the current one is first. */
+    Chunk*          m_chunks;
+    char*           m_pos;
+    char*           m_end;
+
+    /* Statistics */
+    size_t          m_alloc_count;
+    size_t          m_upstream_alloc_count;
+
+    static size_t
+    align(size_t len)
+    {
+        return (len + ARENA_ALIGN - 1) & ~static_cast<size_t>(ARENA_ALIGN - 1);
+    }
+
+    void
+    grow(size_t min_len);
+
+    /// Copy is not allowed.
+    ArenaMemoryManager(const ArenaMemoryManager& src)
+    : MemoryManager(), m_upstream(src.m_upstream), m_chunk_len(0) {}
+
+    /// Assignment is not allowed.
+    ArenaMemoryManager& operator= (const ArenaMemoryManager&)
+    { return *this; }
+
+    public:
+    ArenaMemoryManager(MemoryManager& upstream,
+                       size_t chunk_len = ARENA_CHUNK_LEN);
+
+    ~ArenaMemoryManager();
+
+    virtual void* alloc(size_t size);
+
+    /**
+     * Memory is released by @ref reset.
+     */
+    virtual void free(void* pos);
+
+    /**
+     * Release all blocks.
+     * Only the first chunk is kept, other chunks are returned upstream.
+     */
+    void reset();
+
+    /**
+     * The count of blocks, allocated since the arena was created.
+     */
+    size_t
+    allocCount() const
+    {
+        return m_alloc_count;
+    }
+
+    /**
+     * The count of chunks, requested from the upstream manager.
+     */
+    size_t
+    upstreamAllocCount() const
+    {
+        return m_upstream_alloc_count;
+    }
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
@@ -0,0 +1,23 @@
+#ifndef XAPIAN_MSET_CACHE_H
+#define XAPIAN_MSET_CACHE_H
+
+// Internal imports
+#include "lru_cache.h"
+#include "resource/element.h"
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * A bounded LRU cache of match results.
+ *
+ * The key is the encoded Enquire settings (including the query) and 
+ * the encoded parameters of the match, as they were sent by Erlang.
+ * The value is an MSet resource, which is shared by all hits and never 
+ * changed. The cache is cleared by Driver, when the database is changed.
+ *
+ * It is disabled by default.
+ */
+typedef LruCache<Resource::Element> MSetCache;
+
+XAPIAN_ERLANG_NS_END
+#endif
@@ -37,11 +37,21 @@ ParamDecoder::move(const size_t size)
  * Decodes `<<StringLen:32/native-signed-integer, StringBin/binary>>`.
  */
 ParamDecoder::operator const std::string() {
+    const StringRef ref = *this;
+    return ref.str();
+}
+
+/**
+ * The same, but characters are not copied.
+ * The result points inside the buffer of parameters.
+ */
+ParamDecoder::operator StringRef() {
     const int32_t str_len = READ_TYPE(int32_t);
-    const char* str_bin = m_buf;
-    move(str_len);
-    const std::string str(str_bin, static_cast<size_t>(str_len));
-    return str;
+    if (str_len < 0)
+        throw OverflowDriverError(POS);
+    const size_t len = static_cast<size_t>(str_len);
+    const char* str_bin = move(len);
+    return StringRef(str_bin, len);
 }
 
 /**
@@ -11,6 +11,7 @@ class Stem;
 }
 
 #include "xapian_config.h"
+#include "string_ref.h"
 XAPIAN_ERLANG_NS_BEGIN
 
 /**
@@ -48,6 +49,7 @@ class ParamDecoder
     operator uint32_t();
     operator double(); 
     operator const std::string();
+    operator StringRef();
     operator const Xapian::Stem();
     /*! \} */
 
@@ -26,8 +26,8 @@ QlcTable::~QlcTable()
 // ------------------------------------------------------------------
 
 MSetQlcTable::MSetQlcTable(Driver& driver, 
-    Xapian::MSet& mset, const ParamDecoderController& controller) 
-    : QlcTable(driver), m_mset(mset), m_controller(controller)
+    Xapian::MSet& mset, const RetrievalSchema& schema) 
+    : QlcTable(driver), m_mset(mset), m_schema(schema)
 {}
 
 
@@ -44,7 +44,8 @@ MSetQlcTable::size()
  */
 void
 MSetQlcTable::getPage(
-        ResultEncoder& result, const uint32_t skip, const uint32_t count)
+        ResultEncoder& result, const uint32_t skip, const uint32_t count,
+        const Deadline& /*deadline*/)
 {
     uint32_t size = m_mset.size();
     assert(skip <= size);
@@ -65,8 +66,7 @@ MSetQlcTable::getPage(
                               ? m_mset[skip+left] 
                               : m_mset.end();
 
-    ParamDecoder params = m_controller;
-    m_driver.retrieveDocuments(params, result, iter, last);
+    m_driver.retrieveDocuments(m_schema, result, iter, last, left);
 }
 
 
@@ -106,8 +106,7 @@ MSetQlcTable::lookup(ParamDecoder& driver_params, ResultEncoder& result)
             docids.erase(doc_iter);
             result << MORE;
 
-            ParamDecoder params = m_controller;
-            m_driver.selectEncoderAndRetrieveDocument(params, result, miter);
+            m_driver.retrieveDocument(m_schema, result, miter);
             if (docids.empty())
                 break;
         }
@@ -121,8 +120,7 @@ MSetQlcTable::lookup(ParamDecoder& driver_params, ResultEncoder& result)
         {
             result << MORE;
 
-            ParamDecoder params = m_controller;
-            m_driver.selectEncoderAndRetrieveDocument(params, result, miter);
+            m_driver.retrieveDocument(m_schema, result, miter);
         }
     }
 
@@ -139,8 +137,8 @@ MSetQlcTable::lookup(ParamDecoder& driver_params, ResultEncoder& result)
 
 TermQlcTable::TermQlcTable(Driver& driver, 
         TermGenerator::Iterator* gen, 
-        const ParamDecoderController& controller) 
-    : QlcTable(driver), mp_gen(gen), m_controller(controller)
+        const RetrievalSchema& schema) 
+    : QlcTable(driver), mp_gen(gen), m_schema(schema)
 {
     reset();
 
@@ -163,23 +161,22 @@ TermQlcTable::size()
  */
 void
 TermQlcTable::getPage(
-        ResultEncoder& result, const uint32_t skip, const uint32_t count)
+        ResultEncoder& result, const uint32_t skip, const uint32_t count,
+        const Deadline& deadline)
 {
-    if (m_size)
+    if (m_size && !deadline.isSet())
         getPageKnownSize(result, skip, count);
     else
-        getPageUnknownSize(result, skip, count);
+        getPageUnknownSize(result, skip, count, deadline);
 }
 
 void
 TermQlcTable::lookup(ParamDecoder& driver_params, ResultEncoder& result)
 {
-    ParamDecoder schema_params = m_controller;
-
     // Allocate (begin()) new iterator.
     // m_iter contains an old iterator.
     Driver::qlcTermIteratorLookup(
-        driver_params, schema_params, result, mp_gen->begin(), m_end);
+        driver_params, m_schema, result, mp_gen->begin(), m_end);
 }
 
 
@@ -199,9 +196,10 @@ TermQlcTable::reset()
         
 void
 TermQlcTable::getPageUnknownSize(
-        ResultEncoder& result, const uint32_t skip, const uint32_t count)
+        ResultEncoder& result, const uint32_t skip, const uint32_t count,
+        const Deadline& deadline)
 {
-    assert(!m_size);
+    assert(!m_size || deadline.isSet());
 
     const uint32_t left = count;
 
@@ -214,15 +212,21 @@ TermQlcTable::getPageUnknownSize(
     }
 
     uint32_t passed = 0;
+    bool is_paused = false;
     // While left > 0 and term is not last.
     for (uint32_t i = left; i && (m_iter != m_end); m_iter++, i--, passed++)
     {
         assert(m_iter != m_end);
+        // Return at least one object, so the scan always moves forward.
+        if (passed && deadline.isExpired())
+        {
+            is_paused = true;
+            break;
+        }
         result << MORE;
-        ParamDecoder params = m_controller;
-        m_driver.retrieveTerm(params, result, m_iter);
+        m_driver.retrieveTerm(m_schema, result, m_iter);
     }
-    result << STOP;
+    result << (is_paused ? PAUSE : STOP);
 
     // Save cur pos of an iterator
     m_current_pos = skip + passed;
@@ -249,7 +253,7 @@ TermQlcTable::getPageKnownSize(
 
     if (!m_size)
         // m_size was reseted.
-        return getPageUnknownSize(result, skip, count);
+        return getPageUnknownSize(result, skip, count, Deadline());
 
     uint32_t size = m_size;
     assert(skip <= size);
@@ -283,9 +287,8 @@ TermQlcTable::getPageKnownSize(
                 */
         }
         assert(m_iter != m_end);
-        ParamDecoder params = m_controller;
         // m_iter will be on the same position.
-        m_driver.retrieveTerm(params, result, m_iter);
+        m_driver.retrieveTerm(m_schema, result, m_iter);
     }
 
     // Save cur pos of an iterator
@@ -2,12 +2,13 @@
 #define QLC_TABLE_H
 
 #include "param_decoder.h"
-#include "param_decoder_controller.h"
+#include "retrieval_schema.h"
 
 #include <xapian.h>
 #include <string>
 #include <cstring>
 #include "termiter_gen.h"
+#include "deadline.h"
 
 #include "xapian_config.h"
 XAPIAN_ERLANG_NS_BEGIN
@@ -45,8 +46,10 @@ class QlcTable
     public:
     /**
      * Flags, that signal about the end of the list.
+     * PAUSE means, that the page was cut by the deadline, but
+     * more objects can follow.
      */
-    static const uint8_t MORE = 1, STOP = 0;
+    static const uint8_t MORE = 1, STOP = 0, PAUSE = 2;
 
     /**
      * Objects can use 2 encoding schemas:
@@ -55,6 +58,8 @@ class QlcTable
      *      Objects are coded as `Size(3) Obj1 Obj2 Obj3`;
      * - With unknown size:
      *      Objects are coded as `Obj1 MORE Obj2 MORE Obj3 STOP`.
+     *
+     * If the deadline is set, the second schema is used.
      */
     static const uint8_t UNKNOWN_SIZE = 0, KNOWN_SIZE = 1;
 
@@ -74,9 +79,12 @@ class QlcTable
 
     /**
      * It allows paganation.
+     * The scan stops, when @a deadline is passed.
+     * At least one object is returned in this case.
      */
     virtual void
-    getPage(ResultEncoder&, uint32_t from, uint32_t count) = 0;
+    getPage(ResultEncoder&, uint32_t from, uint32_t count, 
+            const Deadline& deadline) = 0;
 
     /**
      * Select objects by a key (by an index).
@@ -92,15 +100,19 @@ class QlcTable
 class MSetQlcTable : public QlcTable
 {
     Xapian::MSet m_mset;
-    const ParamDecoderController m_controller;
+    const RetrievalSchema m_schema;
 
     public:
     MSetQlcTable(Driver& driver, 
-        Xapian::MSet& mset, const ParamDecoderController& controller);
+        Xapian::MSet& mset, const RetrievalSchema& schema);
 
     uint32_t size();
 
-    void getPage(ResultEncoder&, uint32_t from, uint32_t count);
+    /**
+     * The page size is limited by the MSet, the deadline is ignored.
+     */
+    void getPage(ResultEncoder&, uint32_t from, uint32_t count, 
+                 const Deadline&);
 
     void lookup(PR);
     void reset();
@@ -121,7 +133,7 @@ class TermQlcTable : public QlcTable
     TermGenerator::Iterator* mp_gen;
     uint32_t m_current_pos, m_size;
     
-    const ParamDecoderController m_controller;
+    const RetrievalSchema m_schema;
                      
     public:
 
@@ -131,7 +143,7 @@ class TermQlcTable : public QlcTable
      */
     TermQlcTable(Driver& driver, 
         TermGenerator::Iterator* gen, 
-        const ParamDecoderController& controller);
+        const RetrievalSchema& schema);
 
     
     ~TermQlcTable();
@@ -142,7 +154,8 @@ class TermQlcTable : public QlcTable
      */
     uint32_t size();
 
-    void getPage(ResultEncoder&, uint32_t from, uint32_t count);
+    void getPage(ResultEncoder&, uint32_t from, uint32_t count, 
+                 const Deadline&);
 
     void lookup(PR);
 
@@ -174,10 +187,12 @@ class TermQlcTable : public QlcTable
     /**
      * Skip @a skip objects from the beginning and return objects.
      * Maximum @a count object will be returned.
-     * It is used, when the total size of objects is known.
+     * It is used, when the total size of objects is known or when
+     * the deadline is set.
      */
     void getPageUnknownSize(
-            ResultEncoder&, const uint32_t skip, const uint32_t count);
+            ResultEncoder&, const uint32_t skip, const uint32_t count,
+            const Deadline&);
 };
 
 XAPIAN_ERLANG_NS_END
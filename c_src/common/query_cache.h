@@ -0,0 +1,33 @@
+#ifndef XAPIAN_QUERY_CACHE_H
+#define XAPIAN_QUERY_CACHE_H
+
+// External imports
+#include <xapian.h>
+
+// Internal imports
+#include "lru_cache.h"
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/* The default count of cached queries. */
+#define QUERY_CACHE_DEFAULT_CAPACITY 256
+
+/**
+ * A bounded LRU cache of queries, returned by QueryParser.
+ *
+ * The key is the encoded parser configuration, the query string,
+ * the default prefix and flags, as they were sent by Erlang.
+ * Results depend on the database (wildcards, synonyms, spelling), so
+ * the cache is cleared by Driver, when the database or the default
+ * parser is changed.
+ */
+class QueryCache : public LruCache<Xapian::Query>
+{
+    public:
+    QueryCache()
+    : LruCache<Xapian::Query>(QUERY_CACHE_DEFAULT_CAPACITY)
+    {}
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
@@ -43,6 +43,12 @@ class PrefixInternal
 
 /**
  * It is here, because QueryParser cannot be cloned.
+ *
+ * A copy of Xapian::QueryParser shares its internals with the original,
+ * so the factory keeps two kinds of parsers: a prebuilt one, which is
+ * shared and must not be changed, and fresh ones, which are built on
+ * each conversion. The prebuilt parser is rebuilt lazily, after
+ * the stemmer, the database or prefixes were changed.
  */
 class QueryParserFactory
 {
@@ -50,21 +56,47 @@ class QueryParserFactory
     Xapian::Stem m_stemmer;
     std::vector< PrefixInternal > m_prefixes;
 
+    Xapian::QueryParser m_parser;
+    bool m_is_dirty;
+
+    Xapian::QueryParser build()
+    {
+        Xapian::QueryParser qp;
+        qp.set_database(m_db);
+        qp.set_stemmer(m_stemmer);
+
+        std::vector< PrefixInternal >::iterator 
+            piter = m_prefixes.begin(),
+            pend  = m_prefixes.end();
+        while (piter != pend)
+        {
+            piter->fill(qp);
+            piter++;
+        }
+        return qp;
+    }
+
     public:
+    QueryParserFactory() : m_is_dirty(true)
+    {}
+
     void set_stemmer (const Xapian::Stem &stemmer)
     {
         m_stemmer = stemmer;
+        m_is_dirty = true;
     }
 
     void set_database (const Xapian::Database &db)
     {
         m_db = db;
+        m_is_dirty = true;
     }
 
     void add_prefix (const std::string &field, const std::string &prefix)
     {
         PrefixInternal p(field, prefix);
         m_prefixes.push_back(p);
+        m_is_dirty = true;
     }
 
     void add_boolean_prefix (const std::string &field, 
@@ -72,23 +104,28 @@ class QueryParserFactory
     {
         PrefixInternal p(field, prefix, exclusive);
         m_prefixes.push_back(p);
+        m_is_dirty = true;
     }
 
-    operator Xapian::QueryParser()
+    /**
+     * Returns the shared parser. Do not change it.
+     */
+    const Xapian::QueryParser& prebuilt()
     {
-        Xapian::QueryParser qp;
-        qp.set_database(m_db);
-        qp.set_stemmer(m_stemmer);
-
-        std::vector< PrefixInternal >::iterator 
-            piter = m_prefixes.begin(),
-            pend  = m_prefixes.end();
-        while (piter != pend)
+        if (m_is_dirty)
         {
-            piter->fill(qp);
-            piter++;
+            m_parser = build();
+            m_is_dirty = false;
         }
-        return qp;
+        return m_parser;
+    }
+
+    /**
+     * Returns a fresh parser, which can be changed.
+     */
+    operator Xapian::QueryParser()
+    {
+        return build();
     }
 };
 
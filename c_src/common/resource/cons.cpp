@@ -2,6 +2,7 @@
 #include "resource/generator.h"
 #include "resource/element.h"
 #include "resource/register.h"
+#include "resource/shared.h"
 #include "param_decoder.h"
 #include "xapian_core.h"
 #include "xapian.h"
@@ -130,18 +131,39 @@ createStringValueRangeProcessor3(Register& /*m*/, ParamDecoder& params)
 }
 
 
+/**
+ * Stoppers with the same words are shared by all drivers of the process.
+ */
 Element
 createSimpleStopper(Register& /*m*/, ParamDecoder& params)
 {
-    Xapian::SimpleStopper* p_stopper = new Xapian::SimpleStopper();
+    // Find the end of the word list without copying words.
+    char* from = params.currentPosition();
     for(;;)
     {
-        const std::string& str = params;
-        if (str == "")
+        const StringRef str = params;
+        if (str.empty())
             break;
-        p_stopper->add(str);
     }
-    return Element::wrap(p_stopper);
+    const size_t len = static_cast<size_t>(params.currentPosition() - from);
+
+    SharedRegistry& shared = SharedRegistry::instance();
+    const std::string name = "simple_stopper";
+    SharedObject* p_obj = shared.acquire(name, from, len);
+    if (p_obj == NULL)
+    {
+        ParamDecoder words(from, len);
+        Xapian::SimpleStopper* p_stopper = new Xapian::SimpleStopper();
+        for(;;)
+        {
+            const std::string& str = words;
+            if (str == "")
+                break;
+            p_stopper->add(str);
+        }
+        p_obj = shared.insert(name, from, len, new SharedStopper(p_stopper));
+    }
+    return Element::wrap(static_cast<SharedStopper*>(p_obj));
 }
 
 
@@ -9,8 +9,15 @@
 
 #include "xapian_config.h"
 
+/* A guess of the size of a resource in bytes, if nothing better is known. */
+#define RESOURCE_APPROX_LEN 256
+
+/* A guess of the size of an item of an MSet or of a table in bytes. */
+#define RESOURCE_ITEM_APPROX_LEN 64
+
 XAPIAN_ERLANG_NS_BEGIN
 class QlcTable;
+struct SortOrder;
 XAPIAN_ERLANG_NS_END
 
 namespace Xapian
@@ -95,6 +102,27 @@ class Base
         return "Resource::Controller";
     }
 
+    /**
+     * An approximate count of bytes, used by the object itself.
+     */
+    virtual size_t approximate_size()
+    {
+        return RESOURCE_APPROX_LEN;
+    }
+
+    /**
+     * The same, but attached children are counted too.
+     * A child, which is also registered, is counted twice.
+     */
+    size_t approximate_total_size()
+    {
+        size_t total = approximate_size();
+        for (std::vector<Element>::iterator 
+                i = m_children.begin(), e = m_children.end(); i != e; i++)
+            total += i->get().approximate_total_size();
+        return total;
+    }
+
     virtual operator Xapian::MSet&()
     {
         throw ResourceTypeMismatchDriverError(POS, type(), "Xapian::MSet");
@@ -191,6 +219,41 @@ class Base
     {
         throw AbstractMethodDriverError(POS, type(), "is_finalized");
     }
+
+    virtual uint32_t get_timeout()
+    {
+        throw AbstractMethodDriverError(POS, type(), "get_timeout");
+    }
+
+    virtual void set_timeout(uint32_t /*timeout*/)
+    {
+        throw AbstractMethodDriverError(POS, type(), "set_timeout");
+    }
+
+    virtual const std::string& get_cache_key()
+    {
+        throw AbstractMethodDriverError(POS, type(), "get_cache_key");
+    }
+
+    virtual void set_cache_key(const std::string& /*key*/)
+    {
+        throw AbstractMethodDriverError(POS, type(), "set_cache_key");
+    }
+
+    virtual const SortOrder& get_sort_order()
+    {
+        throw AbstractMethodDriverError(POS, type(), "get_sort_order");
+    }
+
+    virtual void set_sort_order(const SortOrder& /*order*/)
+    {
+        throw AbstractMethodDriverError(POS, type(), "set_sort_order");
+    }
+
+    virtual bool is_truncated()
+    {
+        throw AbstractMethodDriverError(POS, type(), "is_truncated");
+    }
 };
 
 XAPIAN_RESOURCE_CTRL_NS_END
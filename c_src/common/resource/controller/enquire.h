@@ -2,6 +2,7 @@
 #define ENQUIRE_RCTRL_H
 
 #include "resource/controller/base.h"
+#include "search_cursor.h"
 #include <xapian.h>
 
 #include "xapian_config.h"
@@ -12,8 +13,16 @@ class Enquire : public Base
 {
     Xapian::Enquire* mp_enquire;
 
+    /* The default time budget of matches in milliseconds. */
+    uint32_t m_timeout;
+
+    /* Encoded settings, a part of the key of MSetCache. */
+    std::string m_cache_key;
+
+    SortOrder m_order;
+
     public:
-    Enquire(Xapian::Enquire* p_enquire) : mp_enquire(p_enquire) {}
+    Enquire(Xapian::Enquire* p_enquire) : mp_enquire(p_enquire), m_timeout(0) {}
     ~Enquire() { delete mp_enquire; }
 
     virtual operator Xapian::Enquire&()
@@ -21,6 +30,36 @@ class Enquire : public Base
         return *mp_enquire;
     }
 
+    uint32_t get_timeout()
+    {
+        return m_timeout;
+    }
+
+    void set_timeout(uint32_t timeout)
+    {
+        m_timeout = timeout;
+    }
+
+    const std::string& get_cache_key()
+    {
+        return m_cache_key;
+    }
+
+    void set_cache_key(const std::string& key)
+    {
+        m_cache_key = key;
+    }
+
+    const SortOrder& get_sort_order()
+    {
+        return m_order;
+    }
+
+    void set_sort_order(const SortOrder& order)
+    {
+        m_order = order;
+    }
+
     std::string type()
     {
         return "Resource::Enquire";
@@ -2,6 +2,7 @@
 #define MATCH_SET_RCTRL_H
 
 #include "resource/controller/base.h"
+#include "search_cursor.h"
 #include <xapian.h>
 
 #include "xapian_config.h"
@@ -12,8 +13,15 @@ class MSet : public Base
 {
     Xapian::MSet* mp_mset;
 
+    /* The match was stopped by the deadline. */
+    bool mb_truncated;
+
+    /* The order of the Enquire, which created this MSet. */
+    SortOrder m_order;
+
     public:
-    MSet(Xapian::MSet* p_mset) : mp_mset(p_mset) {}
+    MSet(Xapian::MSet* p_mset, bool is_truncated) 
+        : mp_mset(p_mset), mb_truncated(is_truncated) {}
     ~MSet() { delete mp_mset; }
 
     virtual operator Xapian::MSet&()
@@ -21,10 +29,31 @@ class MSet : public Base
         return *mp_mset;
     }
 
+    bool is_truncated()
+    {
+        return mb_truncated;
+    }
+
+    const SortOrder& get_sort_order()
+    {
+        return m_order;
+    }
+
+    void set_sort_order(const SortOrder& order)
+    {
+        m_order = order;
+    }
+
     std::string type()
     {
         return "Resource::MatchSet";
     }
+
+    size_t approximate_size()
+    {
+        return RESOURCE_APPROX_LEN 
+             + static_cast<size_t>(mp_mset->size()) * RESOURCE_ITEM_APPROX_LEN;
+    }
 };
 
 XAPIAN_RESOURCE_CTRL_NS_END
@@ -25,6 +25,15 @@ class QlcTable : public Base
     {
         return "Resource::QlcTable";
     }
+
+    /**
+     * The size is 0 for term tables, until they are scanned to the end.
+     */
+    size_t approximate_size()
+    {
+        return RESOURCE_APPROX_LEN 
+             + static_cast<size_t>(mp_table->size()) * RESOURCE_ITEM_APPROX_LEN;
+    }
 };
 
 XAPIAN_RESOURCE_CTRL_NS_END
@@ -2,6 +2,7 @@
 #define STOPPER_RCTRL_H
 
 #include "resource/controller/base.h"
+#include "resource/shared.h"
 #include <xapian.h>
 
 #include "xapian_config.h"
@@ -27,5 +28,28 @@ class Stopper : public Base
     }
 };
 
+
+/**
+ * The stopper is owned by @ref SharedRegistry.
+ */
+class SharedStopper : public Base
+{
+    Resource::SharedStopper* mp_shared;
+
+    public:
+    SharedStopper(Resource::SharedStopper* p_shared) : mp_shared(p_shared) {}
+    ~SharedStopper() { SharedRegistry::instance().release(mp_shared); }
+
+    virtual operator Xapian::Stopper&()
+    {
+        return mp_shared->get();
+    }
+
+    std::string type()
+    {
+        return "Resource::Stopper";
+    }
+};
+
 XAPIAN_RESOURCE_CTRL_NS_END
 #endif
@@ -165,6 +165,56 @@ Element::
 is_finalized() 
 { return mp_controller->is_finalized(); }
 
+uint32_t 
+Element::
+get_timeout() 
+{ return mp_controller->get_timeout(); }
+
+void 
+Element::
+set_timeout(uint32_t timeout) 
+{ return mp_controller->set_timeout(timeout); }
+
+const std::string&
+Element::
+get_cache_key() 
+{ return mp_controller->get_cache_key(); }
+
+void 
+Element::
+set_cache_key(const std::string& key) 
+{ return mp_controller->set_cache_key(key); }
+
+const SortOrder&
+Element::
+get_sort_order() 
+{ return mp_controller->get_sort_order(); }
+
+void 
+Element::
+set_sort_order(const SortOrder& order) 
+{ return mp_controller->set_sort_order(order); }
+
+bool 
+Element::
+is_truncated() 
+{ return mp_controller->is_truncated(); }
+
+size_t
+Element::
+approximate_size() 
+{ return mp_controller ? mp_controller->approximate_size() : 0; }
+
+size_t
+Element::
+approximate_total_size() 
+{ return mp_controller ? mp_controller->approximate_total_size() : 0; }
+
+std::string
+Element::
+type() 
+{ return mp_controller->type(); }
+
 
 // Static functions
 
@@ -207,7 +257,14 @@ Element
 Element::
 wrap(Xapian::MSet* p_mset)
 {
-    return Element(new Controller::MSet(p_mset));
+    return Element(new Controller::MSet(p_mset, false));
+}
+
+Element
+Element::
+wrap(Xapian::MSet* p_mset, bool is_truncated)
+{
+    return Element(new Controller::MSet(p_mset, is_truncated));
 }
 
 Element
@@ -259,6 +316,13 @@ wrap(Xapian::Stopper* p_stopper)
     return Element(new Controller::Stopper(p_stopper));
 }
 
+Element
+Element::
+wrap(SharedStopper* p_stopper)
+{
+    return Element(new Controller::SharedStopper(p_stopper));
+}
+
 Element
 Element::
 wrap(Xapian::Stem* p_stemmer)
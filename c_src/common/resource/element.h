@@ -2,6 +2,8 @@
 #define RESOURCE_ELEMENT_H
 
 #include <stdint.h>
+#include <cstddef>
+#include <string>
 
 #include "xapian_config.h"
 
@@ -27,6 +29,7 @@ namespace Xapian
 
 XAPIAN_ERLANG_NS_BEGIN
     class QlcTable;
+    struct SortOrder;
 XAPIAN_ERLANG_NS_END
 
 XAPIAN_EXT_NS_BEGIN
@@ -40,6 +43,8 @@ namespace Controller
     class Base;
 }
 
+class SharedStopper;
+
 class Element 
 {
     Controller::Base* mp_controller;
@@ -80,7 +85,9 @@ class Element
     static Element wrap(Xapian::Document* p_document);
     static Element wrap(Xapian::Query* p_query);
     static Element wrap(Xapian::MSet* p_mset);
+    static Element wrap(Xapian::MSet* p_mset, bool is_truncated);
     static Element wrap(Xapian::Stopper* p_stopper);
+    static Element wrap(SharedStopper* p_stopper);
     static Element wrap(Xapian::Stem* p_stemmer);
     static Element wrap(QlcTable* p_table);
     static Element wrap(uint32_t slot, 
@@ -112,6 +119,47 @@ class Element
 
     void finalize();
     bool is_finalized();
+
+    /**
+     * The default time budget of an Enquire in milliseconds.
+     */
+    uint32_t get_timeout();
+    void set_timeout(uint32_t timeout);
+
+    /**
+     * Encoded settings of an Enquire, used by the MSet cache.
+     */
+    const std::string& get_cache_key();
+    void set_cache_key(const std::string& key);
+
+    /**
+     * The order of an Enquire or of an MSet, used by search cursors.
+     */
+    const SortOrder& get_sort_order();
+    void set_sort_order(const SortOrder& order);
+
+    /**
+     * Returns true, if the MSet was stopped by the deadline.
+     */
+    bool is_truncated();
+
+    /**
+     * An approximate count of bytes, used by the object itself.
+     * The memory budget of the register uses it: an attached child,
+     * which is registered too, is counted once.
+     */
+    size_t approximate_size();
+
+    /**
+     * The same, but attached children are counted too.
+     * It is used only for reports.
+     */
+    size_t approximate_total_size();
+
+    /**
+     * The name of the controller type, for example "Resource::MatchSet".
+     */
+    std::string type();
 };
 
 XAPIAN_RESOURCE_NS_END
@@ -6,6 +6,7 @@
 XAPIAN_RESOURCE_NS_BEGIN
 
 Factory::Factory(Driver& driver)
+    : m_is_replica(false), m_is_unresolved(false)
 {
     m_generator.registerCallbacks(driver);
 }
@@ -59,6 +60,8 @@ extract(ParamDecoder& params)
         case SCHEMA_TYPE_REFERENCE:
         {
             uint32_t element_num = params;
+            if (m_is_replica)
+                m_is_unresolved = true;
             return m_register.get(element_num);
             break;
         }
@@ -122,4 +125,66 @@ getResourceConstructors(ResultEncoder& result)
     }
 }
 
+void
+Factory::
+resourceLimits(ParamDecoder& params, ResultEncoder& result)
+{
+    const bool is_set = params;
+    if (is_set)
+    {
+        const uint32_t max_bytes = params;
+        const uint32_t idle_ttl  = params;
+        m_register.setLimits(max_bytes, idle_ttl);
+    }
+    else
+        m_register.applyLimits();
+
+    // see xapian_server:decode_resource_limits_result/1
+    const size_t bytes = m_register.bytes();
+    const uint32_t max_uint = ~static_cast<uint32_t>(0);
+    result << static_cast<uint32_t>(m_register.maxBytes())
+           << m_register.idleTtl()
+           << m_register.size()
+           << static_cast<uint32_t>(bytes > max_uint ? max_uint : bytes)
+           << m_register.evictedByBudget()
+           << m_register.evictedByTtl();
+}
+
+void
+Factory::
+resourceInfo(ResultEncoder& result)
+{
+    TypeInfoMap info;
+    m_register.typeInfo(info);
+
+    // see xapian_server:decode_resource_info_result/1
+    const uint32_t max_uint = ~static_cast<uint32_t>(0);
+    result << m_register.oldestAge();
+    result << static_cast<uint32_t>(info.size());
+    for (TypeInfoMap::const_iterator i = info.begin(), e = info.end();
+         i != e; i++)
+    {
+        const size_t bytes = i->second.bytes;
+        result << i->first
+               << i->second.count
+               << static_cast<uint32_t>(bytes > max_uint ? max_uint : bytes);
+    }
+}
+
+void
+Factory::
+setReplica()
+{
+    m_is_replica = true;
+}
+
+bool
+Factory::
+takeUnresolved()
+{
+    const bool is_unresolved = m_is_unresolved;
+    m_is_unresolved = false;
+    return is_unresolved;
+}
+
 XAPIAN_RESOURCE_NS_END
@@ -30,6 +30,12 @@ class Factory
     Generator m_generator;
     Register  m_register;
 
+    /* A replica does not share elements with the primary factory. */
+    bool      m_is_replica;
+
+    /* A replica has met a reference, since the last check. */
+    bool      m_is_unresolved;
+
     public:
     Factory(Driver& driver);
 
@@ -56,6 +62,33 @@ class Factory
 
     void
     getResourceConstructors(ResultEncoder& result);
+
+    /**
+     * Params: IsSet, [MaxBytes, IdleTtl].
+     * Result: MaxBytes, IdleTtl, Count, Bytes, EvictedByBudget, EvictedByTtl.
+     */
+    void
+    resourceLimits(ParamDecoder& params, ResultEncoder& result);
+
+    /**
+     * Result: OldestAge, TypeCount, [TypeName, Count, Bytes].
+     */
+    void
+    resourceInfo(ResultEncoder& result);
+
+    /**
+     * Mark this factory as a replica.
+     * References cannot be resolved by a replica, the command should be
+     * handled by the primary driver.
+     */
+    void
+    setReplica();
+
+    /**
+     * Returns true, if a reference was met since the last call.
+     */
+    bool
+    takeUnresolved();
 };
 
 XAPIAN_RESOURCE_NS_END
@@ -1,50 +1,228 @@
 #include "resource/register.h"
 #include "xapian_exception.h"
+#include "deadline.h"
 
 XAPIAN_RESOURCE_NS_BEGIN
 
 Register::
 Register()
+: m_free(NO_SLOT), m_lru_head(NO_SLOT), m_lru_tail(NO_SLOT),
+  m_size(0), m_bytes(0), m_max_bytes(0), m_idle_ttl(0),
+  m_evicted_by_budget(0), m_evicted_by_ttl(0)
 {
-    m_elements.set_empty_key(0);
-    m_elements.set_deleted_key(1);
-    m_counter = 1;
+    // Reserve the slot 0.
+    m_slots.resize(1);
 }
 
-Register::Counter 
+Register::Counter
 Register::
 put(Element elem)
 {
-    m_counter++;
-    m_elements[m_counter] = elem;
+    Counter index = m_free;
+    if (index == NO_SLOT)
+    {
+        index = static_cast<Counter>(m_slots.size());
+        if (index > SLOT_MASK)
+            throw OverflowDriverError(POS);
+        m_slots.push_back(Slot());
+    }
+    Slot& slot = m_slots[index];
+    m_free = slot.next_free;
 
-    return m_counter;
+    slot.element   = elem;
+    slot.next_free = NO_SLOT;
+    slot.state     = SLOT_USED;
+    slot.bytes     = elem.approximate_size();
+    slot.created   = monotonicNow();
+    slot.last_used = slot.created;
+    m_size++;
+    m_bytes += slot.bytes;
+    link(index);
+
+    const Counter num = (slot.generation << SLOT_BITS) | index;
+    enforceLimits(index);
+    return num;
+}
+
+
+/**
+ * Returns a used or an evicted slot.
+ * Returns NULL, if the number is unknown or stale.
+ */
+Register::Slot*
+Register::
+find(Register::Counter num)
+{
+    const Counter index = num & SLOT_MASK;
+    if (index == NO_SLOT || index >= m_slots.size())
+        return NULL;
+
+    Slot& slot = m_slots[index];
+    if (slot.state == SLOT_FREE || slot.generation != (num >> SLOT_BITS))
+        return NULL;
+    return &slot;
+}
+
+
+/**
+ * Insert the slot as the most recently used one.
+ */
+void
+Register::
+link(Counter index)
+{
+    Slot& slot = m_slots[index];
+    slot.prev = NO_SLOT;
+    slot.next = m_lru_head;
+    if (m_lru_head != NO_SLOT)
+        m_slots[m_lru_head].prev = index;
+    else
+        m_lru_tail = index;
+    m_lru_head = index;
+}
+
+
+void
+Register::
+unlink(Counter index)
+{
+    Slot& slot = m_slots[index];
+    if (slot.prev != NO_SLOT)
+        m_slots[slot.prev].next = slot.next;
+    else
+        m_lru_head = slot.next;
+
+    if (slot.next != NO_SLOT)
+        m_slots[slot.next].prev = slot.prev;
+    else
+        m_lru_tail = slot.prev;
+
+    slot.prev = slot.next = NO_SLOT;
+}
+
+
+/**
+ * Return the slot into the free list.
+ */
+void
+Register::
+release(Slot& slot, Counter index)
+{
+    // The element is destroyed, when the slot is consistent again.
+    Element elem = slot.element;
+    slot.element = Element();
+    if (slot.state == SLOT_USED)
+    {
+        unlink(index);
+        m_size--;
+        m_bytes -= slot.bytes;
+    }
+    slot.state = SLOT_FREE;
+    slot.bytes = 0;
+
+    // A slot with the last generation is retired, its numbers are not reused.
+    if (slot.generation == MAX_GENERATION)
+        return;
+    slot.generation++;
+    slot.next_free = m_free;
+    m_free = index;
+}
+
+
+/**
+ * Drop the element, but keep the number until it is released.
+ */
+void
+Register::
+evict(Counter index)
+{
+    Slot& slot = m_slots[index];
+    Element elem = slot.element;
+    slot.element = Element();
+    unlink(index);
+    m_size--;
+    m_bytes -= slot.bytes;
+    slot.bytes = 0;
+    slot.state = SLOT_EVICTED;
+}
+
+
+/**
+ * The element at @a protected_index is just returned to the caller,
+ * it is never evicted.
+ */
+void
+Register::
+enforceLimits(Counter protected_index)
+{
+    if (m_idle_ttl)
+        evictIdle(protected_index);
+
+    if (m_max_bytes)
+        while (m_bytes > m_max_bytes
+            && m_lru_tail != NO_SLOT && m_lru_tail != protected_index)
+        {
+            evict(m_lru_tail);
+            m_evicted_by_budget++;
+        }
 }
 
-Element 
+
+/**
+ * Idle elements are at the tail of the LRU list.
+ */
+void
+Register::
+evictIdle(Counter protected_index)
+{
+    const uint64_t now = monotonicNow();
+    while (m_lru_tail != NO_SLOT && m_lru_tail != protected_index
+        && now - m_slots[m_lru_tail].last_used >= m_idle_ttl)
+    {
+        evict(m_lru_tail);
+        m_evicted_by_ttl++;
+    }
+}
+
+
+/**
+ * An element, which was idle longer than the TTL, is evicted here,
+ * even if nothing was put since then.
+ */
+Element
 Register::
 get(Register::Counter num)
 {
-    typename Hash::iterator i; 
-    i = m_elements.find(num);
+    if (m_idle_ttl)
+        evictIdle(NO_SLOT);
 
-    if (i == m_elements.end())
+    Slot* p_slot = find(num);
+    if (p_slot == NULL)
         throw ElementNotFoundDriverError(POS, num);
 
-    return i->second;
+    if (p_slot->state == SLOT_EVICTED)
+        throw ElementEvictedDriverError(POS, num);
+
+    const Counter index = num & SLOT_MASK;
+    if (m_lru_head != index)
+    {
+        unlink(index);
+        link(index);
+    }
+    if (m_idle_ttl)
+        p_slot->last_used = monotonicNow();
+    return p_slot->element;
 }
 
 void
 Register::
 remove(Register::Counter num)
 {
-    typename Hash::iterator i; 
-    i = m_elements.find(num);
-
-    if (i == m_elements.end())
+    Slot* p_slot = find(num);
+    if (p_slot == NULL)
         throw ElementNotFoundDriverError(POS, num);
 
-    m_elements.erase(i);
+    release(*p_slot, num & SLOT_MASK);
 }
 
 
@@ -52,13 +230,74 @@ void
 Register::
 removeAny(Register::Counter num)
 {
-    typename Hash::iterator i; 
-    i = m_elements.find(num);
+    Slot* p_slot = find(num);
+    if (p_slot != NULL)
+        release(*p_slot, num & SLOT_MASK);
+}
+
 
-    if (i != m_elements.end())
-        m_elements.erase(i);
+void
+Register::
+setLimits(size_t max_bytes, uint32_t idle_ttl)
+{
+    const bool was_ttl_set = m_idle_ttl != 0;
+    m_max_bytes = max_bytes;
+    m_idle_ttl  = static_cast<uint64_t>(idle_ttl) * 1000;
+
+    // Timestamps were not updated without the TTL.
+    if (m_idle_ttl && !was_ttl_set)
+    {
+        const uint64_t now = monotonicNow();
+        for (Counter index = m_lru_head; index != NO_SLOT;
+             index = m_slots[index].next)
+            m_slots[index].last_used = now;
+    }
+    enforceLimits(NO_SLOT);
+}
+
+
+void
+Register::
+applyLimits()
+{
+    enforceLimits(NO_SLOT);
+}
+
+
+void
+Register::
+typeInfo(TypeInfoMap& info)
+{
+    for (Counter index = m_lru_head; index != NO_SLOT;
+         index = m_slots[index].next)
+    {
+        Element& elem = m_slots[index].element;
+        TypeInfo& type_info = info[elem.type()];
+        type_info.count++;
+        type_info.bytes += elem.approximate_total_size();
+    }
 }
 
+
+uint32_t
+Register::
+oldestAge() const
+{
+    if (m_lru_head == NO_SLOT)
+        return 0;
+
+    uint64_t oldest = m_slots[m_lru_head].created;
+    for (Counter index = m_lru_head; index != NO_SLOT;
+         index = m_slots[index].next)
+        if (m_slots[index].created < oldest)
+            oldest = m_slots[index].created;
+
+    const uint64_t age = (monotonicNow() - oldest) / 1000;
+    const uint32_t max_uint = ~static_cast<uint32_t>(0);
+    return age > max_uint ? max_uint : static_cast<uint32_t>(age);
+}
+
+
 Register::
 ~Register()
 {
@@ -68,15 +307,19 @@ Register::
 
 /**
  * This method is called from m_stores.clear, that is called from driver.clear.
- * It is called for all ObjectRegisters twice: the first tile, it is called 
+ * It is called for all ObjectRegisters twice: the first tile, it is called
  * while all other registers alive (directly), the second time, when they
  * are alive partically (from ~ObjectRegister).
+ *
+ * Generations are kept, so numbers of released elements stay invalid.
  */
 void
 Register::
 clear()
 {
-    m_elements.clear();
+    for (Counter index = 1; index < m_slots.size(); index++)
+        if (m_slots[index].state != SLOT_FREE)
+            release(m_slots[index], index);
 }
 
 XAPIAN_RESOURCE_NS_END
@@ -2,24 +2,10 @@
 #define RESOURCE_REGISTER_H
 
 #include <stdint.h>
-
-// Google dense map can be used as a store for ObjectBaseRegister.
-#ifndef GOOGLE_HASH_MAP
-/* Use google hash map */
-#include <google/dense_hash_map>
-/* dirty code begin */
-#include HASH_FUN_H
-#define HASH_TPL SPARSEHASH_HASH
-#define HASH_MAP google::dense_hash_map
-/* dirty code end */
-
-#else
-
-/* Use xapian wrapper for hash map */
-#include "unordered_map.h"
-#define HASH_TPL std::hash
-#define HASH_MAP std::unordered_map
-#endif
+#include <cstddef>
+#include <vector>
+#include <map>
+#include <string>
 
 #include "resource/element.h"
 
@@ -27,24 +13,123 @@
 
 XAPIAN_RESOURCE_NS_BEGIN
 
+/**
+ * Statistics of live elements of the same type.
+ */
+struct TypeInfo
+{
+    uint32_t    count;
+    size_t      bytes;
+
+    TypeInfo() : count(0), bytes(0) {}
+};
+
+typedef std::map<std::string, TypeInfo> TypeInfoMap;
+
+
+/**
+ * A table of elements, which are referenced from Erlang by number.
+ *
+ * Elements are stored in slots of a vector, released slots are kept in
+ * a free list and reused. A number packs an index of the slot and
+ * its generation. The generation is increased, when the slot is released,
+ * so an old number of a reused slot is not found.
+ *
+ * Used slots are also linked in the LRU order. If a memory budget or
+ * an idle TTL is set, the least recently used elements are evicted,
+ * when a new element is put. Idle elements are also evicted, when any
+ * element is looked up. There is no timer: a driver, which gets no
+ * commands, keeps its idle elements until the next one.
+ * An evicted slot keeps its number until Erlang releases it, 
+ * so a later use fails with ElementEvictedDriverError.
+ */
 class Register
 {
     typedef uint32_t Counter;
-    /**
-     * It is the mapping from id (of the type @ref Counter) to the 
-     * reference on the object.
-     *
-     * Id will be generated automatically.
-     */
-    typedef 
-    HASH_MAP< Counter, Element, HASH_TPL<uint32_t> > Hash;
+
+    /* Lower bits of the number are an index of the slot. */
+    static const unsigned SLOT_BITS = 22;
+    static const Counter  SLOT_MASK = (static_cast<Counter>(1) << SLOT_BITS) - 1;
+    static const Counter  MAX_GENERATION = ~static_cast<Counter>(0) >> SLOT_BITS;
+
+    /* The slot 0 is never used, so 0 is never a valid number. */
+    static const Counter  NO_SLOT = 0;
+
+    enum SlotState
+    {
+        SLOT_FREE,
+        SLOT_USED,
+        SLOT_EVICTED
+    };
+
+    struct Slot
+    {
+        Element     element;
+        Counter     generation;
+        uint8_t     state;
+
+        /* The next free slot, if this slot is free. */
+        Counter     next_free;
+
+        /* Neighbours in the LRU list, if this slot is used. */
+        Counter     prev;
+        Counter     next;
+
+        /* The approximate size of the element. */
+        size_t      bytes;
+
+        /* The monotonic time of the creation and of the last use 
+         * in microseconds. */
+        uint64_t    created;
+        uint64_t    last_used;
+
+        Slot()
+        : generation(0), state(SLOT_FREE), next_free(NO_SLOT),
+          prev(NO_SLOT), next(NO_SLOT), bytes(0), created(0), last_used(0)
+        {}
+    };
 
     private:
-    /* Contains a number of the last added object */
-    Counter m_counter;
+    std::vector<Slot> m_slots;
+
+    /* The head of the free list. */
+    Counter m_free;
+
+    /* The most and the least recently used slots. */
+    Counter m_lru_head;
+    Counter m_lru_tail;
+
+    /* The count of used slots and the sum of their sizes. */
+    Counter m_size;
+    size_t  m_bytes;
+
+    /* Limits, 0 means "no limit". The TTL is in microseconds. */
+    size_t   m_max_bytes;
+    uint64_t m_idle_ttl;
+
+    uint32_t m_evicted_by_budget;
+    uint32_t m_evicted_by_ttl;
+
+    Slot*
+    find(Counter num);
+
+    void
+    release(Slot& slot, Counter index);
+
+    void
+    evict(Counter index);
+
+    void
+    link(Counter index);
 
-    /* Stores a map. */
-    Hash m_elements;
+    void
+    unlink(Counter index);
+
+    void
+    enforceLimits(Counter protected_index);
+
+    void
+    evictIdle(Counter protected_index);
 
     public:
 
@@ -53,7 +138,7 @@ class Register
     Element
     get(Counter num);
 
-    Counter 
+    Counter
     put(Element);
 
     void
@@ -62,6 +147,72 @@ class Register
     void
     removeAny(Counter num);
 
+    /**
+     * Set the memory budget in bytes and the idle TTL in milliseconds.
+     * 0 disables the limit. Limits are applied immediately.
+     */
+    void
+    setLimits(size_t max_bytes, uint32_t idle_ttl);
+
+    /**
+     * Evict idle elements and elements over the budget.
+     */
+    void
+    applyLimits();
+
+    /**
+     * Count live elements and their current sizes by type.
+     * Sizes are measured again, so they can differ from @ref bytes.
+     */
+    void
+    typeInfo(TypeInfoMap& info);
+
+    /**
+     * The age of the oldest live element in milliseconds, 
+     * 0 if there are no elements.
+     */
+    uint32_t
+    oldestAge() const;
+
+    Counter
+    size() const
+    {
+        return m_size;
+    }
+
+    size_t
+    bytes() const
+    {
+        return m_bytes;
+    }
+
+    size_t
+    maxBytes() const
+    {
+        return m_max_bytes;
+    }
+
+    /**
+     * In milliseconds.
+     */
+    uint32_t
+    idleTtl() const
+    {
+        return static_cast<uint32_t>(m_idle_ttl / 1000);
+    }
+
+    uint32_t
+    evictedByBudget() const
+    {
+        return m_evicted_by_budget;
+    }
+
+    uint32_t
+    evictedByTtl() const
+    {
+        return m_evicted_by_ttl;
+    }
+
     ~Register();
     void clear();
 };
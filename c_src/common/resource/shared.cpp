@@ -0,0 +1,155 @@
+#include "resource/shared.h"
+#include <xapian.h>
+
+XAPIAN_RESOURCE_NS_BEGIN
+
+/* It is created, when the library is loaded. */
+static SharedRegistry shared_registry;
+
+
+SharedStopper::
+~SharedStopper()
+{
+    delete mp_stopper;
+}
+
+
+SharedRegistry::
+SharedRegistry()
+{
+    pthread_mutex_init(&m_lock, NULL);
+}
+
+
+/**
+ * All controllers are destroyed before, objects are not used.
+ */
+SharedRegistry::
+~SharedRegistry()
+{
+    for (Objects::iterator i = m_objects.begin(), e = m_objects.end();
+         i != e; i++)
+        delete i->second;
+    pthread_mutex_destroy(&m_lock);
+}
+
+
+SharedRegistry&
+SharedRegistry::
+instance()
+{
+    return shared_registry;
+}
+
+
+/**
+ * FNV-1a.
+ */
+uint32_t
+SharedRegistry::
+hash(const std::string& name, const char* params, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < name.size(); i++)
+        h = (h ^ static_cast<uint8_t>(name[i])) * 16777619u;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ static_cast<uint8_t>(params[i])) * 16777619u;
+    return h;
+}
+
+
+SharedObject*
+SharedRegistry::
+find(uint32_t h, const std::string& name, const char* params, size_t len)
+{
+    std::pair<Objects::iterator, Objects::iterator> range =
+        m_objects.equal_range(h);
+    for (Objects::iterator i = range.first; i != range.second; i++)
+    {
+        SharedObject* p_obj = i->second;
+        if (p_obj->m_name == name && p_obj->m_params.size() == len
+         && p_obj->m_params.compare(0, len, params, len) == 0)
+        {
+            p_obj->m_refs++;
+            return p_obj;
+        }
+    }
+    return NULL;
+}
+
+
+SharedObject*
+SharedRegistry::
+acquire(const std::string& name, const char* params, size_t len)
+{
+    const uint32_t h = hash(name, params, len);
+
+    pthread_mutex_lock(&m_lock);
+    SharedObject* p_found = find(h, name, params, len);
+    pthread_mutex_unlock(&m_lock);
+    return p_found;
+}
+
+
+SharedObject*
+SharedRegistry::
+insert(const std::string& name, const char* params, size_t len,
+       SharedObject* p_obj)
+{
+    // Fields are filled before the lock, the object is not visible yet.
+    p_obj->m_name.assign(name);
+    p_obj->m_params.assign(params, len);
+    p_obj->m_hash = hash(name, params, len);
+    p_obj->m_refs = 1;
+
+    pthread_mutex_lock(&m_lock);
+    SharedObject* p_old = find(p_obj->m_hash, name, params, len);
+    if (p_old == NULL)
+        m_objects.insert(Objects::value_type(p_obj->m_hash, p_obj));
+    pthread_mutex_unlock(&m_lock);
+
+    if (p_old != NULL)
+    {
+        // Another thread was first.
+        delete p_obj;
+        return p_old;
+    }
+    return p_obj;
+}
+
+
+void
+SharedRegistry::
+release(SharedObject* p_obj)
+{
+    pthread_mutex_lock(&m_lock);
+    const bool is_last = --p_obj->m_refs == 0;
+    if (is_last)
+    {
+        std::pair<Objects::iterator, Objects::iterator> range =
+            m_objects.equal_range(p_obj->m_hash);
+        for (Objects::iterator i = range.first; i != range.second; i++)
+            if (i->second == p_obj)
+            {
+                m_objects.erase(i);
+                break;
+            }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (is_last)
+        delete p_obj;
+}
+
+
+uint32_t
+SharedRegistry::
+size()
+{
+    pthread_mutex_lock(&m_lock);
+    const uint32_t count = static_cast<uint32_t>(m_objects.size());
+    pthread_mutex_unlock(&m_lock);
+    return count;
+}
+
+XAPIAN_RESOURCE_NS_END
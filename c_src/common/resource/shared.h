@@ -0,0 +1,127 @@
+#ifndef RESOURCE_SHARED_H
+#define RESOURCE_SHARED_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <pthread.h>
+
+#include "xapian_config.h"
+
+namespace Xapian
+{
+    class Stopper;
+}
+
+XAPIAN_RESOURCE_NS_BEGIN
+
+/**
+ * An immutable object, which is shared by all drivers of the process.
+ *
+ * It is identified by the name of the constructor and by encoded parameters.
+ * The reference counter is protected by the lock of @ref SharedRegistry.
+ */
+class SharedObject
+{
+    friend class SharedRegistry;
+
+    std::string m_name;
+    std::string m_params;
+    uint32_t    m_hash;
+    uint32_t    m_refs;
+
+    public:
+    SharedObject() : m_hash(0), m_refs(0) {}
+
+    virtual
+    ~SharedObject() {}
+};
+
+
+/**
+ * A stopper is used by pointer from QueryParser and TermGenerator,
+ * it is never copied, so it can be used from few threads at once.
+ */
+class SharedStopper : public SharedObject
+{
+    Xapian::Stopper* mp_stopper;
+
+    public:
+    SharedStopper(Xapian::Stopper* p_stopper) : mp_stopper(p_stopper) {}
+    ~SharedStopper();
+
+    Xapian::Stopper&
+    get()
+    {
+        return *mp_stopper;
+    }
+};
+
+
+/**
+ * A process-wide table of shared objects.
+ *
+ * Each Driver has its own Register and its own controllers, only
+ * the heavy immutable object is shared.
+ */
+class SharedRegistry
+{
+    typedef std::multimap<uint32_t, SharedObject*> Objects;
+
+    Objects         m_objects;
+    pthread_mutex_t m_lock;
+
+    /// Copy is not allowed.
+    SharedRegistry(const SharedRegistry&);
+    SharedRegistry& operator=(const SharedRegistry&);
+
+    static uint32_t
+    hash(const std::string& name, const char* params, size_t len);
+
+    /**
+     * Returns a new reference on the object or NULL.
+     * It is called with the lock held.
+     */
+    SharedObject*
+    find(uint32_t h, const std::string& name, const char* params, size_t len);
+
+    public:
+    SharedRegistry();
+    ~SharedRegistry();
+
+    static SharedRegistry&
+    instance();
+
+    /**
+     * Returns a new reference on the object or NULL.
+     */
+    SharedObject*
+    acquire(const std::string& name, const char* params, size_t len);
+
+    /**
+     * Add @a p_obj and return a new reference on it.
+     * If another thread has added the same object, then @a p_obj is
+     * deleted and the old object is returned.
+     * The lookup and the insertion are done under the same lock,
+     * so two equal objects are never registered.
+     */
+    SharedObject*
+    insert(const std::string& name, const char* params, size_t len,
+           SharedObject* p_obj);
+
+    /**
+     * The object is deleted, when the last reference is released.
+     */
+    void
+    release(SharedObject* p_obj);
+
+    /**
+     * The count of shared objects.
+     */
+    uint32_t
+    size();
+};
+
+XAPIAN_RESOURCE_NS_END
+#endif
@@ -23,11 +23,18 @@ XAPIAN_ERLANG_NS_BEGIN
 // -------------------------------------------------------------------
 
 /*
- * The length of free space in bytes, 
- * which will be allocatied new memory for storing result. 
+ * The minimal length of free space in bytes, 
+ * which will be left in a new segment after the term. 
  */
 #define RESERVED_LEN 100
 
+/*
+ * Terms with this length or longer, that do not fit into the next segment,
+ * are stored in their own segment without reserved space. 
+ * Such segment can be passed to the VM as is.
+ */
+#define LARGE_TERM_LEN 4096
+
 /* Helper used by ResultEncoder. */
 #define SIZE_OF_SEGMENT(LEN) (sizeof(DataSegment) + (LEN) - 1)
 
@@ -62,11 +69,67 @@ ResultEncoder::setBuffer(char* rbuf, const size_t rlen)
     m_current_len = 0;
     // No additional segments are allocated.
     m_first_segment = NULL;
+    m_default_used = 0;
+    m_boundary = NULL;
+    m_next_segment_len = RESULT_SEGMENT_MIN_LEN;
+    m_reserve_len = 0;
+    m_segment_count = 0;
+    m_reserved_len = 0;
+}
+
+
+void
+ResultEncoder::reserve(size_t len)
+{
+    if (len <= m_left_len)
+        return;
+
+    /* The rest of the current buffer will be used first. */
+    size_t segment_len = len - m_left_len;
+    if (segment_len > m_max_segment_len)
+        segment_len = m_max_segment_len;
+    if (segment_len > m_reserve_len)
+        m_reserve_len = segment_len;
+}
+
+
+void
+ResultEncoder::setMaxSegmentLen(size_t len)
+{
+    m_max_segment_len = len;
+    if (m_next_segment_len > len)
+        m_next_segment_len = len;
+}
+
+
+size_t
+ResultEncoder::nextSegmentLen(size_t min_len)
+{
+    size_t len = m_next_segment_len;
+    if (m_reserve_len > len)
+        len = m_reserve_len;
+    m_reserve_len = 0;
+    /* The ceiling could be lowered after the reservation. */
+    if (len > m_max_segment_len)
+        len = m_max_segment_len;
+
+    if (len < min_len + RESERVED_LEN)
+        /* Large terms get their own segment without reserved space. */
+        len = (min_len >= LARGE_TERM_LEN) ? min_len : min_len + RESERVED_LEN;
+
+    const size_t next_len = m_next_segment_len * 2;
+    m_next_segment_len = (next_len < m_max_segment_len) 
+        ? next_len 
+        : m_max_segment_len;
+
+    m_segment_count++;
+    m_reserved_len += len;
+    return len;
 }
 
 
 ResultEncoder& 
-ResultEncoder::operator<<(const std::string str)
+ResultEncoder::operator<<(const std::string& str)
 {
     uint32_t len = static_cast<uint32_t>( str.length() );
     PUT_VALUE(len);
@@ -138,7 +201,8 @@ ResultEncoder::put(const char* term, const size_t term_len)
     const bool large = allocated 
         || m_default_buf == NULL 
         || new_len > m_default_len;
-    const bool no_alloc = allocated && term_len <= m_left_len;
+    const bool no_alloc = (allocated && term_len <= m_left_len)
+        || (large && !allocated && growBuffer(new_len));
 
     if (!large || no_alloc)
     {
@@ -149,12 +213,16 @@ ResultEncoder::put(const char* term, const size_t term_len)
         m_current_buf += term_len;
         m_left_len -= term_len;
     }
+    else if (m_is_aligned && m_boundary != NULL)
+    {
+        moveItem(term, term_len);
+    }
     else 
     {
         /* part1 will stay in a default buffer. */
         const size_t part1_len = m_left_len;
         const size_t part2_len = term_len - part1_len;
-        const size_t new_segment_len = part2_len + RESERVED_LEN;
+        const size_t new_segment_len = nextSegmentLen(part2_len);
 
         /* Create new data segment. */
         DataSegment* 
@@ -172,30 +240,106 @@ ResultEncoder::put(const char* term, const size_t term_len)
         memcpy(part1_dest, part1_src, part1_len);
         memcpy(part2_dest, part2_src, part2_len);
 
-        if (m_first_segment == NULL) {
-            /* Set as a first segment. */
-            m_first_segment = new_segment;
-        } else {
-            /* Link to a last segment. */
-            m_last_segment->next = new_segment;
-        }
+        /* The current chunk is full. */
+        link(new_segment, m_current_buf + part1_len);
 
         /* Save state */
-        m_last_segment = new_segment;
         m_current_buf = part2_dest + part2_len;
-        m_left_len = RESERVED_LEN;
+        m_left_len = new_segment_len - part2_len;
     }
     
     m_current_len = new_len;
 }
 
 
+bool
+ResultEncoder::growBuffer(size_t new_len)
+{
+    if (mp_grower == NULL || m_default_buf == NULL)
+        return false;
+
+    /* Grow geometrically, the reservation is used for the rest. */
+    size_t len = m_default_len * 2;
+    if (len < m_default_len + m_reserve_len)
+        len = m_default_len + m_reserve_len;
+    if (len < new_len + RESERVED_LEN)
+        len = new_len + RESERVED_LEN;
+
+    /* The old buffer can be freed by the grower. */
+    const size_t boundary_pos = (m_boundary == NULL) ? 0
+        : static_cast<size_t>(m_boundary - m_default_buf);
+    char* buf = mp_grower->grow(len);
+    if (buf == NULL)
+        return false;
+
+    m_reserve_len = 0;
+    if (m_boundary != NULL)
+        m_boundary = buf + boundary_pos;
+    m_default_buf = buf;
+    m_current_buf = buf + m_current_len;
+    m_default_len = len;
+    m_left_len = len - m_current_len;
+    return true;
+}
+
+
+/**
+ * Moves the current item and appends @a term to it in a new segment.
+ * The old chunk ends at the boundary.
+ */
+void
+ResultEncoder::moveItem(const char* term, const size_t term_len)
+{
+    const size_t item_len = static_cast<size_t>(m_current_buf - m_boundary);
+    /* Room for the rest of the item, as long as its beginning. 
+       If the item grows further, it is moved again. */
+    const size_t new_segment_len = nextSegmentLen(item_len * 2 + term_len);
+
+    DataSegment* 
+    new_segment = alloc(new_segment_len);
+    new_segment->size = new_segment_len;
+    new_segment->next = NULL;
+
+    char* dest = new_segment->data;
+    memcpy(dest, m_boundary, item_len);
+    memcpy(dest + item_len, term, term_len);
+
+    link(new_segment, m_boundary);
+
+    m_boundary = dest;
+    m_current_buf = dest + item_len + term_len;
+    m_left_len = new_segment_len - item_len - term_len;
+}
+
+
+/**
+ * Appends @a new_segment to the chain.
+ * @a chunk_end points after the last used byte of the current chunk.
+ */
+void
+ResultEncoder::link(DataSegment* new_segment, const char* chunk_end)
+{
+    if (m_first_segment == NULL) {
+        /* Set as a first segment. */
+        m_default_used = static_cast<size_t>(chunk_end - m_default_buf);
+        m_first_segment = new_segment;
+    } else {
+        /* Shrink to the used part. */
+        m_last_segment->size = 
+            static_cast<size_t>(chunk_end - m_last_segment->data);
+        /* Link to a last segment. */
+        m_last_segment->next = new_segment;
+    }
+    m_last_segment = new_segment;
+}
+
+
 /**
  * Clear the state of the object.
  */
 void 
 ResultEncoder::clear() {
-    if (m_current_len > m_default_len)
+    if (isExtended())
     {
         do 
         {
@@ -219,6 +363,7 @@ ResultEncoder::clear() {
 
     m_first_segment = NULL;
     m_current_buf = NULL;
+    m_boundary = NULL;
     m_current_len = 0;
 }
 
@@ -239,12 +384,9 @@ void ResultEncoder::reset()
  * Return true, if this class allocated memory.
  */
 bool ResultEncoder::isExtended() const {
-    // m_current_len was modified with put calls.
-    // m_default_len is modified only by setBuffer call.
-    //
-    // This meand, that if m_current_len is lower or equal then m_default_len,
-    // then the result is too small and fits the preallocated buffer.
-    return (m_current_len > m_default_len);
+    // The first segment is allocated, when the preallocated buffer is full
+    // or, in the aligned mode, when the current item does not fit it.
+    return m_first_segment != NULL;
 }
 
 
@@ -256,9 +398,9 @@ bool ResultEncoder::isExtended() const {
 void ResultEncoder::finalize(char* dest) {
     assert(isExtended());
     char* src = m_default_buf;
-    // Copy m_default_len bytes from src to dest.
-    memcpy(dest, src, m_default_len);
-    dest += m_default_len;
+    // Copy m_default_used bytes from src to dest.
+    memcpy(dest, src, m_default_used);
+    dest += m_default_used;
 
     /* Shrink data size to copy. */
     m_last_segment->size -= m_left_len;
@@ -270,7 +412,6 @@ void ResultEncoder::finalize(char* dest) {
         assert(m_first_segment->next != m_first_segment);
 
         const size_t segment_size = m_first_segment->size;
-        assert(segment_size > 0);
 
         /* Real buffer length is not greater, then allocated buffer length. */
         src = m_first_segment->data;
@@ -304,10 +445,81 @@ size_t ResultEncoder::finalSize() const {
 }
 
 
+/**
+ * Copies chunks into an other encoder.
+ */
+class ResultAppender : public ResultVisitor
+{
+    ResultEncoder& m_dest;
+
+    public:
+    ResultAppender(ResultEncoder& dest) : m_dest(dest) {}
+
+    void 
+    visit(void* /* block */, const char* data, size_t len)
+    {
+        m_dest.put(data, len);
+    }
+};
+
+
+void ResultEncoder::append(const ResultEncoder& other)
+{
+    ResultAppender appender(*this);
+    other.visit(appender);
+}
+
+
+size_t ResultEncoder::chunkCount() const
+{
+    size_t count = 1;
+    if (isExtended())
+        for (const DataSegment* seg = m_first_segment; seg != NULL; 
+             seg = seg->next)
+            count++;
+    return count;
+}
+
+
+void ResultEncoder::visit(ResultVisitor& visitor) const
+{
+    if (!isExtended())
+    {
+        visitor.visit(NULL, m_default_buf, m_current_len);
+        return;
+    }
+
+    visitor.visit(NULL, m_default_buf, m_default_used);
+    for (DataSegment* seg = m_first_segment; seg != NULL; seg = seg->next)
+    {
+        /* Free space is only at the end of the last segment. */
+        const size_t used = (seg == m_last_segment) 
+            ? seg->size - m_left_len
+            : seg->size;
+        visitor.visit(seg, seg->data, used);
+    }
+}
+
+
 bool ResultEncoder::maybe(bool is_exists)
 {
     PUT_VALUE(is_exists);
     return is_exists;
 }
 
+
+void ResultEncoder::putVarint(uint32_t value)
+{
+    /* 7 bits per byte, the high bit is set, if more bytes follow. */
+    char buf[5];
+    size_t len = 0;
+    while (value >= 0x80)
+    {
+        buf[len++] = static_cast<char>( (value & 0x7F) | 0x80 );
+        value >>= 7;
+    }
+    buf[len++] = static_cast<char>( value );
+    put(buf, len);
+}
+
 XAPIAN_ERLANG_NS_END
@@ -13,6 +13,49 @@ XAPIAN_ERLANG_NS_BEGIN
 typedef struct DataSegment DataSegment;
 struct DataSegment;
 
+/* The length of the first allocated segment. Each next segment is twice
+   as long, until the ceiling is reached. */
+#define RESULT_SEGMENT_MIN_LEN 1024
+
+/* The default ceiling of the segment length. */
+#define RESULT_SEGMENT_MAX_LEN (1024 * 1024)
+
+
+/**
+ * Receives the encoded result piece by piece without merging.
+ * @see ResultEncoder::visit
+ */
+class ResultVisitor
+{
+    public:
+    virtual ~ResultVisitor() {}
+
+    /**
+     * @a block is a pointer, returned by MemoryManager::alloc or NULL for
+     * the preallocated buffer. 
+     * @a data points to the first byte of the chunk inside @a block.
+     */
+    virtual void 
+    visit(void* block, const char* data, size_t len) = 0;
+};
+
+/**
+ * Grows the preallocated buffer of ResultEncoder in place.
+ * @see ResultEncoder::setGrower
+ */
+class ResultBufferGrower
+{
+    public:
+    virtual ~ResultBufferGrower() {}
+
+    /**
+     * Returns a buffer of @a len bytes with the content of the current 
+     * one, or NULL, if it cannot grow. The old buffer is not used then.
+     */
+    virtual char*
+    grow(size_t len) = 0;
+};
+
 // -------------------------------------------------------------------
 // Result encoder: appends variables to the buffer
 // -------------------------------------------------------------------
@@ -43,6 +86,15 @@ class ResultEncoder
     /* How many bytes were allocated, but not used. */
     size_t  m_left_len;
 
+    /* Bytes of the preallocated buffer in the result, if it is extended. */
+    size_t  m_default_used;
+
+    /* Chunks are cut only at boundaries, see @ref setAligned. */
+    bool    m_is_aligned;
+
+    /* The last boundary in the current chunk or NULL. */
+    char*   m_boundary;
+
     /* Next segment */
     /* NULL, if no memory was allocated. */
     DataSegment* m_first_segment;
@@ -50,6 +102,22 @@ class ResultEncoder
     /* Can has undefined value, if no memory was allocated. */
     DataSegment* m_last_segment;
 
+    /* The length of the next segment, it grows geometrically. */
+    size_t  m_next_segment_len;
+
+    /* The ceiling of m_next_segment_len. */
+    size_t  m_max_segment_len;
+
+    /* The length of the next segment, requested with @ref reserve. */
+    size_t  m_reserve_len;
+
+    /* Statistics */
+    size_t  m_segment_count;
+    size_t  m_reserved_len;
+
+    /* NULL, if the preallocated buffer cannot grow. */
+    ResultBufferGrower* mp_grower;
+
 
     /**
      * Allocate a new data segment and return a pointer on it. 
@@ -62,9 +130,35 @@ class ResultEncoder
      */
     void free(DataSegment*& pos);
 
+    /**
+     * Returns the length of a new segment, which must hold at least 
+     * @a min_len bytes, and advances the growth policy.
+     */
+    size_t
+    nextSegmentLen(size_t min_len);
+
+    void
+    moveItem(const char* term, const size_t term_len);
+
+    void
+    link(DataSegment* new_segment, const char* chunk_end);
+
+    /**
+     * Returns false, if the preallocated buffer cannot grow for 
+     * @a new_len bytes of the result.
+     */
+    bool
+    growBuffer(size_t new_len);
+
     public:
     ResultEncoder(MemoryManager& mm) 
-        : m_mm(mm), m_current_buf(NULL)
+        : m_mm(mm), m_current_buf(NULL), 
+          m_is_aligned(false), m_boundary(NULL),
+          m_first_segment(NULL),
+          m_next_segment_len(RESULT_SEGMENT_MIN_LEN),
+          m_max_segment_len(RESULT_SEGMENT_MAX_LEN),
+          m_reserve_len(0), m_segment_count(0), m_reserved_len(0),
+          mp_grower(NULL)
     {}
 
     /**
@@ -74,7 +168,8 @@ class ResultEncoder
     setBuffer(char* rbuf, const size_t rlen);
 
     ResultEncoder(MemoryManager& mm, char* rbuf, const size_t rlen) 
-        : m_mm(mm)
+        : m_mm(mm), m_is_aligned(false), 
+          m_max_segment_len(RESULT_SEGMENT_MAX_LEN), mp_grower(NULL)
     {
         setBuffer(rbuf, rlen);
     }
@@ -82,7 +177,7 @@ class ResultEncoder
     /*! \name Appends variables to the buffer. */
     /*! \{ */
     ResultEncoder& 
-    operator<<(const std::string str);
+    operator<<(const std::string& str);
 
     ResultEncoder& 
     operator<<(const char * str);
@@ -99,15 +194,100 @@ class ResultEncoder
 
     bool maybe(bool is_exists);
 
+    /**
+     * Appends @a value as an unsigned LEB128 varint (1-5 bytes).
+     */
+    void putVarint(uint32_t value);
+
     /**
      * It is used by `<<` operators.
      * Appends a block of data of size @a term_len to the result.
      */
     void put(const char* term, const size_t term_len);
 
+    /**
+     * Make sure, that next @a len bytes can be put without allocating 
+     * more then one segment. Nothing is allocated until it is needed.
+     * The reservation is limited by the ceiling of the segment length,
+     * larger results get few segments.
+     */
+    void reserve(size_t len);
+
+    /**
+     * Set the ceiling of the segment length for geometric growth.
+     */
+    void setMaxSegmentLen(size_t len);
+
+    /**
+     * If @a is_aligned is true, an item, started with @ref markBoundary,
+     * is never split between chunks: when it does not fit, its beginning
+     * is moved into the new segment. Chunks can be decoded one by one.
+     */
+    void
+    setAligned(bool is_aligned)
+    {
+        m_is_aligned = is_aligned;
+    }
+
+    /**
+     * If @a p_grower is set, the preallocated buffer is grown with it, 
+     * when it is full, and the result stays in one piece. 
+     * Segments are allocated only if it cannot grow.
+     * The grower is kept by @ref setBuffer, it must outlive the encoder.
+     */
+    void
+    setGrower(ResultBufferGrower* p_grower)
+    {
+        mp_grower = p_grower;
+    }
+
+    /**
+     * Marks the beginning of the next item.
+     */
+    void
+    markBoundary()
+    {
+        m_boundary = m_current_buf;
+    }
+
+    /**
+     * Returns the count of segments, allocated after the last 
+     * @ref setBuffer call.
+     */
+    size_t
+    segmentCount() const
+    {
+        return m_segment_count;
+    }
+
+    /**
+     * Returns the total length of these segments in bytes.
+     */
+    size_t
+    reservedLen() const
+    {
+        return m_reserved_len;
+    }
+
+    /**
+     * Appends the whole content of @a other.
+     */
+    void append(const ResultEncoder& other);
+
     void finalize(char*);
     size_t finalSize() const;
 
+    /**
+     * Pass the preallocated buffer and all segments to @a visitor in order.
+     * Data is not copied and stays owned by the encoder.
+     */
+    void visit(ResultVisitor& visitor) const;
+
+    /**
+     * Returns the count of chunks, that will be passed to the visitor.
+     */
+    size_t chunkCount() const;
+
     /** 
      * Returns true, if the existed buffer is too small.
      */
@@ -0,0 +1,78 @@
+#ifndef XAPIAN_RETRIEVAL_SCHEMA_H
+#define XAPIAN_RETRIEVAL_SCHEMA_H
+
+// External imports
+#include <vector>
+#include <stdint.h>
+
+// Internal imports
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * A list of fields to write for each document or term.
+ *
+ * It is decoded once from the schema, sent by Erlang
+ * (see `xapian_record:encode' and `xapian_term_record:encode').
+ * Then it is applied to each object of the page without re-reading
+ * the raw bytes. Commands are checked by Driver, when the schema is built.
+ */
+class RetrievalSchema
+{
+    public:
+    struct Field
+    {
+        uint8_t     command;
+
+        /* A value slot for GET_VALUE and GET_FLOAT_VALUE. */
+        uint32_t    slot;
+    };
+
+    typedef std::vector<Field>::const_iterator const_iterator;
+
+    private:
+    std::vector<Field>  m_fields;
+
+    /* DEC_DOCUMENT, DEC_ITERATOR or DEC_BOTH for documents. */
+    uint8_t             m_decoder_type;
+
+    public:
+    RetrievalSchema() : m_decoder_type(0)
+    {}
+
+    void
+    setDecoderType(uint8_t decoder_type)
+    {
+        m_decoder_type = decoder_type;
+    }
+
+    uint8_t
+    decoderType() const
+    {
+        return m_decoder_type;
+    }
+
+    void
+    add(uint8_t command, uint32_t slot = 0)
+    {
+        Field field;
+        field.command = command;
+        field.slot    = slot;
+        m_fields.push_back(field);
+    }
+
+    const_iterator
+    begin() const
+    {
+        return m_fields.begin();
+    }
+
+    const_iterator
+    end() const
+    {
+        return m_fields.end();
+    }
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
@@ -0,0 +1,251 @@
+#ifndef XAPIAN_RING_BUFFER_H
+#define XAPIAN_RING_BUFFER_H
+
+// External imports
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+// Internal imports
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/* A message cannot be split. If there is not enough space at the end of
+   the ring, this length is written and the message starts from offset 0. */
+#define RING_WRAP_MARK 0xFFFFFFFFU
+
+/* Messages are aligned on this boundary. */
+#define RING_ALIGN 4U
+
+
+/**
+ * The header of the ring. It is placed in the shared memory before data.
+ */
+struct RingHeader
+{
+    /* The offset of the next message, changed by the producer. */
+    volatile uint32_t   head;
+
+    /* The offset of the oldest message, changed by the consumer. */
+    volatile uint32_t   tail;
+
+    /* The length of the data area. */
+    uint32_t            capacity;
+    uint32_t            reserved;
+};
+
+
+/**
+ * A single-producer single-consumer queue of messages in the shared memory.
+ * A message is `Len:32/native, Data'. Data is always contiguous, so
+ * ParamDecoder and ResultEncoder can work with it in place.
+ *
+ * The ring is empty, when head = tail.
+ * The producer never fills the last @ref RING_ALIGN bytes before the tail.
+ */
+class RingBuffer
+{
+    RingHeader* m_header;
+    char*       m_data;
+
+    /* The state of the last reservation. */
+    uint32_t    m_reserved_offset;
+    bool        m_is_wrapped;
+
+    static uint32_t
+    align(uint32_t len)
+    {
+        return (len + RING_ALIGN - 1) & ~(RING_ALIGN - 1);
+    }
+
+    static void
+    barrier()
+    {
+        __sync_synchronize();
+    }
+
+    uint32_t
+    readLen(uint32_t offset) const
+    {
+        uint32_t len;
+        memcpy(&len, m_data + offset, sizeof(len));
+        return len;
+    }
+
+    void
+    writeLen(uint32_t offset, uint32_t len)
+    {
+        memcpy(m_data + offset, &len, sizeof(len));
+    }
+
+    public:
+    RingBuffer() : m_header(NULL), m_data(NULL),
+        m_reserved_offset(0), m_is_wrapped(false)
+    {}
+
+    /**
+     * Returns the size of the shared memory for a ring with
+     * @a capacity bytes of data.
+     */
+    static size_t
+    mappingSize(uint32_t capacity)
+    {
+        return sizeof(RingHeader) + align(capacity);
+    }
+
+    /**
+     * Use the ring, that starts from @a base.
+     * If @a capacity is not 0, then the ring is initialized as empty.
+     * Returns the position after the ring.
+     */
+    char*
+    attach(char* base, uint32_t capacity = 0)
+    {
+        m_header = reinterpret_cast<RingHeader*>( base );
+        m_data   = base + sizeof(RingHeader);
+        if (capacity != 0)
+        {
+            m_header->head     = 0;
+            m_header->tail     = 0;
+            m_header->capacity = align(capacity);
+            m_header->reserved = 0;
+        }
+        return m_data + m_header->capacity;
+    }
+
+    // ---------------------------------------------------------------
+    // Producer
+    // ---------------------------------------------------------------
+
+    /**
+     * Returns a pointer on the largest contiguous free block.
+     * @a max_len is set to its length. The block is not visible to
+     * the consumer until @ref commit is called.
+     * Returns NULL, if the ring is full.
+     */
+    char*
+    reserve(uint32_t& max_len)
+    {
+        const uint32_t capacity = m_header->capacity;
+        const uint32_t head = m_header->head;
+        barrier();
+        const uint32_t tail = m_header->tail;
+
+        uint32_t free_len;
+        m_is_wrapped = false;
+        m_reserved_offset = head;
+        if (head >= tail)
+        {
+            /* Free space at the end and at the beginning. */
+            const uint32_t end_len = capacity - head
+                                   - (tail == 0 ? RING_ALIGN : 0);
+            const uint32_t begin_len = (tail == 0) ? 0 : tail - RING_ALIGN;
+            free_len = end_len;
+            if (begin_len > end_len)
+            {
+                free_len = begin_len;
+                m_is_wrapped = true;
+                m_reserved_offset = 0;
+            }
+        }
+        else
+            free_len = tail - head - RING_ALIGN;
+
+        if (free_len <= sizeof(uint32_t))
+        {
+            max_len = 0;
+            return NULL;
+        }
+        max_len = free_len - static_cast<uint32_t>( sizeof(uint32_t) );
+        return m_data + m_reserved_offset + sizeof(uint32_t);
+    }
+
+    /**
+     * Publish @a len bytes of the reserved block as a message.
+     */
+    void
+    commit(uint32_t len)
+    {
+        if (m_is_wrapped)
+            writeLen(m_header->head, RING_WRAP_MARK);
+        writeLen(m_reserved_offset, len);
+
+        uint32_t new_head = m_reserved_offset
+            + static_cast<uint32_t>( sizeof(uint32_t) ) + align(len);
+        if (new_head == m_header->capacity)
+            new_head = 0;
+
+        /* Data must be visible before the new head. */
+        barrier();
+        m_header->head = new_head;
+    }
+
+    /**
+     * Copy a message into the ring.
+     * Returns false, if there is not enough space.
+     */
+    bool
+    write(const char* prefix, uint32_t prefix_len,
+          const char* data, uint32_t len)
+    {
+        uint32_t max_len;
+        char* dest = reserve(max_len);
+        if (dest == NULL || max_len < prefix_len + len)
+            return false;
+        memcpy(dest, prefix, prefix_len);
+        memcpy(dest + prefix_len, data, len);
+        commit(prefix_len + len);
+        return true;
+    }
+
+    // ---------------------------------------------------------------
+    // Consumer
+    // ---------------------------------------------------------------
+
+    /**
+     * Returns a pointer on the oldest message and sets @a len.
+     * The message stays in the ring until @ref release is called.
+     * Returns NULL, if the ring is empty.
+     */
+    char*
+    peek(uint32_t& len)
+    {
+        uint32_t tail = m_header->tail;
+        const uint32_t head = m_header->head;
+        barrier();
+        if (tail == head)
+            return NULL;
+
+        len = readLen(tail);
+        if (len == RING_WRAP_MARK)
+        {
+            tail = 0;
+            m_header->tail = 0;
+            if (tail == head)
+                return NULL;
+            len = readLen(tail);
+        }
+        return m_data + tail + sizeof(uint32_t);
+    }
+
+    /**
+     * Free the message, returned by @ref peek.
+     */
+    void
+    release()
+    {
+        const uint32_t tail = m_header->tail;
+        const uint32_t len = readLen(tail);
+        uint32_t new_tail = tail
+            + static_cast<uint32_t>( sizeof(uint32_t) ) + align(len);
+        if (new_tail == m_header->capacity)
+            new_tail = 0;
+
+        /* The data must be read before the space is reused. */
+        barrier();
+        m_header->tail = new_tail;
+    }
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
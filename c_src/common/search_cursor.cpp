@@ -0,0 +1,69 @@
+#include "search_cursor.h"
+#include <cstring>
+
+XAPIAN_ERLANG_NS_BEGIN
+
+/* Type:8, DocId:32 */
+#define SEARCH_CURSOR_HEADER_LEN 5
+
+
+std::string
+SearchCursor::encode(const SortOrder& order, const Xapian::MSetIterator& last)
+{
+    if (!order.hasCursors())
+        return std::string();
+
+    const uint32_t docid = static_cast<uint32_t>(*last);
+    std::string cursor;
+    cursor.reserve(SEARCH_CURSOR_HEADER_LEN);
+    cursor.push_back(static_cast<char>(order.type));
+    cursor.append(reinterpret_cast<const char*>(&docid), sizeof(docid));
+    if (order.type == SortOrder::BY_VALUE)
+        cursor.append(last.get_document().get_value(order.slot));
+    return cursor;
+}
+
+
+bool
+SearchCursor::decode(const SortOrder& order, const StringRef& cursor)
+{
+    if (cursor.size() < SEARCH_CURSOR_HEADER_LEN
+     || static_cast<uint8_t>(cursor.data()[0]) != order.type
+     || !order.hasCursors())
+        return false;
+
+    uint32_t docid;
+    memcpy(&docid, cursor.data() + 1, sizeof(docid));
+    m_type  = order.type;
+    m_docid = static_cast<Xapian::docid>(docid);
+    m_key.assign(cursor.data() + SEARCH_CURSOR_HEADER_LEN,
+                 cursor.size() - SEARCH_CURSOR_HEADER_LEN);
+    return true;
+}
+
+
+bool
+SearchCursor::isAfter(const SortOrder& order, const Xapian::Document& doc) const
+{
+    if (m_type == SortOrder::BY_VALUE)
+    {
+        int cmp = doc.get_value(order.slot).compare(m_key);
+        if (order.is_reverse)
+            cmp = -cmp;
+        if (cmp != 0)
+            return cmp > 0;
+    }
+
+    // Documents with the same key are ordered by docid.
+    const Xapian::docid docid = doc.get_docid();
+    return order.is_docid_descending ? docid < m_docid : docid > m_docid;
+}
+
+
+bool
+CursorMatchDecider::operator()(const Xapian::Document& doc) const
+{
+    return m_cursor.isAfter(m_order, doc);
+}
+
+XAPIAN_ERLANG_NS_END
@@ -0,0 +1,104 @@
+#ifndef XAPIAN_SEARCH_CURSOR_H
+#define XAPIAN_SEARCH_CURSOR_H
+
+// External imports
+#include <xapian.h>
+#include <string>
+#include <stdint.h>
+
+// Internal imports
+#include "string_ref.h"
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * How an Enquire orders documents, as far as cursors need to know.
+ * It is collected by Driver::fillEnquire.
+ */
+struct SortOrder
+{
+    enum Type
+    {
+        /* Weights cannot be checked by MatchDecider. */
+        BY_RELEVANCE    = 0,
+        /* BoolWeight without a sort key. */
+        BY_DOCID        = 1,
+        /* set_sort_by_value. */
+        BY_VALUE        = 2,
+        /* Other orders with keys or weights. */
+        BY_OTHER        = 3
+    };
+
+    uint8_t         type;
+    Xapian::valueno slot;
+    bool            is_reverse;
+    bool            is_docid_descending;
+
+    SortOrder()
+    : type(BY_RELEVANCE), slot(0), is_reverse(false),
+      is_docid_descending(false)
+    {}
+
+    bool
+    hasCursors() const
+    {
+        return type == BY_DOCID || type == BY_VALUE;
+    }
+};
+
+
+/**
+ * A position in a sorted result: the sort key and the docid of the last
+ * document of a page. Erlang gets it as an opaque binary.
+ *
+ * Format: Type:8, DocId:32, Key.
+ */
+class SearchCursor
+{
+    uint8_t         m_type;
+    Xapian::docid   m_docid;
+    std::string     m_key;
+
+    public:
+    SearchCursor() : m_type(SortOrder::BY_RELEVANCE), m_docid(0) {}
+
+    /**
+     * Returns an empty string, if the order has no cursors.
+     */
+    static std::string
+    encode(const SortOrder& order, const Xapian::MSetIterator& last);
+
+    /**
+     * Returns false, if the cursor is malformed or was made for
+     * another order.
+     */
+    bool
+    decode(const SortOrder& order, const StringRef& cursor);
+
+    /**
+     * Returns true, if @a doc is strictly after the cursor.
+     */
+    bool
+    isAfter(const SortOrder& order, const Xapian::Document& doc) const;
+};
+
+
+/**
+ * Accepts only documents after the cursor.
+ * The heap of the matcher keeps only one page.
+ */
+class CursorMatchDecider : public Xapian::MatchDecider
+{
+    const SortOrder     m_order;
+    const SearchCursor  m_cursor;
+
+    public:
+    CursorMatchDecider(const SortOrder& order, const SearchCursor& cursor)
+    : m_order(order), m_cursor(cursor)
+    {}
+
+    bool operator()(const Xapian::Document& doc) const;
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
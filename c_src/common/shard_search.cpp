@@ -0,0 +1,240 @@
+#include "shard_search.h"
+#include <algorithm>
+#include <cmath>
+
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * The same order as Xapian uses for relevance:
+ * the weight descending, then the docid ascending.
+ */
+static bool
+isBetterItem(const ShardMatchItem& a, const ShardMatchItem& b)
+{
+    if (a.weight != b.weight)
+        return a.weight > b.weight;
+    return a.docid < b.docid;
+}
+
+
+ShardSearcher::ShardSearcher(ThreadManager& tm)
+: m_tm(tm), m_is_local_weights(false), m_search_count(0),
+  m_next_shard(0), m_job_size(0), m_pending(0), m_is_stopping(false),
+  mp_deadline(NULL), m_limit(0)
+{
+    m_lock     = m_tm.createMutex();
+    m_has_work = m_tm.createCond();
+    m_is_done  = m_tm.createCond();
+}
+
+
+ShardSearcher::~ShardSearcher()
+{
+    stopThreads();
+    clear();
+    m_tm.destroyCond(m_is_done);
+    m_tm.destroyCond(m_has_work);
+    m_tm.destroyMutex(m_lock);
+}
+
+
+void
+ShardSearcher::addShard(const Xapian::Database& db)
+{
+    m_shards.push_back(new Shard(db));
+}
+
+
+void
+ShardSearcher::clear()
+{
+    for (size_t i = 0; i < m_shards.size(); i++)
+        delete m_shards[i];
+    m_shards.clear();
+}
+
+
+void
+ShardSearcher::setThreadCount(uint32_t count)
+{
+    stopThreads();
+    m_is_stopping = false;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        ThreadManager::Thread thread = 
+            m_tm.createThread(&ShardSearcher::threadMain, this);
+        if (thread == NULL)
+            break;
+        m_threads.push_back(thread);
+    }
+}
+
+
+void
+ShardSearcher::stopThreads()
+{
+    m_tm.lock(m_lock);
+    m_is_stopping = true;
+    m_tm.broadcast(m_has_work);
+    m_tm.unlock(m_lock);
+
+    for (size_t i = 0; i < m_threads.size(); i++)
+        m_tm.joinThread(m_threads[i]);
+    m_threads.clear();
+}
+
+
+void*
+ShardSearcher::threadMain(void* searcher)
+{
+    static_cast<ShardSearcher*>(searcher)->work();
+    return NULL;
+}
+
+
+void
+ShardSearcher::work()
+{
+    m_tm.lock(m_lock);
+    while (!m_is_stopping)
+    {
+        if (m_next_shard < m_job_size)
+            takeShards();
+        else
+            m_tm.wait(m_has_work, m_lock);
+    }
+    m_tm.unlock(m_lock);
+}
+
+
+void
+ShardSearcher::takeShards()
+{
+    while (m_next_shard < m_job_size)
+    {
+        const size_t index = m_next_shard++;
+        m_tm.unlock(m_lock);
+
+        Shard& shard = *m_shards[index];
+        try
+        {
+            matchShard(index);
+        }
+        catch (...)
+        {
+            // It will be matched again by the calling thread,
+            // which reports the error.
+            shard.is_failed = true;
+        }
+
+        m_tm.lock(m_lock);
+        if (--m_pending == 0)
+            m_tm.signal(m_is_done);
+    }
+}
+
+
+void
+ShardSearcher::matchShard(size_t index)
+{
+    Shard& shard = *m_shards[index];
+    const Xapian::doccount shard_count =
+        static_cast<Xapian::doccount>(m_shards.size());
+
+    DeadlineMatchDecider decider(*mp_deadline);
+    Xapian::MSet mset = shard.enquire.get_mset(0, m_limit, 0, NULL,
+        mp_deadline->isSet() ? &decider : NULL);
+
+    shard.items.clear();
+    shard.items.reserve(mset.size());
+    for (Xapian::MSetIterator i = mset.begin(), e = mset.end(); i != e; ++i)
+    {
+        // http://trac.xapian.org/wiki/FAQ/MultiDatabaseDocumentID
+        ShardMatchItem item;
+        item.docid   = (*i - 1) * shard_count
+                     + static_cast<Xapian::docid>(index) + 1;
+        item.weight  = i.get_weight();
+        item.percent = i.get_percent();
+        shard.items.push_back(item);
+    }
+    shard.matches_estimated = mset.get_matches_estimated();
+    shard.is_expired = decider.isExpired();
+}
+
+
+void
+ShardSearcher::match(const Xapian::Query& query, bool is_weighted,
+    Xapian::doccount first, Xapian::doccount maxitems,
+    const Deadline& deadline, ShardMatch& result)
+{
+    // Each shard returns its own top, the global page is inside them.
+    Xapian::doccount limit = first + maxitems;
+    if (limit < first)
+        limit = static_cast<Xapian::doccount>(-1);
+
+    // Handles are copied here, threads only run matches.
+    for (size_t i = 0; i < m_shards.size(); i++)
+    {
+        Shard& shard = *m_shards[i];
+        shard.enquire.set_query(query);
+        if (is_weighted)
+            shard.enquire.set_weighting_scheme(Xapian::BM25Weight());
+        else
+            shard.enquire.set_weighting_scheme(Xapian::BoolWeight());
+        shard.is_failed = false;
+    }
+    mp_deadline = &deadline;
+    m_limit     = limit;
+
+    m_tm.lock(m_lock);
+    m_next_shard = 0;
+    m_job_size   = m_shards.size();
+    m_pending    = m_shards.size();
+    m_tm.broadcast(m_has_work);
+    takeShards();
+    while (m_pending != 0)
+        m_tm.wait(m_is_done, m_lock);
+    m_job_size = 0;
+    m_tm.unlock(m_lock);
+    m_search_count++;
+
+    std::vector<ShardMatchItem> items;
+    result.matches_estimated = 0;
+    result.is_truncated = false;
+    for (size_t i = 0; i < m_shards.size(); i++)
+    {
+        Shard& shard = *m_shards[i];
+        if (shard.is_failed)
+            matchShard(i);
+        items.insert(items.end(), shard.items.begin(), shard.items.end());
+        result.matches_estimated += shard.matches_estimated;
+        result.is_truncated = result.is_truncated || shard.is_expired;
+        shard.items.clear();
+    }
+
+    const size_t top = std::min(items.size(), static_cast<size_t>(limit));
+    std::partial_sort(items.begin(), items.begin() + top, items.end(),
+                      &isBetterItem);
+
+    // Percents of shards are relative to their own best documents.
+    // Scale them as the best document of all shards.
+    double percent_scale = 0;
+    if (!items.empty() && items[0].weight > 0)
+        percent_scale = items[0].percent / items[0].weight;
+
+    result.first = first;
+    result.items.clear();
+    for (size_t i = first; i < top; i++)
+    {
+        ShardMatchItem item = items[i];
+        if (percent_scale > 0)
+        {
+            const double percent = std::floor(item.weight * percent_scale + 0.5);
+            item.percent = static_cast<Xapian::percent>(
+                std::min(100.0, std::max(percent, 1.0)));
+        }
+        result.items.push_back(item);
+    }
+}
+
+XAPIAN_ERLANG_NS_END
@@ -0,0 +1,278 @@
+#ifndef XAPIAN_SHARD_SEARCH_H
+#define XAPIAN_SHARD_SEARCH_H
+
+// External imports
+#include <xapian.h>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+// Internal imports
+#include "deadline.h"
+#include "thread_manager.h"
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+
+/**
+ * A matched document of a merged result.
+ */
+struct ShardMatchItem
+{
+    /* The docid in the combined database. */
+    Xapian::docid       docid;
+    Xapian::weight      weight;
+    Xapian::percent     percent;
+};
+
+
+/**
+ * A page of the merged result.
+ */
+struct ShardMatch
+{
+    std::vector<ShardMatchItem> items;
+
+    /* The rank of the first item. */
+    Xapian::doccount    first;
+
+    /* The sum of estimates of all shards. */
+    Xapian::doccount    matches_estimated;
+
+    /* At least one shard was stopped by the deadline. */
+    bool                is_truncated;
+
+    ShardMatch() : first(0), matches_estimated(0), is_truncated(false) {}
+};
+
+
+/**
+ * Walks over @ref ShardMatch with the same interface as MSetIterator,
+ * so the same code retrieves fields from both.
+ * Collapsing is not used by the fan-out search.
+ */
+class ShardMatchIterator
+{
+    const ShardMatch&   m_match;
+    Xapian::Database&   m_db;
+    size_t              m_index;
+
+    public:
+    ShardMatchIterator(const ShardMatch& match, Xapian::Database& db)
+    : m_match(match), m_db(db), m_index(0)
+    {}
+
+    bool
+    isEnd() const
+    {
+        return m_index == m_match.items.size();
+    }
+
+    ShardMatchIterator&
+    operator++()
+    {
+        m_index++;
+        return *this;
+    }
+
+    Xapian::docid
+    operator*() const
+    {
+        return m_match.items[m_index].docid;
+    }
+
+    Xapian::weight
+    get_weight() const
+    {
+        return m_match.items[m_index].weight;
+    }
+
+    Xapian::percent
+    get_percent() const
+    {
+        return m_match.items[m_index].percent;
+    }
+
+    Xapian::doccount
+    get_rank() const
+    {
+        return m_match.first + static_cast<Xapian::doccount>(m_index);
+    }
+
+    std::string
+    get_collapse_key() const
+    {
+        return std::string();
+    }
+
+    Xapian::doccount
+    get_collapse_count() const
+    {
+        return 0;
+    }
+
+    Xapian::Document
+    get_document() const
+    {
+        return m_db.get_document(**this);
+    }
+};
+
+
+/**
+ * Runs a query on each shard in a pool of threads and merges results.
+ *
+ * Each shard is a separate Xapian::Database handle, opened with the same
+ * path as a part of the combined database of Driver. A shard is used
+ * by one thread at once. The calling thread also takes shards,
+ * while it waits.
+ *
+ * Xapian 1.2 does not allow to pass global term statistics into an
+ * Enquire, so each shard is ranked with its own ones, and weights of
+ * different shards are not comparable. That is why weighted queries
+ * are matched on shards only with @ref setLocalWeights. Unweighted 
+ * queries are matched with BoolWeight and sorted by the combined docid,
+ * their result is the same as of the combined database.
+ *
+ * Threads and locks are created by ThreadManager.
+ */
+class ShardSearcher
+{
+    struct Shard
+    {
+        Xapian::Database                db;
+        Xapian::Enquire                 enquire;
+        std::vector<ShardMatchItem>     items;
+        Xapian::doccount                matches_estimated;
+        bool                            is_expired;
+        bool                            is_failed;
+
+        Shard(const Xapian::Database& shard_db)
+        : db(shard_db), enquire(shard_db),
+          matches_estimated(0), is_expired(false), is_failed(false)
+        {}
+    };
+
+    ThreadManager&                      m_tm;
+    std::vector<Shard*>                 m_shards;
+    std::vector<ThreadManager::Thread>  m_threads;
+
+    ThreadManager::Mutex    m_lock;
+    ThreadManager::Cond     m_has_work;
+    ThreadManager::Cond     m_is_done;
+
+    /* Weighted queries are matched on shards too. */
+    bool                    m_is_local_weights;
+
+    /* The count of matches, that were run on shards. */
+    uint32_t                m_search_count;
+
+    /* The current match, protected by m_lock. */
+    size_t                  m_next_shard;
+    size_t                  m_job_size;
+    size_t                  m_pending;
+    bool                    m_is_stopping;
+
+    /* Parameters of the current match, set before it is started. */
+    const Deadline*         mp_deadline;
+    Xapian::doccount        m_limit;
+
+    /// Copy is not allowed.
+    ShardSearcher(const ShardSearcher&);
+    ShardSearcher& operator=(const ShardSearcher&);
+
+    static void*
+    threadMain(void* searcher);
+
+    void
+    work();
+
+    /**
+     * Take and match shards of the current job, until there are none.
+     * It is called with the lock held.
+     */
+    void
+    takeShards();
+
+    void
+    matchShard(size_t index);
+
+    void
+    stopThreads();
+
+    public:
+    explicit
+    ShardSearcher(ThreadManager& tm);
+    ~ShardSearcher();
+
+    void
+    addShard(const Xapian::Database& db);
+
+    /**
+     * Forget all shards.
+     */
+    void
+    clear();
+
+    /**
+     * 0 disables the fan-out search.
+     * Fewer threads are started, if the system does not allow more.
+     */
+    void
+    setThreadCount(uint32_t count);
+
+    /**
+     * Allow to rank weighted queries with statistics of shards.
+     */
+    void
+    setLocalWeights(bool is_local_weights)
+    {
+        m_is_local_weights = is_local_weights;
+    }
+
+    bool
+    isLocalWeights() const
+    {
+        return m_is_local_weights;
+    }
+
+    /**
+     * True, if a query with @a is_weighted can be matched on shards.
+     */
+    bool
+    isApplicable(bool is_weighted) const
+    {
+        return !is_weighted || m_is_local_weights;
+    }
+
+    uint32_t
+    searchCount() const
+    {
+        return m_search_count;
+    }
+
+    uint32_t
+    threadCount() const
+    {
+        return static_cast<uint32_t>(m_threads.size());
+    }
+
+    uint32_t
+    shardCount() const
+    {
+        return static_cast<uint32_t>(m_shards.size());
+    }
+
+    /**
+     * Returns top documents from @a first to @a first + @a maxitems.
+     * Errors of shards are thrown from the calling thread.
+     * An unweighted query is matched with BoolWeight.
+     */
+    void
+    match(const Xapian::Query& query, bool is_weighted,
+          Xapian::doccount first, Xapian::doccount maxitems,
+          const Deadline& deadline, ShardMatch& result);
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
@@ -0,0 +1,96 @@
+#ifndef XAPIAN_STRING_REF_H
+#define XAPIAN_STRING_REF_H
+
+// External imports
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// Internal imports
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * A non-owning reference on characters inside of a buffer.
+ *
+ * ParamDecoder returns it without copying. It is valid, while the buffer
+ * of parameters is valid, that is, while the command is handled.
+ * Call @ref str only where Xapian needs a real std::string.
+ */
+class StringRef
+{
+    const char* m_data;
+    size_t      m_size;
+
+    public:
+    StringRef() : m_data(NULL), m_size(0) {}
+
+    StringRef(const char* data, size_t size)
+        : m_data(data), m_size(size)
+    {}
+
+    /**
+     * The string must outlive the reference.
+     */
+    explicit
+    StringRef(const std::string& str)
+        : m_data(str.data()), m_size(str.size())
+    {}
+
+    const char*
+    data() const
+    {
+        return m_data;
+    }
+
+    size_t
+    size() const
+    {
+        return m_size;
+    }
+
+    bool
+    empty() const
+    {
+        return m_size == 0;
+    }
+
+    /**
+     * Copy characters into a new string.
+     */
+    std::string
+    str() const
+    {
+        return std::string(m_data, m_size);
+    }
+
+    /**
+     * The same order as std::string::compare.
+     */
+    int
+    compare(const StringRef& other) const
+    {
+        const size_t len = m_size < other.m_size ? m_size : other.m_size;
+        const int cmp = len ? memcmp(m_data, other.m_data, len) : 0;
+        if (cmp != 0)
+            return cmp;
+        if (m_size == other.m_size)
+            return 0;
+        return m_size < other.m_size ? -1 : 1;
+    }
+
+    bool
+    operator<(const StringRef& other) const
+    {
+        return compare(other) < 0;
+    }
+
+    bool
+    operator==(const StringRef& other) const
+    {
+        return m_size == other.m_size && compare(other) == 0;
+    }
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
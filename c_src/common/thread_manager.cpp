@@ -0,0 +1,82 @@
+// External imports
+#include <pthread.h>
+
+// Internal imports
+#include "thread_manager.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+ThreadManager::Thread ThreadManager::createThread(ThreadFunction fun, void* arg)
+{
+    pthread_t* thread = new pthread_t;
+    if (pthread_create(thread, NULL, fun, arg) != 0)
+    {
+        delete thread;
+        return NULL;
+    }
+    return thread;
+}
+
+void ThreadManager::joinThread(Thread thread)
+{
+    pthread_t* p_thread = static_cast<pthread_t*>(thread);
+    pthread_join(*p_thread, NULL);
+    delete p_thread;
+}
+
+
+ThreadManager::Mutex ThreadManager::createMutex()
+{
+    pthread_mutex_t* mutex = new pthread_mutex_t;
+    pthread_mutex_init(mutex, NULL);
+    return mutex;
+}
+
+void ThreadManager::destroyMutex(Mutex mutex)
+{
+    pthread_mutex_t* p_mutex = static_cast<pthread_mutex_t*>(mutex);
+    pthread_mutex_destroy(p_mutex);
+    delete p_mutex;
+}
+
+void ThreadManager::lock(Mutex mutex)
+{
+    pthread_mutex_lock(static_cast<pthread_mutex_t*>(mutex));
+}
+
+void ThreadManager::unlock(Mutex mutex)
+{
+    pthread_mutex_unlock(static_cast<pthread_mutex_t*>(mutex));
+}
+
+
+ThreadManager::Cond ThreadManager::createCond()
+{
+    pthread_cond_t* cond = new pthread_cond_t;
+    pthread_cond_init(cond, NULL);
+    return cond;
+}
+
+void ThreadManager::destroyCond(Cond cond)
+{
+    pthread_cond_t* p_cond = static_cast<pthread_cond_t*>(cond);
+    pthread_cond_destroy(p_cond);
+    delete p_cond;
+}
+
+void ThreadManager::wait(Cond cond, Mutex mutex)
+{
+    pthread_cond_wait(static_cast<pthread_cond_t*>(cond), 
+                      static_cast<pthread_mutex_t*>(mutex));
+}
+
+void ThreadManager::signal(Cond cond)
+{
+    pthread_cond_signal(static_cast<pthread_cond_t*>(cond));
+}
+
+void ThreadManager::broadcast(Cond cond)
+{
+    pthread_cond_broadcast(static_cast<pthread_cond_t*>(cond));
+}
+
+XAPIAN_ERLANG_NS_END
@@ -0,0 +1,50 @@
+#ifndef THREAD_MANAGER_H
+#define THREAD_MANAGER_H
+
+// Internal imports
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * Threads and locks for code, that is shared by the driver, the NIF and
+ * the port program.
+ *
+ * This class uses pthreads. The driver and the NIF override it with
+ * the thread API of the emulator, as ERTS requires.
+ */
+class ThreadManager
+{
+    public:
+    typedef void* (*ThreadFunction)(void*);
+
+    /* Opaque handles. */
+    typedef void* Thread;
+    typedef void* Mutex;
+    typedef void* Cond;
+
+    /**
+     * Because this class have other virtual functions.
+     */
+    virtual ~ThreadManager() {};
+
+    /**
+     * Returns NULL, if the thread was not started.
+     */
+    virtual Thread createThread(ThreadFunction fun, void* arg);
+    virtual void joinThread(Thread thread);
+
+    virtual Mutex createMutex();
+    virtual void destroyMutex(Mutex mutex);
+    virtual void lock(Mutex mutex);
+    virtual void unlock(Mutex mutex);
+
+    virtual Cond createCond();
+    virtual void destroyCond(Cond cond);
+    virtual void wait(Cond cond, Mutex mutex);
+    virtual void signal(Cond cond);
+    virtual void broadcast(Cond cond);
+};
+
+XAPIAN_ERLANG_NS_END
+
+#endif
@@ -13,13 +13,20 @@
 #include "param_decoder.h"
 #include "param_decoder_controller.h"
 #include "result_encoder.h"
+#include "field_encoder.h"
+#include "retrieval_schema.h"
 #include "xapian_exception.h"
 #include "xapian_helpers.h"
+#include "deadline.h"
 #include "qlc.h"
 #include "extension/value_count_mspy.h"
 
 #include <assert.h>
 #include <cstdlib>
+#include <algorithm>
+
+/* The length of the preallocated buffer for a result of a batch item. */
+#define BATCH_ITEM_BUF_LEN 256
 
 // -------------------------------------------------------------------
 // Main Driver Class
@@ -95,8 +102,9 @@ Driver::DOCID_ORDER_TYPES[DOCID_ORDER_TYPE_COUNT] = {
 };
 
 
-Driver::Driver(MemoryManager& mm)
-: m_store(*this), m_number_of_databases(0), m_mm(mm)
+Driver::Driver(MemoryManager& mm, ThreadManager& tm)
+: m_store(*this), m_number_of_databases(0), m_is_writable(false),
+  m_shard_searcher(tm), m_mm(mm), m_scratch(mm)
 {
 }
 
@@ -109,10 +117,10 @@ void
 Driver::setDefaultStemmer(const Xapian::Stem& stemmer)
 {
     m_default_stemmer = stemmer;
-    m_default_parser.set_stemmer(m_default_stemmer);
     m_default_generator.set_stemmer(m_default_stemmer);
     m_default_parser_factory.set_stemmer(m_default_stemmer);
     m_default_generator_factory.set_stemmer(m_default_stemmer);
+    invalidateCaches();
 }
 
 
@@ -132,8 +140,7 @@ Driver::setDefaultPrefixes(ParamDecoder& params)
     {
         addPrefix(params, m_default_parser_factory);
     }
-    // Update the mirror
-    m_default_parser = m_default_parser_factory;
+    invalidateCaches();
 }
 
 
@@ -151,6 +158,7 @@ void
 Driver::addDocument(PR)
 {
     assertWriteable();
+    invalidateCaches();
 
     Xapian::Document doc;
     applyDocument(params, doc);
@@ -163,6 +171,7 @@ void
 Driver::addSpelling(ParamDecoder& params)
 {
     assertWriteable();
+    invalidateCaches();
 
     Resource::Element gen_con = 
         Resource::Element::createContext();
@@ -246,6 +255,7 @@ void
 Driver::replaceOrCreateDocument(PR)
 {
     assertWriteable();
+    invalidateCaches();
 
     Xapian::Document doc;
     Xapian::docid docid;
@@ -280,6 +290,7 @@ void
 Driver::replaceDocument(PR)
 {
     assertWriteable();
+    invalidateCaches();
 
     Xapian::Document doc;
     Xapian::docid docid;
@@ -322,8 +333,8 @@ void
 Driver::updateDocument(PR, bool create)
 {
     assertWriteable();
-    const ParamDecoderController& schema  
-        = applyDocumentSchema(params);
+    invalidateCaches();
+    const ParamDecoder schema = applyDocumentSchema(params);
     
 
     Xapian::Document doc;
@@ -399,6 +410,7 @@ void
 Driver::deleteDocument(PR)
 {
     assertWriteable();
+    invalidateCaches();
     uint8_t is_exist;
 
     switch(uint8_t idType = params)
@@ -473,56 +485,250 @@ Driver::isDocumentExist(PR)
 void
 Driver::query(CPR)
 {
-    /* offset, pagesize, query, template */
+    /* offset, pagesize, timeout, query, template */
+    // The offset, the page size and the query are a key for the cache.
+    std::string key("Q");
+    const char* from = params.currentPosition();
     const uint32_t offset   = params;
     const uint32_t pagesize = params;
+    key.append(from, static_cast<size_t>(params.currentPosition() - from));
+    const uint32_t timeout  = params;
 
     // Use an Enquire object on the database to run the query.
     Xapian::Enquire enquire(m_db);
-    Xapian::Query   query = buildQuery(con, params);
+    from = params.currentPosition();
+    bool is_weighted;
+    Xapian::Query   query = buildQuery(con, params, is_weighted);
+    key.append(from, static_cast<size_t>(params.currentPosition() - from));
+    // The fan-out search does not use the MSet cache:
+    // pages of shards are merged and forgotten.
+    if (isShardSearchEnabled(is_weighted))
+    {
+        queryShards(query, is_weighted, offset, pagesize, timeout, 
+                    params, result);
+        return;
+    }
     enquire.set_query(query);
+    if (!is_weighted)
+        enquire.set_weighting_scheme(Xapian::BoolWeight());
      
     // Get an result
-    Xapian::MSet mset = enquire.get_mset(
-        static_cast<Xapian::termcount>(offset), 
-        static_cast<Xapian::termcount>(pagesize));
+    // The deadline is checked only while matching, documents of the page
+    // are always retrieved.
+    Resource::Element mset_elem = cachedMatch(key, enquire,
+        static_cast<Xapian::doccount>(offset), 
+        static_cast<Xapian::doccount>(pagesize),
+        0, timeout, NULL);
+    Xapian::MSet& mset = mset_elem;
 
     Xapian::doccount count = mset.size();
+    result << static_cast<uint8_t>(mset_elem.is_truncated());
     result << static_cast<uint32_t>(count);
-    retrieveDocuments(params, result, mset.begin(), mset.end());
+    const RetrievalSchema schema = retrieveDocumentSchema(params);
+    retrieveDocuments(schema, result, mset.begin(), mset.end(), count);
 }
 
+/**
+ * Run the query on each shard in parallel and merge pages.
+ * The result has the same format as QUERY_PAGE.
+ * It is not cached.
+ */
 void
-Driver::retrieveDocuments(PCR, 
-    Xapian::MSetIterator iter, Xapian::MSetIterator end)
+Driver::queryShards(const Xapian::Query& query, bool is_weighted, 
+    uint32_t offset, uint32_t pagesize, uint32_t timeout, PR)
+{
+    const Deadline deadline(timeout);
+    ShardMatch match;
+    m_shard_searcher.match(query, is_weighted,
+        static_cast<Xapian::doccount>(offset), 
+        static_cast<Xapian::doccount>(pagesize), 
+        deadline, match);
+
+    result << static_cast<uint8_t>(match.is_truncated);
+    result << static_cast<uint32_t>(match.items.size());
+    const RetrievalSchema schema = retrieveDocumentSchema(params);
+    for (ShardMatchIterator iter(match, m_db); !iter.isEnd(); ++iter)
+        retrieveDocument(schema, result, iter);
+}
+
+
+bool
+Driver::isShardSearchEnabled(bool is_weighted) const
 {
-    ParamDecoder params_copy = params;
-    switch (uint8_t decoder_type = params_copy)
+    return m_shard_searcher.threadCount() != 0
+        && m_shard_searcher.isApplicable(is_weighted)
+        && m_number_of_databases > 1
+        && m_shard_searcher.shardCount() == m_number_of_databases;
+}
+
+
+void
+Driver::count(CPR)
+{
+    /* is_exact, query */
+    const bool is_exact = params;
+    Xapian::doccount lower, estimated, upper;
+
+    // Terms and groups of terms are answered from statistics.
+    uint8_t op;
+    std::vector<std::string> terms;
+    if (readTermGroup(params, op, terms)
+     && (countTermGroup(op, terms, lower, estimated, upper) || !is_exact))
     {
-        case DEC_DOCUMENT:
-            for (; iter != end; ++iter)
-            {
-                Xapian::Document doc = iter.get_document();
-                retrieveDocument(params, result, doc);
-            }
-            break;
+        result << static_cast<uint32_t>(lower)
+               << static_cast<uint32_t>(estimated)
+               << static_cast<uint32_t>(upper);
+        return;
+    }
 
-        case DEC_ITERATOR:
-            for (; iter != end; ++iter)
-                retrieveDocument(params, result, iter);
-            break;
+    // The query is read again, if it is a group of terms.
+    Xapian::Enquire enquire(m_db);
+    enquire.set_query(terms.empty() ? buildQuery(con, params)
+        : Xapian::Query(static_cast<Xapian::Query::op>(op),
+                        terms.begin(), terms.end()));
+    enquire.set_weighting_scheme(Xapian::BoolWeight());
+    enquire.set_docid_order(Xapian::Enquire::ASCENDING);
+
+    // No documents are kept, only counted.
+    const Xapian::doccount checkatleast = is_exact ? m_db.get_doccount() : 0;
+    Xapian::MSet mset = enquire.get_mset(0, 0, checkatleast);
+    result << static_cast<uint32_t>(mset.get_matches_lower_bound())
+           << static_cast<uint32_t>(mset.get_matches_estimated())
+           << static_cast<uint32_t>(mset.get_matches_upper_bound());
+}
+
+
+bool
+Driver::readTermGroup(ParamDecoder& params, uint8_t& op,
+    std::vector<std::string>& terms)
+{
+    // Read from a copy, the query is built from @a params otherwise.
+    ParamDecoder peek = params;
+    const uint8_t type = peek;
+    uint32_t term_count = 1;
+    op = static_cast<uint8_t>(Xapian::Query::OP_OR);
+    if (type == QUERY_GROUP)
+    {
+        op = peek;
+        static_cast<uint32_t>(peek); // parameter
+        term_count = peek;
+        if ((op != Xapian::Query::OP_AND && op != Xapian::Query::OP_OR)
+         || term_count == 0)
+            return false;
+    }
+    else if (type != QUERY_TERM)
+        return false;
 
-        case DEC_BOTH:
-            for (; iter != end; ++iter)
-            {
-                Xapian::Document doc = iter.get_document();
-                retrieveDocument(params, result, doc, iter);
-            }
-            break;
+    for (uint32_t i = 0; i < term_count; i++)
+    {
+        if (type == QUERY_GROUP && static_cast<uint8_t>(peek) != QUERY_TERM)
+        {
+            terms.clear();
+            return false;
+        }
+        const std::string& name = peek;
+        static_cast<uint32_t>(peek); // wqf
+        static_cast<uint32_t>(peek); // pos
+        terms.push_back(name);
+    }
+    params = peek;
+    return true;
+}
 
-        default:
-            throw BadCommandDriverError(POS, decoder_type);
+
+bool
+Driver::countTermGroup(uint8_t op, const std::vector<std::string>& terms,
+    Xapian::doccount& lower, Xapian::doccount& estimated,
+    Xapian::doccount& upper)
+{
+    // Doubles do not overflow on sums of frequencies.
+    const double doccount = m_db.get_doccount();
+    const bool   is_and   = op == Xapian::Query::OP_AND;
+    double min_freq = doccount, max_freq = 0, sum_freq = 0;
+    // Documents with each term, or without any term,
+    // if terms are independent.
+    double ratio = 1;
+    for (size_t i = 0; i < terms.size(); i++)
+    {
+        const double freq = m_db.get_termfreq(terms[i]);
+        min_freq  = std::min(min_freq, freq);
+        max_freq  = std::max(max_freq, freq);
+        sum_freq += freq;
+        if (doccount > 0)
+            ratio *= is_and ? freq / doccount : 1 - freq / doccount;
+    }
+
+    double lower_d, upper_d, estimated_d;
+    if (is_and)
+    {
+        const double others = doccount * static_cast<double>(terms.size() - 1);
+        lower_d     = std::max(0.0, sum_freq - others);
+        upper_d     = min_freq;
+        estimated_d = doccount * ratio;
+    }
+    else
+    {
+        lower_d     = max_freq;
+        upper_d     = std::min(doccount, sum_freq);
+        estimated_d = doccount * (1 - ratio);
     }
+    estimated_d = std::min(upper_d, std::max(lower_d, estimated_d + 0.5));
+
+    lower     = static_cast<Xapian::doccount>(lower_d);
+    upper     = static_cast<Xapian::doccount>(upper_d);
+    estimated = static_cast<Xapian::doccount>(estimated_d);
+    return lower == upper;
+}
+
+
+void
+Driver::retrieveDocuments(const RetrievalSchema& schema, ResultEncoder& result,
+    Xapian::MSetIterator iter, Xapian::MSetIterator end)
+{
+    for (; iter != end; ++iter)
+        retrieveDocument(schema, result, iter);
+}
+
+
+/**
+ * The same, but @a count documents are expected.
+ * The first document is used as a sample to reserve space for others.
+ */
+void
+Driver::retrieveDocuments(const RetrievalSchema& schema, ResultEncoder& result,
+    Xapian::MSetIterator iter, Xapian::MSetIterator end, uint32_t count)
+{
+    if (count < 2)
+    {
+        retrieveDocuments(schema, result, iter, end);
+        return;
+    }
+
+    Xapian::MSetIterator second = iter;
+    ++second;
+
+    const size_t before_len = result.finalSize();
+    retrieveDocuments(schema, result, iter, second);
+    const size_t sample_len = result.finalSize() - before_len;
+
+    result.reserve(sample_len * (count - 1));
+    retrieveDocuments(schema, result, second, end);
+}
+
+
+void
+Driver::retrieveDocument(const RetrievalSchema& schema, ResultEncoder& result,
+    Xapian::MSetIterator& iter)
+{
+    retrieveMatchItem(schema, result, iter);
+}
+
+
+void
+Driver::retrieveDocument(const RetrievalSchema& schema, ResultEncoder& result,
+    ShardMatchIterator& iter)
+{
+    retrieveMatchItem(schema, result, iter);
 }
 
 
@@ -530,37 +736,40 @@ Driver::retrieveDocuments(PCR,
  * Read sources of information and write information fields.
  * Sources are selected from Erlang code.
  */
+template <class Iter>
 void
-Driver::selectEncoderAndRetrieveDocument(PR, Xapian::MSetIterator& iter)
+Driver::retrieveMatchItem(const RetrievalSchema& schema, ResultEncoder& result,
+    Iter& iter)
 {
-    ParamDecoder params_copy = params;
-    switch (uint8_t decoder_type = params_copy)
+    // Chunks of an async reply end only between documents.
+    result.markBoundary();
+    switch (schema.decoderType())
     {
         // Source is a document.
         // Fields from the iterator are not used.
         case DEC_DOCUMENT:
         {
             Xapian::Document doc = iter.get_document();
-            retrieveDocument(params, result, doc);
+            retrieveFields(schema, result, &doc, static_cast<Iter*>(NULL));
             break;
         }
 
         // Source is an iterator.
         // Fields from the document are not used.
         case DEC_ITERATOR:
-            retrieveDocument(params, result, iter);
+            retrieveFields(schema, result, NULL, &iter);
             break;
 
         // Fields both from the iterator and from the document are used.
         case DEC_BOTH:
         {
             Xapian::Document doc = iter.get_document();
-            retrieveDocument(params, result, doc, iter);
+            retrieveFields(schema, result, &doc, &iter);
             break;
         }
 
         default:
-            throw BadCommandDriverError(POS, decoder_type);
+            throw BadCommandDriverError(POS, schema.decoderType());
     }
 }
 
@@ -594,7 +803,7 @@ Driver::createQueryParser(PR)
     // Read parser into allocated pointer.
     // parser_con holds child resources.
     Xapian::QueryParser* p_parser = 
-        new Xapian::QueryParser(readParser(parser_con, params));
+        new Xapian::QueryParser(readParser(parser_con, params, true));
 
     Resource::Element elem = 
         Resource::Element::wrap(p_parser);
@@ -647,6 +856,39 @@ Driver::getSpellingCorrection(PR)
 }
 
 
+/**
+ * Params: Count, [Command, Len, SubParams].
+ * Result: Count, [Len, SubResult].
+ * Each SubResult starts with its own status (SUCCESS or an error code),
+ * an error does not stop the batch.
+ */
+void
+Driver::batch(PR)
+{
+    char sub_buf[BATCH_ITEM_BUF_LEN];
+    ResultEncoder sub_result(m_scratch, sub_buf, BATCH_ITEM_BUF_LEN);
+
+    const uint32_t count = params;
+    result << count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint32_t command = params;
+        const uint32_t len     = params;
+        ParamDecoder sub_params(params.move(len), len);
+
+        /* A nested batch fails only its own item. */
+        if (command == BATCH)
+            encodeError(sub_result, BadCommandDriverError(POS, command));
+        else
+            handleCommand(sub_params, sub_result, command);
+        result << static_cast<uint32_t>( sub_result.finalSize() );
+        result.append(sub_result);
+        sub_result.reset();
+        m_scratch.reset();
+    }
+}
+
+
 void
 Driver::parseString(CPR)
 {
@@ -758,6 +1000,7 @@ void
 Driver::addSynonym(ParamDecoder& params)
 {
     assertWriteable();
+    invalidateCaches();
 
     const std::string& term   = params;
     const std::string& synonym = params;
@@ -769,6 +1012,7 @@ void
 Driver::removeSynonym(ParamDecoder& params)
 {
     assertWriteable();
+    invalidateCaches();
 
     const std::string& term   = params;
     const std::string& synonym = params;
@@ -780,6 +1024,7 @@ void
 Driver::clearSynonyms(ParamDecoder& params)
 {
     assertWriteable();
+    invalidateCaches();
 
     const std::string& term   = params;
 
@@ -793,7 +1038,13 @@ Driver::matchSet(CPR)
     // Spies and MatchSpy must be sepated.
     // Enquire and Spies will be stored inside a temporary context (con
     // parameter).
-    Xapian::Enquire& enquire = extractEnquire(con, params);
+    Resource::Element enquire_elem = m_store.extract(con, params);
+    Xapian::Enquire& enquire = enquire_elem;
+
+    // The settings of the Enquire and the bounds are a key for the cache.
+    std::string key("M");
+    key.append(enquire_elem.get_cache_key());
+    const char* from = params.currentPosition();
 
     Xapian::doccount    first, maxitems, checkatleast;
     first = params;
@@ -803,8 +1054,36 @@ Driver::matchSet(CPR)
         : params;
     checkatleast = params;
 
+    /* Only documents after the cursor are matched, if it is not empty. */
+    const SortOrder& order = enquire_elem.get_sort_order();
+    const StringRef cursor_bin = params;
+    SearchCursor cursor;
+    if (!cursor_bin.empty() 
+     && (m_number_of_databases != 1 || !cursor.decode(order, cursor_bin)))
+        throw BadArgumentDriverError(POS);
+    const CursorMatchDecider cursor_decider(order, cursor);
+    const Xapian::MatchDecider* p_filter = 
+        cursor_bin.empty() ? NULL : &cursor_decider;
+    key.append(from, static_cast<size_t>(params.currentPosition() - from));
+
+    /* The timeout of the enquire is used by default. */
+    uint32_t timeout = params;
+    if (!timeout)
+        timeout = enquire_elem.get_timeout();
+
     /* Read a count of passed Spy objects. */
     uint32_t count = params;
+    if (count == 0)
+    {
+        // Spies must see the match, so only results without spies are
+        // cached.
+        Resource::Element elem = cachedMatch(key, enquire, 
+            first, maxitems, checkatleast, timeout, p_filter);
+        elem.set_sort_order(order);
+        m_store.save(elem, result);
+        return;
+    }
+
     while (count--)
     {
         // It can be added just once
@@ -812,19 +1091,50 @@ Driver::matchSet(CPR)
         enquire.add_matchspy(&spy);
     }
 
+    const Deadline deadline(timeout);
+    DeadlineMatchDecider decider(deadline, p_filter);
     Xapian::MSet mset = enquire.get_mset(
         first, 
         maxitems,
-        checkatleast);
+        checkatleast,
+        NULL,
+        decider.isUsed() ? &decider : NULL);
 
     enquire.clear_matchspies();
 
     Resource::Element elem = 
-        Resource::Element::wrap(new Xapian::MSet(mset));
+        Resource::Element::wrap(new Xapian::MSet(mset), decider.isExpired());
+    elem.set_sort_order(order);
 
     m_store.save(elem, result);
 }
 
+
+Resource::Element
+Driver::cachedMatch(const std::string& key, Xapian::Enquire& enquire,
+    Xapian::doccount first, Xapian::doccount maxitems,
+    Xapian::doccount checkatleast, uint32_t timeout,
+    const Xapian::MatchDecider* p_filter)
+{
+    Resource::Element elem;
+    if (m_mset_cache.get(key, elem))
+        return elem;
+
+    const Deadline deadline(timeout);
+    DeadlineMatchDecider decider(deadline, p_filter);
+    Xapian::MSet mset = enquire.get_mset(
+        first, 
+        maxitems,
+        checkatleast,
+        NULL,
+        decider.isUsed() ? &decider : NULL);
+
+    elem = Resource::Element::wrap(new Xapian::MSet(mset), decider.isExpired());
+    if (!decider.isExpired())
+        m_mset_cache.put(key, elem);
+    return elem;
+}
+
 Xapian::MatchSpy&
 Driver::extractWritableSpy(CP)
 {
@@ -846,7 +1156,7 @@ Driver::qlcInit(PR)
             Resource::Element mset_elem = m_store.extract(params);
             Xapian::MSet& mset = mset_elem;
             // Extract a schema (a list of fields, settings for QLC).
-            const ParamDecoderController& schema  
+            const RetrievalSchema& schema  
                 = retrieveDocumentSchema(params);
             // Allocate the object
             MSetQlcTable* qlcTable = new MSetQlcTable(*this, mset, schema);
@@ -873,7 +1183,7 @@ Driver::qlcInit(PR)
             Xapian::Document& doc = m_store.extract(params);
             TermGenerator::Iterator* p_gen = TermGenerator::Iterator::create(doc);
 
-            const ParamDecoderController& schema  
+            const RetrievalSchema& schema  
                 = retrieveTermSchema(params);
 
             TermQlcTable* qlcTable = new TermQlcTable(*this, p_gen, schema);
@@ -898,7 +1208,7 @@ Driver::qlcInit(PR)
             TermGenerator::Iterator* p_gen = 
                 TermGenerator::Iterator::create(params, spy);
 
-            const ParamDecoderController& schema  
+            const RetrievalSchema& schema  
                 = retrieveTermSchema(params);
 
             TermQlcTable* qlcTable = new TermQlcTable(*this, p_gen, schema);
@@ -926,7 +1236,7 @@ Driver::qlcInit(PR)
             TermGenerator::Iterator* p_gen = 
                 TermGenerator::Iterator::create(params, qp);
 
-            const ParamDecoderController& schema  
+            const RetrievalSchema& schema  
                 = retrieveTermSchema(params);
 
             TermQlcTable* qlcTable = new TermQlcTable(*this, p_gen, schema);
@@ -953,7 +1263,7 @@ Driver::qlcInit(PR)
             TermGenerator::Iterator* p_gen = 
                 TermGenerator::Iterator::create(params, m_db);
 
-            const ParamDecoderController& schema  
+            const RetrievalSchema& schema  
                 = retrieveTermSchema(params);
 
             TermQlcTable* qlcTable = new TermQlcTable(*this, p_gen, schema);
@@ -982,8 +1292,9 @@ Driver::qlcNext(PR)
     QlcTable& qlc_table = m_store.extract(params);
     uint32_t   from     = params;
     uint32_t   count    = params;
+    uint32_t   timeout  = params;
  
-    qlc_table.getPage(result, from, count);
+    qlc_table.getPage(result, from, count, Deadline(timeout));
 }
 
 void
@@ -999,6 +1310,15 @@ Driver::assertWriteable() const
 {}
 
 
+void
+Driver::invalidateCaches()
+{
+    m_query_cache.clear();
+    m_mset_cache.clear();
+    m_filter_cache.clear();
+}
+
+
 void
 Driver::startTransaction()
 {
@@ -1012,6 +1332,7 @@ void
 Driver::cancelTransaction()
 {
     assertWriteable();
+    invalidateCaches();
 
     m_wdb.cancel_transaction();
 }
@@ -1021,6 +1342,7 @@ void
 Driver::commitTransaction()
 {
     assertWriteable();
+    invalidateCaches();
 
     m_wdb.commit_transaction();
 }
@@ -1031,7 +1353,7 @@ Driver::getDocumentById(PR)
 {
     const Xapian::docid docid = params;
     Xapian::Document doc = m_db.get_document(docid);
-    retrieveDocument(params, result, doc);
+    retrieveSingleDocument(params, result, doc);
 }
 
 
@@ -1043,7 +1365,7 @@ Driver::documentInfo(PR)
 {
     Xapian::Document doc;
     applyDocument(params, doc);
-    retrieveDocument(params, result, doc);
+    retrieveSingleDocument(params, result, doc);
 }
 
 
@@ -1088,6 +1410,14 @@ Driver::test(PR)
             testMemory();
             break;
 
+        case TEST_RESULT_GROWTH:
+            testResultGrowth(params, result);
+            break;
+
+        case TEST_EXPIRED_DEADLINE:
+            testExpiredDeadline(params, result);
+            break;
+
         default:
             throw BadCommandDriverError(POS, num);
     }
@@ -1103,6 +1433,54 @@ Driver::testResultEncoder(ResultEncoder& result,
 }
 
 
+/**
+ * Put @a count integers into an encoder with a tiny buffer and
+ * report, how segments were allocated.
+ */
+void
+Driver::testResultGrowth(PR)
+{
+    const uint32_t max_segment_len = params;
+    const uint32_t reserve_len     = params;
+    const uint32_t count           = params;
+
+    char buf[16];
+    ResultEncoder encoder(m_mm, buf, sizeof(buf));
+    encoder.setMaxSegmentLen(max_segment_len);
+    encoder.reserve(reserve_len);
+    for (uint32_t i = 0; i < count; i++)
+        encoder << i;
+
+    result << static_cast<uint32_t>(encoder.segmentCount())
+           << static_cast<uint32_t>(encoder.reservedLen())
+           << static_cast<uint32_t>(encoder.finalSize());
+    encoder.clear();
+}
+
+
+/**
+ * The decider checks the clock once per DEADLINE_CHECK_INTERVAL calls,
+ * so the first documents are accepted and the rest are rejected.
+ */
+void
+Driver::testExpiredDeadline(PR)
+{
+    const std::string& term     = params;
+    const uint32_t     maxitems = params;
+
+    Xapian::Enquire enquire(m_db);
+    enquire.set_query(Xapian::Query(term));
+    enquire.set_weighting_scheme(Xapian::BoolWeight());
+
+    const Deadline deadline = Deadline::passed();
+    DeadlineMatchDecider decider(deadline);
+    Xapian::MSet mset = enquire.get_mset(0, maxitems, 0, NULL, &decider);
+
+    result << static_cast<uint32_t>(mset.size())
+           << static_cast<uint8_t>(decider.isExpired());
+}
+
+
 void Driver::testEcho(PR)
 {
     for (uint32_t len = params; len; len--)
@@ -1268,8 +1646,18 @@ Driver::addPrefix(ParamDecoder& params, QueryParserFactory& qpf)
 
 Xapian::Query 
 Driver::buildQuery(CP)
+{
+    bool is_weighted;
+    return buildQuery(con, params, is_weighted);
+}
+
+
+Xapian::Query 
+Driver::buildQuery(CP, bool& is_weighted)
 {
     const uint8_t type = params;
+    // Only terms give weights.
+    is_weighted = true;
     switch (type)
     {
         case QUERY_GROUP:
@@ -1278,18 +1666,63 @@ Driver::buildQuery(CP)
             const uint32_t    parameter       = params;
             const uint32_t    subQueryCount   = params;
             std::vector<Xapian::Query> subQueries;
+            std::vector<bool> isSubWeighted;
+            std::vector<std::string> filterKeys;
+            subQueries.reserve(subQueryCount);
+            isSubWeighted.reserve(subQueryCount);
+            bool has_weighted = false;
+            const bool is_filter_cache_enabled = isFilterCacheEnabled();
 
             for (uint32_t i = 0; i < subQueryCount; i++)
-                subQueries.push_back(buildQuery(con, params));
+            {
+                bool is_sub_weighted;
+                const char* from = params.currentPosition();
+                subQueries.push_back(buildQuery(con, params, 
+                    is_sub_weighted));
+                isSubWeighted.push_back(is_sub_weighted);
+                has_weighted = has_weighted || is_sub_weighted;
+
+                // The encoded subquery is a key of the filter cache,
+                // as it is a key of the MSet and query caches.
+                // Resources are immutable and their numbers are never
+                // reused, so the number identifies the parser or query.
+                filterKeys.push_back(is_filter_cache_enabled
+                    ? std::string(from, static_cast<size_t>(
+                        params.currentPosition() - from))
+                    : std::string());
+            }
+
+            // Filters of scored queries are matched from the cache:
+            // right subqueries of FILTER and AND_NOT, and subqueries 
+            // without weights of AND.
+            // Sources must live until the group is built.
+            FilterSources sources;
+            for (uint32_t i = 0; i < subQueryCount; i++)
+            {
+                if (filterKeys[i].empty())
+                    continue;
+
+                bool is_filter = false;
+                if (op == Xapian::Query::OP_FILTER 
+                 || op == Xapian::Query::OP_AND_NOT)
+                    is_filter = i > 0;
+                else if (op == Xapian::Query::OP_AND)
+                    is_filter = has_weighted && !isSubWeighted[i];
+
+                if (is_filter)
+                {
+                    subQueries[i] = cachedFilter(filterKeys[i], 
+                        subQueries[i], sources);
+                    isSubWeighted[i] = false;
+                }
+            }
 
-            std::vector<Xapian::Query>::iterator qbegin = subQueries.begin();
-            std::vector<Xapian::Query>::iterator qend   = subQueries.end();
-            Xapian::Query q(
+            return buildGroupQuery(
                 static_cast<Xapian::Query::op>(op), 
-                qbegin, 
-                qend, 
-                static_cast<Xapian::termcount>(parameter));
-            return q;
+                static_cast<Xapian::termcount>(parameter), 
+                subQueries, 
+                isSubWeighted, 
+                is_weighted);
         }
 
         case QUERY_VALUE:
@@ -1301,6 +1734,7 @@ Driver::buildQuery(CP)
                 static_cast<Xapian::Query::op>(op), 
                 slot, 
                 value);
+            is_weighted = false;
             return q;
         }
             
@@ -1315,6 +1749,7 @@ Driver::buildQuery(CP)
                 slot, 
                 from,
                 to);
+            is_weighted = false;
             return q;
         }
 
@@ -1332,16 +1767,28 @@ Driver::buildQuery(CP)
 
         case QUERY_PARSER: // query_string
         {
+            // The parser settings, the query string, the prefix and flags
+            // are used as a key for the cache.
+            const char* from = params.currentPosition();
             Xapian::QueryParser parser = readParser(con, params);
             const std::string&  query_string   = params;
             const std::string&  default_prefix = params;
             const unsigned flags               = decodeParserFeatureFlags(params);
 
-            Xapian::Query q = 
-            parser.parse_query(
-                query_string, 
-                flags, 
-                default_prefix);
+            if (m_is_writable)
+                return parser.parse_query(query_string, flags, default_prefix);
+
+            const std::string key(from, 
+                static_cast<size_t>(params.currentPosition() - from));
+            Xapian::Query q;
+            if (!m_query_cache.get(key, q))
+            {
+                q = parser.parse_query(
+                    query_string, 
+                    flags, 
+                    default_prefix);
+                m_query_cache.put(key, q);
+            }
             return q;
         }
 
@@ -1349,12 +1796,15 @@ Driver::buildQuery(CP)
         {
             const uint8_t op        = params;
             const double  factor    = params;
-            Xapian::Query sub_query = buildQuery(con, params);
+            Xapian::Query sub_query = 
+                buildQuery(con, params, is_weighted);
 
+            // The factor 0 declares a boolean subquery.
             Xapian::Query q(
                 static_cast<Xapian::Query::op>(op), 
                 sub_query, 
                 factor);
+            is_weighted = is_weighted && factor != 0;
             return q;
         }
 
@@ -1385,17 +1835,110 @@ Driver::buildQuery(CP)
 }
 
 
+Xapian::Query
+Driver::cachedFilter(const std::string& key, const Xapian::Query& query,
+    FilterSources& sources)
+{
+    DocIdSet* p_set = m_filter_cache.get(key);
+    if (p_set != NULL)
+        return sources.query(p_set);
+
+    // Collect all docids once, in the ascending order.
+    // The collector sees each match, no MSet items are kept.
+    Xapian::Enquire enquire(m_db);
+    enquire.set_query(query);
+    enquire.set_weighting_scheme(Xapian::BoolWeight());
+    enquire.set_docid_order(Xapian::Enquire::ASCENDING);
+
+    p_set = new DocIdSet;
+    DocIdSetCollector collector(*p_set);
+    try
+    {
+        enquire.get_mset(0, 0, m_db.get_doccount(), NULL, &collector);
+    }
+    catch (...)
+    {
+        DocIdSet::release(p_set);
+        throw;
+    }
+    p_set->compact();
+
+    // The source takes its own reference first: a set, which is too
+    // large for the cache, is released by put.
+    Xapian::Query filter = sources.query(p_set);
+    m_filter_cache.put(key, p_set);
+    return filter;
+}
+
+
+bool
+Driver::isFilterCacheEnabled() const
+{
+    return m_filter_cache.isEnabled() && m_number_of_databases == 1;
+}
+
+
+/**
+ * Subqueries without weights are not scored: they are moved under
+ * OP_FILTER for OP_AND and dropped from OP_AND_MAYBE.
+ */
+Xapian::Query
+Driver::buildGroupQuery(Xapian::Query::op op, Xapian::termcount parameter,
+    const std::vector<Xapian::Query>& sub_queries,
+    const std::vector<bool>& is_sub_weighted, bool& is_weighted)
+{
+    std::vector<Xapian::Query> scored, filters;
+    for (size_t i = 0; i < sub_queries.size(); i++)
+        (is_sub_weighted[i] ? scored : filters).push_back(sub_queries[i]);
+    is_weighted = !scored.empty();
+
+    switch (op)
+    {
+        case Xapian::Query::OP_AND_NOT:
+        case Xapian::Query::OP_FILTER:
+            // Only the left subquery is scored.
+            is_weighted = !sub_queries.empty() && is_sub_weighted[0];
+            break;
+
+        case Xapian::Query::OP_AND:
+            if (!scored.empty() && !filters.empty())
+                return Xapian::Query(Xapian::Query::OP_FILTER,
+                    Xapian::Query(op, scored.begin(), scored.end()),
+                    Xapian::Query(op, filters.begin(), filters.end()));
+            break;
+
+        case Xapian::Query::OP_AND_MAYBE:
+            // Optional subqueries without weights change nothing.
+            if (!sub_queries.empty() 
+             && scored.size() == (is_sub_weighted[0] ? 1u : 0u))
+                return sub_queries[0];
+            break;
+
+        default:
+            break;
+    }
+
+    return Xapian::Query(op, sub_queries.begin(), sub_queries.end(), 
+                         parameter);
+}
+
+
 void 
 Driver::fillEnquire(CP, Xapian::Enquire& enquire)
 {
     Xapian::termcount   qlen = 0;
+    const char* from = params.currentPosition();
+    SortOrder order;
+    bool is_bool_weight = false;
+    bool has_weighting_scheme = false;
+    bool is_weighted = true;
 
     while (uint8_t command = params)
     switch (command)
     {
     case EC_QUERY:
         {
-        Xapian::Query   query = buildQuery(con, params);
+        Xapian::Query   query = buildQuery(con, params, is_weighted);
         enquire.set_query(query, qlen);
         break;
         }
@@ -1409,7 +1952,7 @@ Driver::fillEnquire(CP, Xapian::Enquire& enquire)
 
     case EC_ORDER:
         {
-        fillEnquireOrder(con, params, enquire);
+        fillEnquireOrder(con, params, enquire, order);
         break;
         }
 
@@ -1419,8 +1962,9 @@ Driver::fillEnquire(CP, Xapian::Enquire& enquire)
         if (type >= DOCID_ORDER_TYPE_COUNT)
             throw BadCommandDriverError(POS, type);
         
-        Xapian::Enquire::docid_order order = DOCID_ORDER_TYPES[type];
-        enquire.set_docid_order(order);
+        Xapian::Enquire::docid_order docid_order = DOCID_ORDER_TYPES[type];
+        enquire.set_docid_order(docid_order);
+        order.is_docid_descending = docid_order == Xapian::Enquire::DESCENDING;
         break;
         }
 
@@ -1428,6 +1972,9 @@ Driver::fillEnquire(CP, Xapian::Enquire& enquire)
         {
         const Xapian::Weight& weight = extractWeight(con, params);
         enquire.set_weighting_scheme(weight);
+        is_bool_weight = 
+            dynamic_cast<const Xapian::BoolWeight*>(&weight) != NULL;
+        has_weighting_scheme = true;
         break;
         }
 
@@ -1449,17 +1996,42 @@ Driver::fillEnquire(CP, Xapian::Enquire& enquire)
         break;
         }
 
+    case EC_TIMEOUT:
+        {
+        uint32_t timeout = params;
+        con.set_timeout(timeout);
+        break;
+        }
+
     default:
         throw BadCommandDriverError(POS, command);
     }
+
+    // Encoded settings are a part of the key of the MSet cache.
+    con.set_cache_key(std::string(from, 
+        static_cast<size_t>(params.currentPosition() - from)));
+
+    // Weights of a query without terms are 0 anyway, 
+    // skip calculating them.
+    if (!is_weighted && !has_weighting_scheme)
+    {
+        enquire.set_weighting_scheme(Xapian::BoolWeight());
+        is_bool_weight = true;
+    }
+
+    // All weights are 0, documents are ordered by docid.
+    if (is_bool_weight && order.type == SortOrder::BY_RELEVANCE)
+        order.type = SortOrder::BY_DOCID;
+    con.set_sort_order(order);
 }
 
 
 void
-Driver::fillEnquireOrder(CP, Xapian::Enquire& enquire)
+Driver::fillEnquireOrder(CP, Xapian::Enquire& enquire, SortOrder& order)
 {
     uint8_t type   = params;
     bool reverse   = params;
+    order.type = SortOrder::BY_OTHER;
 
     switch(type)
     {
@@ -1488,6 +2060,9 @@ Driver::fillEnquireOrder(CP, Xapian::Enquire& enquire)
         {
         uint32_t value = params;
         enquire.set_sort_by_value(value, reverse);
+        order.type       = SortOrder::BY_VALUE;
+        order.slot       = static_cast<Xapian::valueno>(value);
+        order.is_reverse = reverse;
         break;
         }
 
@@ -1511,11 +2086,8 @@ Driver::fillEnquireOrder(CP, Xapian::Enquire& enquire)
 }
 
 
-/** 
- * Returns a cloned parser.
- */
-Xapian::QueryParser 
-Driver::selectParser(ParamDecoder& params)
+QueryParserFactory& 
+Driver::selectParserFactory(ParamDecoder& params)
 {
     uint8_t type = params;
     switch (type)
@@ -1549,10 +2121,14 @@ Driver::selectGenerator(ParamDecoder& params)
 }
 
 /**
- * Return a cloned parser.
+ * Return a parser.
+ *
+ * The prebuilt parser of the factory is shared, it is replaced with
+ * a fresh one before the first change. If @a is_owned is true, the result
+ * is never shared (it will be stored as a resource).
  */
 Xapian::QueryParser
-Driver::readParser(CP)
+Driver::readParser(CP, bool is_owned)
 {
   uint8_t command = params;
   // No parameters?
@@ -1560,13 +2136,24 @@ Driver::readParser(CP)
   //
   // Return the wrapper without changes.
   if (!command)
-    return m_default_parser;
+    return is_owned 
+        ? static_cast<Xapian::QueryParser>(m_default_parser_factory)
+        : m_default_parser_factory.prebuilt();
  
-  // Clone parser
-  Xapian::QueryParser qp = m_default_parser_factory;
+  // qp is the prebuilt parser of p_base, until p_base is NULL.
+  QueryParserFactory* p_base = &m_default_parser_factory;
+  Xapian::QueryParser qp = p_base->prebuilt();
 
   do
   {
+    if (p_base != NULL 
+     && command != QP_PARSER_TYPE && command != QP_FROM_RESOURCE)
+    {
+        // Clone parser
+        qp = *p_base;
+        p_base = NULL;
+    }
+
     switch (command)
     {
     case QP_STEMMER: 
@@ -1611,8 +2198,8 @@ Driver::readParser(CP)
         }
 
     case QP_PARSER_TYPE: 
-        // Clone
-        qp = selectParser(params);
+        p_base = &selectParserFactory(params);
+        qp = p_base->prebuilt();
         break; 
 
 
@@ -1623,6 +2210,7 @@ Driver::readParser(CP)
         con.attachContext(elem);
         // Copy from resource
         qp = elem;
+        p_base = NULL;
         break;
         }
 
@@ -1646,6 +2234,9 @@ Driver::readParser(CP)
   } while((command = params)); // yes, it's an assignment [-Wparentheses]
   // warning: suggest parentheses around assignment used as truth value
 
+  if (is_owned && p_base != NULL)
+    qp = *p_base;
+
   return qp;
 }
 
@@ -1839,6 +2430,10 @@ Driver::handleCommand(PR,
             query(con, params, result);
             break;
 
+        case COUNT:
+            count(con, params, result);
+            break;
+
         case SET_DEFAULT_STEMMER:
             setDefaultStemmer(params);
             break;
@@ -1906,6 +2501,7 @@ Driver::handleCommand(PR,
         case CLOSE: 
             m_wdb.close();
             m_db.close();
+            m_shard_searcher.clear();
             break;
 
         case CREATE_QUERY_PARSER: 
@@ -1924,18 +2520,41 @@ Driver::handleCommand(PR,
             parseString(con, params, result);
             break;
 
+        case BATCH:
+            batch(params, result);
+            break;
+
+        case RESOURCE_LIMITS:
+            m_store.resourceLimits(params, result);
+            break;
+
+        case RESOURCE_INFO:
+            m_store.resourceInfo(result);
+            break;
+
+        case QUERY_CACHE:
+            queryCache(params, result);
+            break;
+
+        case MSET_CACHE:
+            msetCache(params, result);
+            break;
+
+        case SHARD_SEARCH:
+            shardSearch(params, result);
+            break;
+
+        case FILTER_CACHE:
+            filterCache(params, result);
+            break;
+
         default:
             throw BadCommandDriverError(POS, command);
         }
     }
     catch (DriverRuntimeError& e) 
     {
-        result.reset();
-        result << static_cast<uint8_t>( ERROR_WITH_POSITION );
-        result << e.get_type();
-        result << e.what();
-        result << e.get_line();
-        result << e.get_file();
+        encodeError(result, e);
     }
     catch (Xapian::Error& e) 
     {
@@ -1946,17 +2565,127 @@ Driver::handleCommand(PR,
     }
 }
 
+
+void
+Driver::encodeError(ResultEncoder& result, const DriverRuntimeError& e)
+{
+    result.reset();
+    result << static_cast<uint8_t>( ERROR_WITH_POSITION );
+    result << e.get_type();
+    result << e.what();
+    result << e.get_line();
+    result << e.get_file();
+}
+
+void
+Driver::queryCache(PR)
+{
+    const bool is_set = params;
+    if (is_set)
+    {
+        const uint32_t capacity = params;
+        m_query_cache.setCapacity(capacity);
+    }
+
+    // see xapian_server:decode_cache_result/1
+    result << m_query_cache.capacity()
+           << m_query_cache.size()
+           << m_query_cache.hits()
+           << m_query_cache.misses()
+           << m_query_cache.evictions();
+}
+
+
+void
+Driver::msetCache(PR)
+{
+    const bool is_set = params;
+    if (is_set)
+    {
+        const uint32_t capacity = params;
+        m_mset_cache.setCapacity(capacity);
+    }
+
+    // see xapian_server:decode_cache_result/1
+    result << m_mset_cache.capacity()
+           << m_mset_cache.size()
+           << m_mset_cache.hits()
+           << m_mset_cache.misses()
+           << m_mset_cache.evictions();
+}
+
+
+void
+Driver::filterCache(PR)
+{
+    // see xapian_server:port_filter_cache/2
+    const uint8_t what = params;
+    switch (what)
+    {
+        case 0:
+            break;
+
+        case 1:
+        {
+            const uint32_t capacity = params;
+            m_filter_cache.setCapacity(capacity);
+            break;
+        }
+
+        case 2:
+        {
+            const uint32_t max_memory = params;
+            m_filter_cache.setMaxMemory(max_memory);
+            break;
+        }
+
+        default:
+            throw BadCommandDriverError(POS, what);
+    }
+
+    // see xapian_server:decode_filter_cache_result/1
+    const size_t memory = m_filter_cache.memory();
+    const uint32_t max_uint = ~static_cast<uint32_t>(0);
+    result << m_filter_cache.capacity()
+           << m_filter_cache.size()
+           << m_filter_cache.hits()
+           << m_filter_cache.misses()
+           << m_filter_cache.evictions()
+           << static_cast<uint32_t>(memory > max_uint ? max_uint : memory)
+           << static_cast<uint32_t>(m_filter_cache.maxMemory());
+}
+
+
+void
+Driver::shardSearch(PR)
+{
+    const bool is_set = params;
+    if (is_set)
+    {
+        const uint32_t thread_count     = params;
+        const bool     is_local_weights = params;
+        m_shard_searcher.setThreadCount(thread_count);
+        m_shard_searcher.setLocalWeights(is_local_weights);
+    }
+
+    // see xapian_server:decode_shard_search_result/1
+    result << m_shard_searcher.threadCount()
+           << m_shard_searcher.shardCount()
+           << static_cast<uint8_t>(m_shard_searcher.isLocalWeights())
+           << m_shard_searcher.searchCount();
+}
+
+
 void
 Driver::setDatabaseAgain()
 {
-    m_default_parser.set_database(m_db);
-    m_standard_parser.set_database(m_db);
     m_default_generator.set_database(m_wdb);
     m_standard_generator.set_database(m_wdb);
     m_default_parser_factory.set_database(m_db);
     m_standard_parser_factory.set_database(m_db);
     m_default_generator_factory.set_database(m_wdb);
     m_standard_generator_factory.set_database(m_wdb);
+    invalidateCaches();
 }
 
 void 
@@ -1968,6 +2697,9 @@ Driver::open(uint8_t mode, const std::string& dbpath)
         case READ_OPEN:
             m_db.add_database(Xapian::Database(dbpath));
             m_number_of_databases++;
+            // Handles are not shared with m_db, they are used by 
+            // other threads.
+            m_shard_searcher.addShard(Xapian::Database(dbpath));
             break;
 
         case WRITE_CREATE_OR_OPEN:
@@ -1976,7 +2708,9 @@ Driver::open(uint8_t mode, const std::string& dbpath)
         case WRITE_OPEN:
             m_wdb = Xapian::WritableDatabase(dbpath, openWriteMode(mode));
             m_db = m_wdb;
+            m_is_writable = true;
             m_number_of_databases = 1;
+            m_shard_searcher.clear();
             break;
 
         default:
@@ -2035,6 +2769,7 @@ Driver::open(uint8_t mode, const std::string& host, uint16_t port,
             m_wdb = Xapian::Remote::open_writable(host, port, 
                     timeout, connect_timeout);
             m_db = m_wdb;
+            m_is_writable = true;
             m_number_of_databases = 1;
             break;
 
@@ -2065,6 +2800,7 @@ Driver::open(uint8_t mode, const std::string& prog, const std::string& args,
         case WRITE_OPEN:
             m_wdb = Xapian::Remote::open_writable(prog, args, timeout);
             m_db = m_wdb;
+            m_is_writable = true;
             m_number_of_databases = 1;
             break;
 
@@ -2423,382 +3159,299 @@ Driver::handlePosting(
     doc.add_posting(tname, term_pos, wdf2);
 }
 
-void 
-Driver::retrieveDocument(PCR,
-    Xapian::Document& doc)
+/**
+ * Write fields of a document, which is not from an MSet.
+ */
+void
+Driver::retrieveSingleDocument(PR, Xapian::Document& doc)
 {
-    const uint8_t decoder_type = params;
-    if (decoder_type != DEC_DOCUMENT)
+    const RetrievalSchema schema = retrieveDocumentSchema(params);
+    if (schema.decoderType() != DEC_DOCUMENT)
         throw BadArgumentDriverError(POS);
+    retrieveDocument(schema, result, &doc, NULL);
+}
 
-    while (const uint8_t command = params)
-    /* Do, while command != stop != 0 */
+
+void 
+Driver::retrieveDocument(const RetrievalSchema& schema, ResultEncoder& result,
+    Xapian::Document* doc, Xapian::MSetIterator* mset_iter)
+{
+    retrieveFields(schema, result, doc, mset_iter);
+}
+
+
+/**
+ * Write fields of a document.
+ * @a doc is NULL for DEC_ITERATOR, @a mset_iter is NULL for DEC_DOCUMENT.
+ * The schema was checked by @ref retrieveDocumentSchema.
+ */
+template <class Iter>
+void 
+Driver::retrieveFields(const RetrievalSchema& schema, ResultEncoder& result,
+    Xapian::Document* doc, Iter* mset_iter)
+{
+    FieldEncoder out(result);
+    for (RetrievalSchema::const_iterator 
+            field = schema.begin(), end = schema.end();
+         field != end;
+         field++)
     {
-        switch (command)
+        switch (field->command)
         {
             case GET_VALUE:
             {
-                const uint32_t     slot  = params;
                 const uint8_t      type  = STRING_TYPE;
                 const std::string& value = 
-                    doc.get_value(static_cast<Xapian::valueno>(slot));
-                result << type << value;
+                    doc->get_value(static_cast<Xapian::valueno>(field->slot));
+                out << type << value;
                 break;
             }
 
             case GET_FLOAT_VALUE:
             {
-                const uint32_t     slot  = params;
                 const uint8_t      type  = DOUBLE_TYPE;
                 const double       value = 
                     Xapian::sortable_unserialise(
-                        doc.get_value(static_cast<Xapian::valueno>(slot)));
-                result << type << value;
+                        doc->get_value(
+                            static_cast<Xapian::valueno>(field->slot)));
+                out << type << value;
                 break;
             }
 
             case GET_DATA:
             {
-                const std::string& data = doc.get_data();
-                result << data;
+                const std::string& data = doc->get_data();
+                out << data;
                 break;
             }
 
             case GET_ALL_TERMS:
             {
-                retrieveTermValues(result, doc);
+                retrieveTermValues(out, *doc);
                 break;
             }
 
             case GET_ALL_TERMS_POS:
             {
-                retrieveTermValuesAndPositions(result, doc);
+                retrieveTermValuesAndPositions(out, *doc);
                 break;
             }
 
             case GET_ALL_VALUES:
             {
-                retrieveSlotAndValues(result, doc);
+                retrieveSlotAndValues(out, *doc);
                 break;
             }
 
+            // http://trac.xapian.org/wiki/FAQ/MultiDatabaseDocumentID
             case GET_DOCID:
             {
-                const Xapian::docid docid = doc.get_docid();
-                result << static_cast<uint32_t>(docid);
+                const Xapian::docid docid = (doc != NULL)
+                    ? doc->get_docid()
+                    : docid_sub(**mset_iter);
+                out << static_cast<uint32_t>(docid);
                 break;
             }
 
-            default:
-                throw BadCommandDriverError(POS, command);
-        }
-    }
-}
-
-void 
-Driver::retrieveDocument(PCR,
-    Xapian::MSetIterator& mset_iter)
-{
-    const uint8_t decoder_type = params;
-    if (decoder_type != DEC_ITERATOR)
-        throw BadArgumentDriverError(POS);
-
-    while (const uint8_t command = params)
-    /* Do, while command != stop != 0 */
-    {
-        switch (command)
-        {
             case GET_WEIGHT:
             {
-                const Xapian::weight    w = mset_iter.get_weight();
-                result << static_cast<double>(w);
+                const Xapian::weight    w = mset_iter->get_weight();
+                out << static_cast<double>(w);
                 break;
             }
 
             case GET_RANK:
             {
-                const Xapian::doccount    r = mset_iter.get_rank();
-                result << static_cast<uint32_t>(r);
+                const Xapian::doccount    r = mset_iter->get_rank();
+                out << static_cast<uint32_t>(r);
                 break;
             }
 
             case GET_PERCENT:
             {
-                const Xapian::percent    p = mset_iter.get_percent();
-                result << static_cast<uint8_t>(p);
-                break;
-            }
-
-            // http://trac.xapian.org/wiki/FAQ/MultiDatabaseDocumentID
-            case GET_DOCID:
-            {
-                result << static_cast<uint32_t>(docid_sub(*mset_iter));
+                const Xapian::percent    p = mset_iter->get_percent();
+                out << static_cast<uint8_t>(p);
                 break;
             }
 
             case GET_MULTI_DOCID:
             {
-                result << static_cast<uint32_t>(*mset_iter);
+                out << static_cast<uint32_t>(**mset_iter);
                 break;
             }
 
-
             case GET_DB_NUMBER:
             {
-                result << static_cast<uint32_t>(subdb_num(*mset_iter));
+                out << static_cast<uint32_t>(subdb_num(**mset_iter));
                 break;
             }
 
             case GET_COLLAPSE_KEY:
             {
-                const std::string& key = mset_iter.get_collapse_key();
-                result << key;
+                const std::string& key = mset_iter->get_collapse_key();
+                out << key;
                 break;
             }
 
             case GET_COLLAPSE_COUNT:
             {
-                result << static_cast<uint32_t>(mset_iter.get_collapse_count());
+                out << static_cast<uint32_t>(mset_iter->get_collapse_count());
+                break;
+            }
+
+            case GET_COMPACT:
+            {
+                out.setCompact();
                 break;
             }
 
             default:
-                throw BadCommandDriverError(POS, command);
+                throw BadCommandDriverError(POS, field->command);
         }
     }
 }
 
 
 void 
-Driver::retrieveDocument(PCR,
-    Xapian::Document& doc,
-    Xapian::MSetIterator& mset_iter)
-{
-    const uint8_t decoder_type = params;
-    if (decoder_type != DEC_BOTH)
-        throw BadArgumentDriverError(POS);
-
-    //Xapian::docid did = *m;
-    while (const uint8_t command = params)
-    /* Do, while command != stop != 0 */
+Driver::retrieveTerm(const RetrievalSchema& schema, ResultEncoder& result,
+    const Xapian::TermIterator& iter)
+{
+    FieldEncoder out(result);
+    for (RetrievalSchema::const_iterator 
+            field = schema.begin(), end = schema.end();
+         field != end;
+         field++)
     {
-        switch (command)
+        switch (field->command)
         {
-            case GET_VALUE:
-            {
-                const uint32_t     slot  = params;
-                const uint8_t      type  = STRING_TYPE;
-                const std::string& value = 
-                    doc.get_value(static_cast<Xapian::valueno>(slot));
-                result << type << value;
-                break;
-            }
-
-            case GET_FLOAT_VALUE:
-            {
-                const uint32_t     slot  = params;
-                const uint8_t      type  = DOUBLE_TYPE;
-                const double       value = 
-                    Xapian::sortable_unserialise(
-                        doc.get_value(static_cast<Xapian::valueno>(slot)));
-                result << type << value;
-                break;
-            }
-
-            case GET_DATA:
-            {
-                const std::string& data = doc.get_data();
-                result << data;
-                break;
-            }
-
-            case GET_ALL_TERMS:
-            {
-                retrieveTermValues(result, doc);
-                break;
-            }
-
-            case GET_ALL_TERMS_POS:
-            {
-                retrieveTermValuesAndPositions(result, doc);
-                break;
-            }
-
-            case GET_ALL_VALUES:
-            {
-                retrieveSlotAndValues(result, doc);
-                break;
-            }
-
-            case GET_DOCID:
-            {
-                const Xapian::docid docid = doc.get_docid();
-                result << static_cast<uint32_t>(docid);
-                break;
-            }
-
-            case GET_WEIGHT:
+            case TERM_VALUE:
             {
-                const Xapian::weight    w = mset_iter.get_weight();
-                result << static_cast<double>(w);
+                const std::string& value = *iter;
+                out << value;
                 break;
             }
 
-            case GET_RANK:
+            case TERM_FLOAT_VALUE:
             {
-                const Xapian::doccount    r = mset_iter.get_rank();
-                result << static_cast<uint32_t>(r);
+                const std::string& value = *iter;
+                const double float_value = Xapian::sortable_unserialise(value);
+                out << float_value;
                 break;
             }
 
-            case GET_PERCENT:
+            case TERM_WDF:
             {
-                const Xapian::percent    p = mset_iter.get_percent();
-                result << static_cast<uint8_t>(p);
+                out << static_cast<uint32_t>(iter.get_wdf());
                 break;
             }
 
-            // http://trac.xapian.org/wiki/FAQ/MultiDatabaseDocumentID
-            case GET_MULTI_DOCID:
+            case TERM_FREQ:
             {
-                result << static_cast<uint32_t>(*mset_iter);
+                out << static_cast<uint32_t>(iter.get_termfreq());
                 break;
             }
 
-            case GET_DB_NUMBER:
+            case TERM_POS_COUNT:
             {
-                result << static_cast<uint32_t>(subdb_num(*mset_iter));
+                out << static_cast<uint32_t>(iter.positionlist_count());
                 break;
             }
 
-            case GET_COLLAPSE_KEY:
+            case TERM_POSITIONS:
             {
-                const std::string& key = mset_iter.get_collapse_key();
-                result << key;
+                out.positions(iter);
                 break;
             }
 
-            case GET_COLLAPSE_COUNT:
+            case TERM_COMPACT:
             {
-                result << static_cast<uint32_t>(mset_iter.get_collapse_count());
+                out.setCompact();
                 break;
             }
 
             default:
-                throw BadCommandDriverError(POS, command);
+                throw BadCommandDriverError(POS, field->command);
         }
     }
 }
 
 
 /**
- * @a params is copy.
+ * Decode a list of term fields.
  */
-void 
-Driver::retrieveTerm(PCR, const Xapian::TermIterator& iter)
+RetrievalSchema
+Driver::retrieveTermSchema(
+    ParamDecoder& params) const
 {
+    RetrievalSchema schema;
     while (const uint8_t command = params)
     /* Do, while command != stop != 0 */
     {
         switch (command)
         {
             case TERM_VALUE:
-            {
-                const std::string& value = *iter;
-                result << value;
-                break;
-            }
-
             case TERM_FLOAT_VALUE:
-            {
-                const std::string& value = *iter;
-                const double float_value = Xapian::sortable_unserialise(value);
-                result << float_value;
-                break;
-            }
-
             case TERM_WDF:
-            {
-                result << static_cast<uint32_t>(iter.get_wdf());
-                break;
-            }
-
             case TERM_FREQ:
-            {
-                result << static_cast<uint32_t>(iter.get_termfreq());
-                break;
-            }
-
             case TERM_POS_COUNT:
-            {
-                result << static_cast<uint32_t>(iter.positionlist_count());
-                break;
-            }
-
             case TERM_POSITIONS:
-            {
-                Xapian::termcount count = iter.positionlist_count();
-                result << static_cast<uint32_t>(count);
-                if (count > 0)
-                    for (Xapian::PositionIterator 
-                            piter = iter.positionlist_begin(),
-                            pend = iter.positionlist_end();
-                        piter != pend;
-                        piter++)
-                        result << static_cast<uint32_t>(*piter);
+            case TERM_COMPACT:
                 break;
-            }
 
             default:
                 throw BadCommandDriverError(POS, command);
         }
+        schema.add(command);
     }
+    return schema;
 }
 
-ParamDecoderController
-Driver::retrieveTermSchema(
-    ParamDecoder& params) const
-{
-    const char* from = params.currentPosition();
-
-    while (const uint8_t command = params)
-    /* Do, while command != stop != 0 */
-    {}
-
-    const char* to = params.currentPosition();
-
-    size_t len = to - from;
-    ParamDecoderController ctrl(m_mm, from, len);
-    return ctrl;
-}
-
-
 
-
-ParamDecoderController
+/**
+ * Decode a decoder type and a list of document fields.
+ * Fields must be available from the selected sources.
+ */
+RetrievalSchema
 Driver::retrieveDocumentSchema(
     ParamDecoder& params) const
 {
-    const char* from = params.currentPosition();
-    uint8_t decoder_type = params;
-    (void) decoder_type;
+    RetrievalSchema schema;
+    const uint8_t decoder_type = params;
+    switch (decoder_type)
+    {
+        case DEC_DOCUMENT:
+        case DEC_ITERATOR:
+        case DEC_BOTH:
+            break;
+
+        default:
+            throw BadCommandDriverError(POS, decoder_type);
+    }
+    schema.setDecoderType(decoder_type);
+
+    const bool has_doc  = decoder_type != DEC_ITERATOR;
+    const bool has_iter = decoder_type != DEC_DOCUMENT;
 
     while (const uint8_t command = params)
     /* Do, while command != stop != 0 */
     {
+        uint32_t slot = 0;
+        bool is_valid;
         switch (command)
         {
             case GET_FLOAT_VALUE:
             case GET_VALUE:
-            {
-                //static_cast<uint32_t>( params ); // slot
-                uint32_t slot = params; // slot
-                (void) slot;
+                slot = params;
+                is_valid = has_doc;
                 break;
-            }
 
             case GET_DATA:
-            case GET_DOCID:
+            case GET_ALL_TERMS:
+            case GET_ALL_VALUES:
+            case GET_ALL_TERMS_POS:
+                is_valid = has_doc;
+                break;
+
             case GET_WEIGHT:
             case GET_RANK:
             case GET_PERCENT:
@@ -2806,28 +3459,31 @@ Driver::retrieveDocumentSchema(
             case GET_DB_NUMBER:
             case GET_COLLAPSE_KEY:
             case GET_COLLAPSE_COUNT:
-            case GET_ALL_TERMS:
-            case GET_ALL_VALUES:
+                is_valid = has_iter;
+                break;
+
+            case GET_DOCID:
+            case GET_COMPACT:
+                is_valid = true;
                 break;
 
             default:
                 throw BadCommandDriverError(POS, command);
         }
-    }
 
-    const char* to = params.currentPosition();
-
-    size_t len = to - from;
-    ParamDecoderController ctrl(m_mm, from, len);
-    return ctrl;
+        if (!is_valid)
+            throw BadCommandDriverError(POS, command);
+        schema.add(command, slot);
+    }
+    return schema;
 }
 
 
-ParamDecoderController
+ParamDecoder
 Driver::applyDocumentSchema(
     ParamDecoder& params)
 {
-    const char* from = params.currentPosition();
+    char* from = params.currentPosition();
 
     while (const uint8_t command = params)
     /* Do, while command != stop != 0 */
@@ -2961,9 +3617,10 @@ Driver::applyDocumentSchema(
 
     const char* to = params.currentPosition();
 
-    size_t len = to - from;
-    ParamDecoderController ctrl(m_mm, from, len);
-    return ctrl;
+    // The request buffer lives until the command is handled,
+    // so the schema is not copied.
+    const size_t len = static_cast<size_t>(to - from);
+    return ParamDecoder(from, len);
 }
 
 
@@ -2992,7 +3649,8 @@ Driver::createResource(PR)
 void 
 Driver::msetInfo(PR)
 {
-    Xapian::MSet& mset = m_store.extract(params);
+    Resource::Element elem = m_store.extract(params);
+    Xapian::MSet& mset = elem;
 
     while (uint8_t command = params)
     switch (command)
@@ -3050,6 +3708,19 @@ Driver::msetInfo(PR)
             break;
         }
 
+        case MI_IS_TRUNCATED:
+            result << static_cast<uint8_t>(elem.is_truncated());
+            break;
+
+        case MI_CURSOR:
+        {
+            const std::string& cursor = mset.empty() 
+                ? std::string()
+                : SearchCursor::encode(elem.get_sort_order(), mset.back());
+            result << cursor;
+            break;
+        }
+
         default:
             throw BadCommandDriverError(POS, command);
     }
@@ -3225,7 +3896,7 @@ Driver::setMetadata(ParamDecoder& params)
  * Use set order of elements.
  *
  * @param driver_params Contains which keys (term names) to find. Ends with "".
- * @param schema_params Contains which fields to write. 
+ * @param schema        Contains which fields to write. 
  * @param result        A buffer for writing.
  * @param iter          First term for searching in.
  * @param end           Last term for searching in.
@@ -3235,14 +3906,17 @@ Driver::setMetadata(ParamDecoder& params)
 void
 Driver::qlcTermIteratorLookup(
     ParamDecoder& driver_params, 
-    const ParamDecoder& schema_params, 
+    const RetrievalSchema& schema, 
     ResultEncoder& result,
     Xapian::TermIterator iter,
     const Xapian::TermIterator end)
 {
     // Flags, that signal about end of list.
     const uint8_t more = 1, stop = 0;
-    std::set<std::string> terms;
+
+    // Terms point inside driver_params or float_terms, they are not copied.
+    std::set<StringRef> terms;
+    std::vector<std::string> float_terms;
 
     const uint8_t encoder_type = driver_params;
 
@@ -3252,7 +3926,7 @@ Driver::qlcTermIteratorLookup(
         {
             while(true)
             {
-                const std::string& term = driver_params;
+                const StringRef term = driver_params;
                 // first term is not empty
                 assert(!terms.empty() || !term.empty());
                 if (term.empty()) break;
@@ -3264,12 +3938,15 @@ Driver::qlcTermIteratorLookup(
 
         case TERM_FLOAT_VALUE:
         {
-            for (uint32_t length = driver_params; length; length--)
+            const uint32_t length = driver_params;
+            // No reallocations: references on elements must stay valid.
+            float_terms.reserve(length);
+            for (uint32_t i = 0; i < length; i++)
             {
                 const double& float_term = driver_params;
-                const std::string& term = Xapian::sortable_serialise(float_term);
+                float_terms.push_back(Xapian::sortable_serialise(float_term));
 
-                terms.insert(term);
+                terms.insert(StringRef(float_terms.back()));
                 assert(!terms.empty());
             }
             break;
@@ -3287,15 +3964,14 @@ Driver::qlcTermIteratorLookup(
     // Special case when we want to lookup only 1 element
     if (terms.size() == 1)
     {
-        std::string term = *(terms.begin());
+        const std::string term = terms.begin()->str();
         iter.skip_to(term);
         if ((iter != end) && (*iter == term))
         {
             // Put a flag
             result << more;
 
-            ParamDecoder params = schema_params;
-            retrieveTerm(params, result, iter);
+            retrieveTerm(schema, result, iter);
         }
         result << stop;
         return;    
@@ -3303,14 +3979,13 @@ Driver::qlcTermIteratorLookup(
 
     for (; iter != end; iter++)
     {
-        if (terms.find(*iter) != terms.end())
+        const std::string& value = *iter;
+        if (terms.find(StringRef(value)) != terms.end())
         {
             // Put a flag
             result << more;
 
-            // Clone params
-            ParamDecoder params = schema_params;
-            retrieveTerm(params, result, iter);
+            retrieveTerm(schema, result, iter);
         }
     };
     result << stop;
@@ -3318,62 +3993,54 @@ Driver::qlcTermIteratorLookup(
 
 
 void
-Driver::retrieveTermValues(ResultEncoder& result, Xapian::Document& doc)
+Driver::retrieveTermValues(FieldEncoder& out, Xapian::Document& doc)
 {
     
     Xapian::TermIterator iter, end;
     uint32_t size = static_cast<uint32_t>(doc.termlist_count());
     iter = doc.termlist_begin();
     end = doc.termlist_end();
-    result << size;
+    out << size;
     for (; iter != end; iter++)
     {
         const std::string& value = *iter;
-        result << value;
+        out << value;
     }
 }
 
 void
-Driver::retrieveTermValuesAndPositions(ResultEncoder& result, Xapian::Document& doc)
+Driver::retrieveTermValuesAndPositions(FieldEncoder& out, Xapian::Document& doc)
 {
     
     Xapian::TermIterator iter, end;
     uint32_t size = static_cast<uint32_t>(doc.termlist_count());
     iter = doc.termlist_begin();
     end = doc.termlist_end();
-    result << size;
+    out << size;
     for (; iter != end; iter++)
     {
         const std::string& value = *iter;
-        result << value;
+        out << value;
 
         // See TERM_POSITIONS
-        Xapian::termcount count = iter.positionlist_count();
-        result << static_cast<uint32_t>(count);
-        if (count > 0)
-            for (Xapian::PositionIterator 
-                    piter = iter.positionlist_begin(),
-                    pend = iter.positionlist_end();
-                piter != pend;
-                piter++)
-                result << static_cast<uint32_t>(*piter);
+        out.positions(iter);
     }
 }
 
 void
-Driver::retrieveSlotAndValues(ResultEncoder& result, Xapian::Document& doc)
+Driver::retrieveSlotAndValues(FieldEncoder& out, Xapian::Document& doc)
 {
     Xapian::ValueIterator
         iter = doc.values_begin(),
         end = doc.values_end();
     uint32_t size = static_cast<uint32_t>(doc.values_count());
-    result << size;
+    out << size;
     for (; iter != end; iter++)
     {
         Xapian::valueno slot_no = iter.get_valueno();
         const std::string& value = *iter;
-        result << slot_no;
-        result << value;
+        out << slot_no;
+        out << value;
     }
 }
 
@@ -5,9 +5,17 @@
 #include <stdint.h>
 
 #include "result_encoder.h"
+#include "memory_arena.h"
+#include "query_cache.h"
+#include "mset_cache.h"
+#include "filter_cache.h"
+#include "shard_search.h"
+#include "search_cursor.h"
 #include "query_parser_factory.h"
 #include "term_generator_factory.h"
 #include "qlc.h"
+#include "retrieval_schema.h"
+#include "param_decoder_controller.h"
 #include "resource/factory.h"
 
 
@@ -16,6 +24,8 @@ XAPIAN_ERLANG_NS_BEGIN
 
 // internal
 class HellTermPosition;
+class FieldEncoder;
+class DriverRuntimeError;
 
 
 // -------------------------------------------------------------------
@@ -28,8 +38,6 @@ class Driver
     Xapian::WritableDatabase m_wdb;
     Xapian::Stem m_default_stemmer;
 
-    Xapian::QueryParser m_default_parser;
-    Xapian::QueryParser m_standard_parser;
     Xapian::TermGenerator m_default_generator;
     Xapian::TermGenerator m_standard_generator;
 
@@ -49,8 +57,41 @@ class Driver
      * It is a manager of ObjectRegisters.
      */
     unsigned            m_number_of_databases;
+
+    /* The database was opened for writing. */
+    bool                m_is_writable;
+
+    /**
+     * Queries, parsed by QUERY_PARSER subqueries.
+     * It is not used for writable databases, because their terms change.
+     */
+    QueryCache          m_query_cache;
+
+    /**
+     * Results of MATCH_SET and QUERY_PAGE.
+     * It is cleared, when the database is opened or changed.
+     */
+    MSetCache           m_mset_cache;
+
+    /**
+     * Docids of filter subqueries.
+     * It is cleared, when the database is opened or changed.
+     */
+    FilterCache         m_filter_cache;
+
+    /**
+     * Separate handles of databases, opened with READ_OPEN, 
+     * for the fan-out search of QUERY_PAGE.
+     */
+    ShardSearcher       m_shard_searcher;
     MemoryManager&      m_mm;
 
+    /**
+     * Memory for temporary encoders (sub-results of BATCH).
+     * It is reset after each request.
+     */
+    ArenaMemoryManager  m_scratch;
+
     /// Assignment operator.
     /// Assignment is not allowed.
     Driver & operator= (const Driver & /*source*/) { assert(false); return *this; }
@@ -58,7 +99,8 @@ class Driver
     /// Copy constructor.
     /// Copy is not allowed.
     Driver(const Driver & source) 
-    : m_store(*this), m_mm(source.m_mm) { assert(false); }
+    : m_store(*this), m_mm(source.m_mm), m_scratch(source.m_mm)
+    { assert(false); }
 
     public:
     friend class MSetQlcTable;
@@ -110,7 +152,15 @@ class Driver
         REMOVE_SYNONYM              = 40,
         CLEAR_SYNONYMS              = 41,
         CREATE_TERM_GENERATOR       = 42,
-        GET_SPELLING_CORRECTION     = 43
+        GET_SPELLING_CORRECTION     = 43,
+        BATCH                       = 44,
+        RESOURCE_LIMITS             = 45,
+        RESOURCE_INFO               = 46,
+        QUERY_CACHE                 = 47,
+        MSET_CACHE                  = 48,
+        SHARD_SEARCH                = 49,
+        COUNT                       = 50,
+        FILTER_CACHE                = 51
     };
 
 
@@ -119,7 +169,10 @@ class Driver
     enum e_errorCode {
         SUCCESS                     = 0,
         ERROR                       = 1,
-        ERROR_WITH_POSITION         = 2
+        ERROR_WITH_POSITION         = 2,
+        // The command was not run, because an async job holds the Driver.
+        // It is returned only by the port driver.
+        BUSY                        = 3
     };
 
     // see fun xapian_common:append_unique_document_id/2
@@ -188,7 +241,9 @@ class Driver
         GET_COLLAPSE_COUNT          = 11,
         GET_ALL_TERMS               = 12,
         GET_ALL_VALUES              = 13,
-        GET_ALL_TERMS_POS           = 14
+        GET_ALL_TERMS_POS           = 14,
+        /// Not a field: next fields are encoded compactly.
+        GET_COMPACT                 = 15
     };
 
     enum e_encodedValueType {
@@ -202,7 +257,9 @@ class Driver
         TEST_RESULT_ENCODER         = 1,
         TEST_EXCEPTION              = 2,
         TEST_ECHO                   = 3,
-        TEST_MEMORY                 = 4
+        TEST_MEMORY                 = 4,
+        TEST_RESULT_GROWTH          = 5,
+        TEST_EXPIRED_DEADLINE       = 6
     };
 
     enum e_queryType {
@@ -263,7 +320,8 @@ class Driver
         EC_DOCID_ORDER              = 4,
         EC_WEIGHTING_SCHEME         = 5,
         EC_CUTOFF                   = 6,
-        EC_COLLAPSE_KEY             = 7
+        EC_COLLAPSE_KEY             = 7,
+        EC_TIMEOUT                  = 8
     };
 
     enum e_enquireOrderTypes {
@@ -286,7 +344,9 @@ class Driver
         MI_GET_MAX_POSSIBLE                 = 8,
         MI_GET_MAX_ATTAINED                 = 9,
         MI_TERM_WEIGHT                      = 10,
-        MI_TERM_FREQ                        = 11
+        MI_TERM_FREQ                        = 11,
+        MI_IS_TRUNCATED                     = 12,
+        MI_CURSOR                           = 13
     };
 
     enum e_matchSpyInfoParams {
@@ -320,7 +380,9 @@ class Driver
         TERM_FREQ                           = 3,
         TERM_POSITIONS                      = 4,
         TERM_POS_COUNT                      = 5,
-        TERM_FLOAT_VALUE                    = 6
+        TERM_FLOAT_VALUE                    = 6,
+        /// Not a field: next fields are encoded compactly.
+        TERM_COMPACT                        = 7
     };
 
     enum e_decoderTypeFunIds {
@@ -387,8 +449,9 @@ class Driver
 
     /**
      * A constructor.
+     * Search threads are created by @a tm.
      */
-    Driver(MemoryManager&);
+    Driver(MemoryManager& mm, ThreadManager& tm);
 
     ~Driver();
 
@@ -401,6 +464,20 @@ class Driver
     void
     handleCommand(PR, const unsigned int  command);
 
+    /**
+     * This driver is a read-only copy of an other driver.
+     * It has the same databases and defaults, but not resources.
+     */
+    void
+    setReplica() { m_store.setReplica(); }
+
+    /**
+     * Returns true, if the last command used a resource reference, 
+     * that this replica cannot resolve.
+     */
+    bool
+    takeReplicaMiss() { return m_store.takeUnresolved(); }
+
     void setDefaultStemmer(const Xapian::Stem& stemmer);
 
     int openWriteMode(uint8_t mode);
@@ -438,6 +515,13 @@ class Driver
      */
     void query(CPR);
 
+    /**
+     * `count'
+     * Params: IsExact, Query.
+     * Result: LowerBound, Estimated, UpperBound.
+     */
+    void count(CPR);
+
     /**
      * Write a resource.
      */
@@ -484,6 +568,19 @@ class Driver
 
 
     void testResultEncoder(ResultEncoder&, Xapian::docid from, Xapian::docid to);
+
+    /**
+     * Params: MaxSegmentLen, ReserveLen, Count.
+     * Result: SegmentCount, ReservedLen, Size.
+     */
+    void testResultGrowth(PR);
+
+    /**
+     * Match a term with a deadline, which has already passed.
+     * Params: Term, MaxItems.
+     * Result: Size, IsTruncated.
+     */
+    void testExpiredDeadline(PR);
     void testEcho(PR);
     void testException();
     void testMemory();
@@ -500,24 +597,40 @@ class Driver
     /*! \} */
 
     /** 
-     * Gets a copy of params.
-     *
-     * `params' is a clone.
+     * Schemas are decoded once with @ref retrieveDocumentSchema or 
+     * @ref retrieveTermSchema and applied to each object.
+     */
+    void retrieveDocument(const RetrievalSchema&, ResultEncoder&,
+                          Xapian::Document*, Xapian::MSetIterator*);
+    void retrieveDocument(const RetrievalSchema&, ResultEncoder&,
+                          Xapian::MSetIterator&);
+    void retrieveDocument(const RetrievalSchema&, ResultEncoder&,
+                          ShardMatchIterator&);
+    void retrieveDocuments(const RetrievalSchema&, ResultEncoder&,
+                           Xapian::MSetIterator, Xapian::MSetIterator);
+    void retrieveDocuments(const RetrievalSchema&, ResultEncoder&,
+                           Xapian::MSetIterator, Xapian::MSetIterator,
+                           uint32_t count);
+    void retrieveSingleDocument(PR, Xapian::Document&);
+
+    /**
+     * @a Iter is Xapian::MSetIterator or ShardMatchIterator.
      */
-    void retrieveDocument(PCR, Xapian::Document&, Xapian::MSetIterator&);
-    void retrieveDocument(PCR, Xapian::Document&);
-    void retrieveDocument(PCR, Xapian::MSetIterator&);
-    void retrieveDocuments(PCR, Xapian::MSetIterator, Xapian::MSetIterator);
-    void selectEncoderAndRetrieveDocument(PR, Xapian::MSetIterator&);
+    template <class Iter>
+    void retrieveMatchItem(const RetrievalSchema&, ResultEncoder&, Iter&);
+    template <class Iter>
+    void retrieveFields(const RetrievalSchema&, ResultEncoder&,
+                        Xapian::Document*, Iter*);
 
-    ParamDecoderController
+    RetrievalSchema
     retrieveDocumentSchema(ParamDecoder&) const;
 
     static void
-    retrieveTerm(PCR, const Xapian::TermIterator& iter);
+    retrieveTerm(const RetrievalSchema&, ResultEncoder&, 
+                 const Xapian::TermIterator& iter);
     
      
-    ParamDecoderController
+    RetrievalSchema
     retrieveTermSchema(ParamDecoder&) const; 
 
 
@@ -532,23 +645,56 @@ class Driver
      * Run applyDocument without creating the real doc.
      * It is useful, if you want to find the position of the ParamDecoder
      * after running the applyDocument.
+     * The returned decoder points into the buffer of @a params.
      */
-    ParamDecoderController
+    ParamDecoder
     applyDocumentSchema(ParamDecoder&);
     
 
     Xapian::Query 
     buildQuery(CP);
 
+    /**
+     * @a is_weighted is false, if the query cannot give weights:
+     * value ranges, subqueries scaled by 0 and their groups.
+     */
+    Xapian::Query 
+    buildQuery(CP, bool& is_weighted);
+
+    /**
+     * Returns a query over the cached docids of @a query.
+     */
+    Xapian::Query
+    cachedFilter(const std::string& key, const Xapian::Query& query,
+        FilterSources& sources);
+
+    /**
+     * True, if the cache is on and only one database is opened.
+     * Docids of sub-databases are not cached.
+     */
+    bool
+    isFilterCacheEnabled() const;
+
+    static Xapian::Query
+    buildGroupQuery(Xapian::Query::op op, Xapian::termcount parameter,
+        const std::vector<Xapian::Query>& sub_queries,
+        const std::vector<bool>& is_sub_weighted, bool& is_weighted);
+
     void fillEnquire(CP, Xapian::Enquire& enquire);
 
-    void fillEnquireOrder(CP, Xapian::Enquire& enquire);
+    void fillEnquireOrder(CP, Xapian::Enquire& enquire, SortOrder& order);
 
     /**
      * Throws error if the database was opened only for reading.
      */
     void assertWriteable() const;
 
+    /**
+     * Drop cached queries, match results and filters.
+     * It is called, when the database or default parser settings change.
+     */
+    void invalidateCaches();
+
     static unsigned
     idToParserFeature(int type);
 
@@ -569,10 +715,10 @@ class Driver
     readStemmingStrategy(ParamDecoder&);
 
     Xapian::QueryParser
-    readParser(CP);
+    readParser(CP, bool is_owned = false);
 
-    Xapian::QueryParser 
-    selectParser(ParamDecoder&);
+    QueryParserFactory& 
+    selectParserFactory(ParamDecoder&);
 
     Xapian::TermGenerator
     readGenerator(CP);
@@ -622,7 +768,7 @@ class Driver
     static void
     qlcTermIteratorLookup(
         ParamDecoder& driver_params, 
-        const ParamDecoder& schema_params, 
+        const RetrievalSchema& schema, 
         ResultEncoder& result,
         Xapian::TermIterator iter,
         const Xapian::TermIterator end);
@@ -709,17 +855,96 @@ class Driver
     void
     parseString(CPR);
 
+    /**
+     * Handle few commands in one call.
+     * Each sub-result has its own status.
+     */
+    void
+    batch(PR);
+
+    /**
+     * Replace @a result with the error status and the description of @a e.
+     */
+    static void
+    encodeError(ResultEncoder& result, const DriverRuntimeError& e);
+
     void
     setDatabaseAgain();
 
+    /**
+     * Params: IsSet, [Capacity].
+     * Result: Capacity, Size, Hits, Misses, Evictions.
+     */
+    void
+    queryCache(PR);
+
+    /**
+     * The same for the MSet cache.
+     */
+    void
+    msetCache(PR);
+
+    /**
+     * The same for the filter cache, with Memory at the end.
+     */
+    void
+    filterCache(PR);
+
+    /**
+     * Params: IsSet, [ThreadCount, IsLocalWeights].
+     * Result: ThreadCount, ShardCount, IsLocalWeights, SearchCount.
+     */
+    void
+    shardSearch(PR);
+
+    /**
+     * True, if all databases are local shards, threads are started and
+     * the query can be ranked on shards (see ShardSearcher).
+     */
+    bool
+    isShardSearchEnabled(bool is_weighted) const;
+
+    void
+    queryShards(const Xapian::Query& query, bool is_weighted, uint32_t offset, 
+        uint32_t pagesize, uint32_t timeout, PR);
+
+    /**
+     * Read a term or an AND/OR group of terms.
+     * Returns false, if the query has another form. @a params is moved
+     * only in the case of success.
+     */
+    static bool
+    readTermGroup(ParamDecoder& params, uint8_t& op, 
+        std::vector<std::string>& terms);
+
+    /**
+     * Count documents from term frequencies, without matching.
+     * Returns true, if the bounds are equal.
+     */
+    bool
+    countTermGroup(uint8_t op, const std::vector<std::string>& terms,
+        Xapian::doccount& lower, Xapian::doccount& estimated, 
+        Xapian::doccount& upper);
+
+    /**
+     * Return a cached result of a match or run the match.
+     * Results, stopped by the deadline, are not cached.
+     * @a p_filter is an additional decider or NULL.
+     */
+    Resource::Element
+    cachedMatch(const std::string& key, Xapian::Enquire& enquire,
+        Xapian::doccount first, Xapian::doccount maxitems,
+        Xapian::doccount checkatleast, uint32_t timeout,
+        const Xapian::MatchDecider* p_filter);
+
     static void
-    retrieveTermValues(ResultEncoder& result, Xapian::Document& doc);
+    retrieveTermValues(FieldEncoder& out, Xapian::Document& doc);
 
     static void
-    retrieveTermValuesAndPositions(ResultEncoder& result, Xapian::Document& doc);
+    retrieveTermValuesAndPositions(FieldEncoder& out, Xapian::Document& doc);
 
     static void
-    retrieveSlotAndValues(ResultEncoder& result, Xapian::Document& doc);
+    retrieveSlotAndValues(FieldEncoder& out, Xapian::Document& doc);
 };
 
 XAPIAN_ERLANG_NS_END
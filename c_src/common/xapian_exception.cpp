@@ -138,6 +138,21 @@ ElementNotFoundDriverError::buildString(uint32_t num)
 }
 
 
+// -------------------------------------------------------------------
+// ElementEvictedDriverError
+// -------------------------------------------------------------------
+ElementEvictedDriverError::ElementEvictedDriverError(GET_POS, uint32_t num) : 
+    DriverRuntimeError(SET_POS, TYPE, buildString(num)) {}
+
+const std::string 
+ElementEvictedDriverError::buildString(uint32_t num)
+{
+    std::stringstream ss;
+    ss << "Element with number = " << num << " was evicted "
+          "by the resource memory budget or the idle TTL.";
+    return ss.str();
+}
+
 // -------------------------------------------------------------------
 // GroupResourceTypeMismatchDriverError
 // -------------------------------------------------------------------
@@ -225,6 +240,7 @@ REG_TYPE(OverflowDriverError)
 REG_TYPE(NotWritableDatabaseError)
 REG_TYPE(DbIsNotReadyDriverError)
 REG_TYPE(ElementNotFoundDriverError)
+REG_TYPE(ElementEvictedDriverError)
 REG_TYPE(MatchSpyFinalizedDriverError)
 REG_TYPE(GroupResourceTypeMismatchDriverError)
 REG_TYPE(ResourceTypeMismatchDriverError)
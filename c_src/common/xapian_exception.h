@@ -120,6 +120,17 @@ class ElementNotFoundDriverError: public DriverRuntimeError
     buildString(uint32_t num);
 };
 
+class ElementEvictedDriverError: public DriverRuntimeError
+{
+    static const char TYPE[];
+
+    public:
+    ElementEvictedDriverError(GET_POS, uint32_t num);
+
+    static const std::string 
+    buildString(uint32_t num);
+};
+
 class GroupResourceTypeMismatchDriverError: public DriverRuntimeError
 {
     static const char TYPE[];
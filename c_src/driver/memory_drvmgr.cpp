@@ -1,5 +1,8 @@
 // External imports
 #include "erl_driver.h"
+#include "xapian_drvctrl.h"
+
+#include <cstddef>
 
 // Internal imports
 #include "memory_drvmgr.h"
@@ -24,5 +27,27 @@ void DriverMemoryManager::free(void* buf)
     driver_free(buf);
 }
 
+
+
+void* DriverBinaryMemoryManager::alloc(size_t size)
+{
+    ErlDrvBinary* bin = driver_alloc_binary(static_cast<ErlDrvSizeT>(size));
+    if (bin == NULL)
+        throw MemoryAllocationDriverError(POS, size);
+    return bin->orig_bytes;
+}
+
+void DriverBinaryMemoryManager::free(void* buf)
+{
+    /* Decrease the refcounter. The VM can still use this binary. */
+    driver_free_binary(toBinary(buf));
+}
+
+ErlDrvBinary* DriverBinaryMemoryManager::toBinary(void* buf)
+{
+    char* pos = static_cast<char*>(buf) - offsetof(ErlDrvBinary, orig_bytes);
+    return reinterpret_cast<ErlDrvBinary*>( pos );
+}
+
 XAPIAN_ERLANG_NS_END
 
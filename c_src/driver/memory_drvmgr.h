@@ -1,6 +1,7 @@
 #ifndef DRIVER_MEMORY_MANAGER_H
 #define DRIVER_MEMORY_MANAGER_H
 
+#include "erl_driver.h"
 #include "xapian_config.h"
 #include "memory_manager.h"
 XAPIAN_ERLANG_NS_BEGIN
@@ -12,6 +13,24 @@ class DriverMemoryManager: public MemoryManager
     void free(void* pos);
 };
 
+
+/**
+ * Each block is a payload of a refcounted driver binary.
+ * The block can be passed to the VM without copying.
+ * @see DriverBinaryMemoryManager::toBinary
+ */
+class DriverBinaryMemoryManager: public MemoryManager
+{
+    public:
+    void* alloc(size_t size);
+    void free(void* pos);
+
+    /**
+     * Returns the binary, which contains the block @a pos.
+     */
+    static ErlDrvBinary* toBinary(void* pos);
+};
+
 XAPIAN_ERLANG_NS_END
 
 #endif
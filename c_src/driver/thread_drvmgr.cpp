@@ -0,0 +1,74 @@
+// External imports
+#include "erl_driver.h"
+
+#include <cstddef>
+
+// Internal imports
+#include "thread_drvmgr.h"
+
+XAPIAN_ERLANG_NS_BEGIN
+
+ThreadManager::Thread 
+DriverThreadManager::createThread(ThreadFunction fun, void* arg)
+{
+    ErlDrvTid tid;
+    if (erl_drv_thread_create(const_cast<char*>("xapian_drv_thread"), 
+            &tid, fun, arg, NULL) != 0)
+        return NULL;
+    return tid;
+}
+
+void DriverThreadManager::joinThread(Thread thread)
+{
+    erl_drv_thread_join(static_cast<ErlDrvTid>(thread), NULL);
+}
+
+
+ThreadManager::Mutex DriverThreadManager::createMutex()
+{
+    return erl_drv_mutex_create(const_cast<char*>("xapian_drv_mutex"));
+}
+
+void DriverThreadManager::destroyMutex(Mutex mutex)
+{
+    erl_drv_mutex_destroy(static_cast<ErlDrvMutex*>(mutex));
+}
+
+void DriverThreadManager::lock(Mutex mutex)
+{
+    erl_drv_mutex_lock(static_cast<ErlDrvMutex*>(mutex));
+}
+
+void DriverThreadManager::unlock(Mutex mutex)
+{
+    erl_drv_mutex_unlock(static_cast<ErlDrvMutex*>(mutex));
+}
+
+
+ThreadManager::Cond DriverThreadManager::createCond()
+{
+    return erl_drv_cond_create(const_cast<char*>("xapian_drv_cond"));
+}
+
+void DriverThreadManager::destroyCond(Cond cond)
+{
+    erl_drv_cond_destroy(static_cast<ErlDrvCond*>(cond));
+}
+
+void DriverThreadManager::wait(Cond cond, Mutex mutex)
+{
+    erl_drv_cond_wait(static_cast<ErlDrvCond*>(cond), 
+                      static_cast<ErlDrvMutex*>(mutex));
+}
+
+void DriverThreadManager::signal(Cond cond)
+{
+    erl_drv_cond_signal(static_cast<ErlDrvCond*>(cond));
+}
+
+void DriverThreadManager::broadcast(Cond cond)
+{
+    erl_drv_cond_broadcast(static_cast<ErlDrvCond*>(cond));
+}
+
+XAPIAN_ERLANG_NS_END
@@ -0,0 +1,32 @@
+#ifndef DRIVER_THREAD_MANAGER_H
+#define DRIVER_THREAD_MANAGER_H
+
+#include "erl_driver.h"
+#include "xapian_config.h"
+#include "thread_manager.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * Uses erl_drv_thread_create, erl_drv_mutex and erl_drv_cond.
+ */
+class DriverThreadManager: public ThreadManager
+{
+    public:
+    Thread createThread(ThreadFunction fun, void* arg);
+    void joinThread(Thread thread);
+
+    Mutex createMutex();
+    void destroyMutex(Mutex mutex);
+    void lock(Mutex mutex);
+    void unlock(Mutex mutex);
+
+    Cond createCond();
+    void destroyCond(Cond cond);
+    void wait(Cond cond, Mutex mutex);
+    void signal(Cond cond);
+    void broadcast(Cond cond);
+};
+
+XAPIAN_ERLANG_NS_END
+
+#endif
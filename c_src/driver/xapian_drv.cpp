@@ -57,7 +57,7 @@ ErlDrvEntry xapian_driver_entry = {
 
        void (*output)(ErlDrvData drv_data, char *buf, ErlDrvSizeT len);
      */
-    NULL,
+    XapianErlang::DriverController::output,
 
     /* F_PTR ready_input, called when input descriptor ready.
        called when we have input from one of the driver's handles.
@@ -118,7 +118,7 @@ ErlDrvEntry xapian_driver_entry = {
 
        void (*ready_async)(ErlDrvData drv_data, ErlDrvThreadData thread_data);
      */
-    NULL,
+    XapianErlang::DriverController::readyAsync,
 
     /* F_PTR flush.
        called when the port is about to be closed, and there is data in the 
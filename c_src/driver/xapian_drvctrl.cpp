@@ -2,11 +2,15 @@
 #include "xapian_exception.h"
 #include "xapian_core.h"
 #include "memory_drvmgr.h"
+#include "thread_drvmgr.h"
+#include "memory_arena.h"
 
 #include "param_decoder.h"
 #include "result_encoder.h"
 
 #include <assert.h>
+#include <cstring>
+#include <stdint.h>
 
 // -------------------------------------------------------------------
 // Globals
@@ -15,6 +19,80 @@
 XAPIAN_ERLANG_NS_BEGIN
 
 MemoryManager* gp_driverMemoryManager = NULL;
+MemoryManager* gp_binaryMemoryManager = NULL;
+ThreadManager* gp_driverThreadManager = NULL;
+
+/* The length of the buffer, preallocated for results of async commands. */
+#define ASYNC_RESULT_BUF_LEN 1024
+
+
+/**
+ * A command, that is waiting in the queue of the async thread pool or
+ * is handled right now.
+ */
+struct AsyncJob
+{
+    DriverInstance* inst;
+    uint32_t        req_id;
+    uint32_t        command;
+
+    /* A copy of the parameters (the emulator owns the original buffer). */
+    char*           params;
+    size_t          params_len;
+
+    /* The preallocated buffer of the result.
+       It starts with the request id. */
+    ErlDrvBinary*   head;
+
+    /* Extended segments are allocated as driver binaries. */
+    ResultEncoder*  result;
+};
+
+
+// -------------------------------------------------------------------
+// DriverInstance
+// -------------------------------------------------------------------
+
+DriverInstance::DriverInstance(ErlDrvPort e_port, Driver* e_drv)
+    : port(e_port), drv(e_drv), job_count(0), ref_count(1)
+{
+    cmd_lock  = erl_drv_mutex_create(const_cast<char*>("xapian_cmd_lock"));
+    ref_lock  = erl_drv_mutex_create(const_cast<char*>("xapian_ref_lock"));
+    /* The key selects an async thread. */
+    async_key = static_cast<unsigned int>( 
+        reinterpret_cast<size_t>( this ) >> 4 );
+    arena = new ArenaMemoryManager(*gp_driverMemoryManager);
+}
+
+
+DriverInstance::~DriverInstance()
+{
+    delete drv;
+    delete arena;
+    erl_drv_mutex_destroy(cmd_lock);
+    erl_drv_mutex_destroy(ref_lock);
+}
+
+
+void
+DriverInstance::incref()
+{
+    erl_drv_mutex_lock(ref_lock);
+    ref_count++;
+    erl_drv_mutex_unlock(ref_lock);
+}
+
+
+void
+DriverInstance::decref()
+{
+    erl_drv_mutex_lock(ref_lock);
+    const bool is_last = (--ref_count == 0);
+    erl_drv_mutex_unlock(ref_lock);
+
+    if (is_last)
+        delete this;
+}
 
 /**
  * Create global variables
@@ -26,6 +104,14 @@ DriverController::init()
     {
         gp_driverMemoryManager = new DriverMemoryManager();
     }
+    if (gp_binaryMemoryManager == NULL)
+    {
+        gp_binaryMemoryManager = new DriverBinaryMemoryManager();
+    }
+    if (gp_driverThreadManager == NULL)
+    {
+        gp_driverThreadManager = new DriverThreadManager();
+    }
     return 0;
 }
 
@@ -40,6 +126,16 @@ DriverController::finish()
         delete gp_driverMemoryManager;
 
     gp_driverMemoryManager = NULL;
+
+    if (gp_binaryMemoryManager != NULL)
+        delete gp_binaryMemoryManager;
+
+    gp_binaryMemoryManager = NULL;
+
+    if (gp_driverThreadManager != NULL)
+        delete gp_driverThreadManager;
+
+    gp_driverThreadManager = NULL;
 }
 
 
@@ -51,20 +147,25 @@ DriverController::start(
     /* If the flag is set to PORT_CONTROL_FLAG_BINARY, 
        a binary will be returned. */       
     set_port_control_flags(port, PORT_CONTROL_FLAG_BINARY); 
-    Driver* drv_data = new Driver(*gp_driverMemoryManager);
+    Driver* drv = new Driver(*gp_driverMemoryManager, *gp_driverThreadManager);
+    DriverInstance* drv_data = new DriverInstance(port, drv);
     return reinterpret_cast<ErlDrvData>( drv_data );
 }
 
 
+/**
+ * Async jobs can still use the Driver.
+ * The last job will delete it.
+ */
 void 
 DriverController::stop(
     ErlDrvData drv_data) 
 {
-    Driver* 
-    drv = reinterpret_cast<Driver*>( drv_data );
+    DriverInstance* 
+    inst = reinterpret_cast<DriverInstance*>( drv_data );
 
-    if (drv != NULL)
-        delete drv;
+    if (inst != NULL)
+        inst->decref();
 } 
 
 
@@ -81,11 +182,24 @@ DriverController::control(
     const size_t len  = static_cast<int>(e_len);
     const size_t rlen = static_cast<int>(e_rlen);
 
-    Driver& drv = * reinterpret_cast<Driver*>( drv_data );
+    DriverInstance& inst = * reinterpret_cast<DriverInstance*>( drv_data );
+
+    /* Earlier commands are queued. Do not run ahead of them and do not 
+       wait for them on the scheduler, xapian_port:control/3 will queue 
+       this command after them. */
+    if (inst.job_count != 0)
+    {
+        assert(rlen >= 1);
+        (*rbuf)[0] = static_cast<char>( Driver::BUSY );
+        return 1;
+    }
 
     ParamDecoder params(buf, len); 
-    ResultEncoder result(*gp_driverMemoryManager, *rbuf, rlen);
-    drv.handleCommand(params, result, command);
+    ResultEncoder result(*inst.arena, *rbuf, rlen);
+    /* No job is running, the lock is free. */
+    erl_drv_mutex_lock(inst.cmd_lock);
+    inst.drv->handleCommand(params, result, command);
+    erl_drv_mutex_unlock(inst.cmd_lock);
 
     ErlDrvSSizeT result_len = result.finalSize();
 
@@ -98,7 +212,165 @@ DriverController::control(
         result.finalize(bin->orig_bytes);
         *rbuf = (char*) bin;
     }
+    inst.arena->reset();
     return result_len;
 }
 
+
+void 
+DriverController::output(
+    ErlDrvData    drv_data, 
+    char*         buf, 
+    ErlDrvSizeT   e_len)
+{
+    const size_t len = static_cast<size_t>(e_len);
+    DriverInstance* inst = reinterpret_cast<DriverInstance*>( drv_data );
+
+    uint32_t req_id, command;
+    const size_t header_len = sizeof(req_id) + sizeof(command);
+    if (len < header_len)
+    {
+        driver_failure_atom(inst->port, const_cast<char*>("bad_command"));
+        return;
+    }
+    memcpy(&req_id, buf, sizeof(req_id));
+    memcpy(&command, buf + sizeof(req_id), sizeof(command));
+
+    const size_t params_len = len - header_len;
+    AsyncJob* job = 
+        static_cast<AsyncJob*>( driver_alloc(sizeof(AsyncJob)) );
+    char* params = 
+        static_cast<char*>( driver_alloc(params_len + 1) );
+    ErlDrvBinary* head = driver_alloc_binary(ASYNC_RESULT_BUF_LEN);
+    if (job == NULL || params == NULL || head == NULL)
+    {
+        if (job != NULL) driver_free(job);
+        if (params != NULL) driver_free(params);
+        if (head != NULL) driver_free_binary(head);
+        driver_failure_atom(inst->port, const_cast<char*>("enomem"));
+        return;
+    }
+
+    job->inst       = inst;
+    job->req_id     = req_id;
+    job->command    = command;
+    job->params     = params;
+    job->params_len = params_len;
+    job->head       = head;
+    memcpy(head->orig_bytes, &req_id, sizeof(req_id));
+    /* Extended parts of the result are binaries too. */
+    job->result     = new ResultEncoder(*gp_binaryMemoryManager, 
+        head->orig_bytes + sizeof(req_id), 
+        ASYNC_RESULT_BUF_LEN - sizeof(req_id));
+    /* Each chunk is decoded by Erlang as is, documents are not split. */
+    job->result->setAligned(true);
+    memcpy(params, buf + header_len, params_len);
+
+    /* The job holds the instance until it is delivered or freed. */
+    inst->incref();
+    inst->job_count++;
+    driver_async(inst->port, &inst->async_key, 
+                 &DriverController::invokeAsync, job, 
+                 &DriverController::freeAsync);
+}
+
+
+void 
+DriverController::invokeAsync(void* e_job)
+{
+    AsyncJob& job = * static_cast<AsyncJob*>( e_job );
+
+    ParamDecoder params(job.params, job.params_len); 
+    erl_drv_mutex_lock(job.inst->cmd_lock);
+    job.inst->drv->handleCommand(params, *job.result, job.command);
+    erl_drv_mutex_unlock(job.inst->cmd_lock);
+}
+
+
+/**
+ * Collects chunks of the result into the I/O vector.
+ * All chunks are driver binaries, so nothing is copied.
+ */
+class IOVecBuilder : public ResultVisitor
+{
+    ErlIOVec&       m_ev;
+    ErlDrvBinary*   m_head;
+
+    public:
+    IOVecBuilder(ErlIOVec& ev, ErlDrvBinary* head) 
+        : m_ev(ev), m_head(head) 
+    {}
+
+    void 
+    visit(void* block, const char* data, size_t len)
+    {
+        if (len == 0)
+            return;
+        const int i = m_ev.vsize++;
+        m_ev.iov[i].iov_base = const_cast<char*>( data );
+        m_ev.iov[i].iov_len  = len;
+        m_ev.binv[i] = (block == NULL) 
+            ? m_head 
+            : DriverBinaryMemoryManager::toBinary(block);
+        m_ev.size += static_cast<ErlDrvSizeT>( len );
+    }
+};
+
+
+void 
+DriverController::readyAsync(
+    ErlDrvData /* drv_data */, 
+    ErlDrvThreadData thread_data)
+{
+    AsyncJob* job = reinterpret_cast<AsyncJob*>( thread_data );
+    const ErlDrvPort port = job->inst->port;
+    /* The request id is the first chunk. */
+    const size_t count = job->result->chunkCount() + 1;
+
+    SysIOVec* iov = 
+        static_cast<SysIOVec*>( driver_alloc(sizeof(SysIOVec) * count) );
+    ErlDrvBinary** binv = 
+        static_cast<ErlDrvBinary**>( 
+            driver_alloc(sizeof(ErlDrvBinary*) * count) );
+
+    if (iov == NULL || binv == NULL)
+    {
+        driver_failure_atom(port, const_cast<char*>("enomem"));
+    }
+    else
+    {
+        ErlIOVec ev;
+        ev.vsize = 0;
+        ev.size  = 0;
+        ev.iov   = iov;
+        ev.binv  = binv;
+        IOVecBuilder builder(ev, job->head);
+        builder.visit(NULL, job->head->orig_bytes, sizeof(job->req_id));
+        job->result->visit(builder);
+
+        /* The VM increases refcounters of the binaries. */
+        driver_outputv(port, NULL, 0, &ev, 0);
+    }
+
+    if (iov != NULL) driver_free(iov);
+    if (binv != NULL) driver_free(binv);
+    freeAsync(job);
+}
+
+
+void 
+DriverController::freeAsync(void* e_job)
+{
+    AsyncJob* job = static_cast<AsyncJob*>( e_job );
+    /* It is called from readyAsync too, so each job is counted once. */
+    job->inst->job_count--;
+    /* Release segments. */
+    job->result->clear();
+    delete job->result;
+    driver_free_binary(job->head);
+    driver_free(job->params);
+    job->inst->decref();
+    driver_free(job);
+}
+
 XAPIAN_ERLANG_NS_END
@@ -11,6 +11,49 @@ typedef int  ErlDrvSSizeT;
 
 #include "xapian_config.h"
 XAPIAN_ERLANG_NS_BEGIN
+class Driver;
+class ArenaMemoryManager;
+
+/**
+ * The state of an opened port.
+ * It is shared between the emulator thread and async jobs. 
+ * It is deleted, when the port is stopped and the last job is finished.
+ */
+class DriverInstance
+{
+    public:
+    ErlDrvPort      port;
+    Driver*         drv;
+
+    /* Only one command can be handled by the Driver at the same time. */
+    ErlDrvMutex*    cmd_lock;
+
+    /* The count of async jobs, that are queued or running.
+       While it is not 0, control replies BUSY and Erlang queues the 
+       command after the jobs, so commands are handled in order and
+       the scheduler never waits for cmd_lock.
+       It is changed only under the port lock. */
+    unsigned int    job_count;
+
+    /* Protects ref_count. */
+    ErlDrvMutex*    ref_lock;
+    unsigned int    ref_count;
+
+    /* All jobs of the port are handled by the same async thread in order. */
+    unsigned int    async_key;
+
+    /* Result segments of synchronous commands.
+       It is reset after each call of control. */
+    ArenaMemoryManager* arena;
+
+    DriverInstance(ErlDrvPort port, Driver* drv);
+    ~DriverInstance();
+
+    void incref();
+    void decref();
+};
+
+
 class DriverController
 {
     public:
@@ -42,6 +85,12 @@ class DriverController
     static void 
     stop(ErlDrvData drv_data);
 
+    /**
+     * A synchronous command. 
+     * It is handled on the scheduler thread.
+     * If async jobs are queued or running, the command is not handled:
+     * the reply is the single BUSY byte.
+     */
     static ErlDrvSSizeT control(
         ErlDrvData      drv_data, 
         unsigned int    command, 
@@ -49,6 +98,36 @@ class DriverController
         ErlDrvSizeT     len, 
         char**          rbuf, 
         ErlDrvSizeT     rlen);
+
+    /**
+     * An asynchronous command, sent with `port_command'. 
+     * The first 4 bytes of @a buf are a request id, the next 4 bytes are
+     * a command id, others are parameters.
+     * The command is queued and handled by the async thread pool.
+     * The reply starts with the request id, so replies on a few queued
+     * commands can be told apart.
+     */
+    static void 
+    output(ErlDrvData drv_data, char* buf, ErlDrvSizeT len);
+
+    /**
+     * Called by the emulator, when an async command is handled.
+     * Sends the result back to the port owner.
+     */
+    static void 
+    readyAsync(ErlDrvData drv_data, ErlDrvThreadData thread_data);
+
+    /**
+     * Called in the async thread.
+     */
+    static void 
+    invokeAsync(void* job);
+
+    /**
+     * Called, if the port was closed before the job was delivered.
+     */
+    static void 
+    freeAsync(void* job);
 };
 XAPIAN_ERLANG_NS_END
 #endif
@@ -0,0 +1,23 @@
+// External imports
+#include "erl_nif.h"
+
+// Internal imports
+#include "memory_nifmgr.h"
+#include "xapian_exception.h"
+
+XAPIAN_ERLANG_NS_BEGIN
+
+void* NifMemoryManager::alloc(size_t size)
+{
+    void* buf = enif_alloc(size);
+    if (buf == NULL)
+        throw MemoryAllocationDriverError(POS, size);
+    return buf;
+}
+
+void NifMemoryManager::free(void* buf)
+{
+    enif_free(buf);
+}
+
+XAPIAN_ERLANG_NS_END
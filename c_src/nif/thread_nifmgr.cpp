@@ -0,0 +1,74 @@
+// External imports
+#include "erl_nif.h"
+
+#include <cstddef>
+
+// Internal imports
+#include "thread_nifmgr.h"
+
+XAPIAN_ERLANG_NS_BEGIN
+
+ThreadManager::Thread 
+NifThreadManager::createThread(ThreadFunction fun, void* arg)
+{
+    ErlNifTid tid;
+    if (enif_thread_create(const_cast<char*>("xapian_nif_thread"), 
+            &tid, fun, arg, NULL) != 0)
+        return NULL;
+    return tid;
+}
+
+void NifThreadManager::joinThread(Thread thread)
+{
+    enif_thread_join(static_cast<ErlNifTid>(thread), NULL);
+}
+
+
+ThreadManager::Mutex NifThreadManager::createMutex()
+{
+    return enif_mutex_create(const_cast<char*>("xapian_nif_mutex"));
+}
+
+void NifThreadManager::destroyMutex(Mutex mutex)
+{
+    enif_mutex_destroy(static_cast<ErlNifMutex*>(mutex));
+}
+
+void NifThreadManager::lock(Mutex mutex)
+{
+    enif_mutex_lock(static_cast<ErlNifMutex*>(mutex));
+}
+
+void NifThreadManager::unlock(Mutex mutex)
+{
+    enif_mutex_unlock(static_cast<ErlNifMutex*>(mutex));
+}
+
+
+ThreadManager::Cond NifThreadManager::createCond()
+{
+    return enif_cond_create(const_cast<char*>("xapian_nif_cond"));
+}
+
+void NifThreadManager::destroyCond(Cond cond)
+{
+    enif_cond_destroy(static_cast<ErlNifCond*>(cond));
+}
+
+void NifThreadManager::wait(Cond cond, Mutex mutex)
+{
+    enif_cond_wait(static_cast<ErlNifCond*>(cond), 
+                   static_cast<ErlNifMutex*>(mutex));
+}
+
+void NifThreadManager::signal(Cond cond)
+{
+    enif_cond_signal(static_cast<ErlNifCond*>(cond));
+}
+
+void NifThreadManager::broadcast(Cond cond)
+{
+    enif_cond_broadcast(static_cast<ErlNifCond*>(cond));
+}
+
+XAPIAN_ERLANG_NS_END
@@ -0,0 +1,32 @@
+#ifndef NIF_THREAD_MANAGER_H
+#define NIF_THREAD_MANAGER_H
+
+#include "erl_nif.h"
+#include "xapian_config.h"
+#include "thread_manager.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * Uses enif_thread_create, enif_mutex and enif_cond.
+ */
+class NifThreadManager: public ThreadManager
+{
+    public:
+    Thread createThread(ThreadFunction fun, void* arg);
+    void joinThread(Thread thread);
+
+    Mutex createMutex();
+    void destroyMutex(Mutex mutex);
+    void lock(Mutex mutex);
+    void unlock(Mutex mutex);
+
+    Cond createCond();
+    void destroyCond(Cond cond);
+    void wait(Cond cond, Mutex mutex);
+    void signal(Cond cond);
+    void broadcast(Cond cond);
+};
+
+XAPIAN_ERLANG_NS_END
+
+#endif
@@ -0,0 +1,43 @@
+/* vim: set filetype=cpp shiftwidth=4 tabstop=4 expandtab tw=80: */
+
+/**
+ * Prefix m_ (member) for properties means that property is private.
+ */
+
+// -------------------------------------------------------------------
+// Includes
+// -------------------------------------------------------------------
+
+#include "xapian_nifctrl.h"
+
+
+// -------------------------------------------------------------------
+// Meta information for Erlang
+// -------------------------------------------------------------------
+
+/* Functions of the `xapian_nif' module. 
+   Commands can block for a long time, they are run on dirty schedulers. */
+static ErlNifFunc xapian_nif_funcs[] = {
+    {"open",              0, XapianErlang::NifController::open,    0},
+    {"close",             1, XapianErlang::NifController::close,   0},
+    {"is_alive",          1, XapianErlang::NifController::isAlive, 0},
+
+    /* Most commands read or write the database. */
+    {"dirty_io_control",  3, XapianErlang::NifController::control, 
+        ERL_NIF_DIRTY_JOB_IO_BOUND},
+
+    /* Matching and retrieving of the results. */
+    {"dirty_cpu_control", 3, XapianErlang::NifController::control, 
+        ERL_NIF_DIRTY_JOB_CPU_BOUND}
+};
+
+
+// -------------------------------------------------------------------
+// Call Erlang handler
+// -------------------------------------------------------------------
+
+ERL_NIF_INIT(xapian_nif, xapian_nif_funcs, 
+             XapianErlang::NifController::load, 
+             NULL, 
+             NULL, 
+             XapianErlang::NifController::unload)
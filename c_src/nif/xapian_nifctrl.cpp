@@ -0,0 +1,224 @@
+#include "xapian_nifctrl.h"
+#include "xapian_exception.h"
+#include "xapian_core.h"
+#include "memory_nifmgr.h"
+#include "thread_nifmgr.h"
+#include "memory_arena.h"
+
+#include "param_decoder.h"
+#include "result_encoder.h"
+
+#include <cstring>
+
+// -------------------------------------------------------------------
+// Globals
+// -------------------------------------------------------------------
+
+XAPIAN_ERLANG_NS_BEGIN
+
+MemoryManager* gp_nifMemoryManager = NULL;
+ThreadManager* gp_nifThreadManager = NULL;
+ErlNifResourceType* gp_nifDriverType = NULL;
+
+/* The initial length of the result binary. */
+#define NIF_RESULT_BUF_LEN 1024
+
+
+/**
+ * The result is encoded directly into the reply binary,
+ * which is reallocated, when it is full.
+ */
+class NifBinaryGrower : public ResultBufferGrower
+{
+    ErlNifBinary& m_bin;
+
+    public:
+    NifBinaryGrower(ErlNifBinary& bin) : m_bin(bin) {}
+
+    char*
+    grow(size_t len)
+    {
+        if (!enif_realloc_binary(&m_bin, len))
+            return NULL;
+        return reinterpret_cast<char*>( m_bin.data );
+    }
+};
+
+
+/**
+ * Create global variables
+ */
+int 
+NifController::load(
+    ErlNifEnv* env, 
+    void** /* priv_data */, 
+    ERL_NIF_TERM /* load_info */)
+{
+    ErlNifResourceFlags flags = 
+        static_cast<ErlNifResourceFlags>(ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER);
+    gp_nifDriverType = enif_open_resource_type(env, NULL, "xapian_driver", 
+        &NifController::destroy, flags, NULL);
+    if (gp_nifDriverType == NULL)
+        return -1;
+
+    if (gp_nifMemoryManager == NULL)
+    {
+        gp_nifMemoryManager = new NifMemoryManager();
+    }
+    if (gp_nifThreadManager == NULL)
+    {
+        gp_nifThreadManager = new NifThreadManager();
+    }
+    return 0;
+}
+
+
+/**
+ * Delete global variables
+ */
+void 
+NifController::unload(
+    ErlNifEnv* /* env */, 
+    void* /* priv_data */)
+{
+    if (gp_nifMemoryManager != NULL)
+        delete gp_nifMemoryManager;
+
+    gp_nifMemoryManager = NULL;
+
+    if (gp_nifThreadManager != NULL)
+        delete gp_nifThreadManager;
+
+    gp_nifThreadManager = NULL;
+}
+
+
+ERL_NIF_TERM 
+NifController::open(
+    ErlNifEnv* env, 
+    int /* argc */, 
+    const ERL_NIF_TERM /* argv */[])
+{
+    NifDriver* inst = static_cast<NifDriver*>( 
+        enif_alloc_resource(gp_nifDriverType, sizeof(NifDriver)) );
+    inst->drv  = new Driver(*gp_nifMemoryManager, *gp_nifThreadManager);
+    inst->lock = enif_mutex_create(const_cast<char*>("xapian_nif_lock"));
+    inst->arena = new ArenaMemoryManager(*gp_nifMemoryManager);
+
+    ERL_NIF_TERM term = enif_make_resource(env, inst);
+    /* Now the resource is owned by the term. */
+    enif_release_resource(inst);
+    return term;
+}
+
+
+ERL_NIF_TERM 
+NifController::close(
+    ErlNifEnv* env, 
+    int /* argc */, 
+    const ERL_NIF_TERM argv[])
+{
+    void* obj;
+    if (!enif_get_resource(env, argv[0], gp_nifDriverType, &obj))
+        return enif_make_badarg(env);
+
+    NifDriver* inst = static_cast<NifDriver*>( obj );
+    enif_mutex_lock(inst->lock);
+    delete inst->drv;
+    inst->drv = NULL;
+    enif_mutex_unlock(inst->lock);
+    return enif_make_atom(env, "ok");
+}
+
+
+ERL_NIF_TERM 
+NifController::isAlive(
+    ErlNifEnv* env, 
+    int /* argc */, 
+    const ERL_NIF_TERM argv[])
+{
+    void* obj;
+    if (!enif_get_resource(env, argv[0], gp_nifDriverType, &obj))
+        return enif_make_badarg(env);
+
+    NifDriver* inst = static_cast<NifDriver*>( obj );
+    enif_mutex_lock(inst->lock);
+    const bool is_alive = inst->drv != NULL;
+    enif_mutex_unlock(inst->lock);
+    return enif_make_atom(env, is_alive ? "true" : "false");
+}
+
+
+ERL_NIF_TERM 
+NifController::control(
+    ErlNifEnv* env, 
+    int /* argc */, 
+    const ERL_NIF_TERM argv[])
+{
+    void* obj;
+    unsigned int command;
+    ErlNifBinary data;
+
+    if (!enif_get_resource(env, argv[0], gp_nifDriverType, &obj)
+     || !enif_get_uint(env, argv[1], &command)
+     || !enif_inspect_binary(env, argv[2], &data))
+        return enif_make_badarg(env);
+
+    NifDriver* inst = static_cast<NifDriver*>( obj );
+    ErlNifBinary bin;
+    if (!enif_alloc_binary(NIF_RESULT_BUF_LEN, &bin))
+        return enif_make_badarg(env);
+
+    enif_mutex_lock(inst->lock);
+    if (inst->drv == NULL)
+    {
+        enif_mutex_unlock(inst->lock);
+        enif_release_binary(&bin);
+        return enif_make_badarg(env);
+    }
+    /* The arena is shared by calls, so the result is copied under 
+       the lock too. */
+    NifBinaryGrower grower(bin);
+    ResultEncoder result(*inst->arena, 
+        reinterpret_cast<char*>( bin.data ), bin.size);
+    result.setGrower(&grower);
+
+    /* Params are only read. */
+    ParamDecoder params(reinterpret_cast<char*>( data.data ), data.size); 
+    inst->drv->handleCommand(params, result, command);
+
+    const size_t result_len = result.finalSize();
+    ERL_NIF_TERM term;
+    if (!result.isExtended())
+    {
+        /* The binary holds the whole result, the free tail is cut. */
+        enif_realloc_binary(&bin, result_len);
+        term = enif_make_binary(env, &bin);
+    }
+    else
+    {
+        /* The binary could not grow, segments are merged. */
+        char* dest = reinterpret_cast<char*>( 
+            enif_make_new_binary(env, result_len, &term) );
+        result.finalize(dest);
+        enif_release_binary(&bin);
+    }
+    inst->arena->reset();
+    enif_mutex_unlock(inst->lock);
+    return term;
+}
+
+
+void
+NifController::destroy(
+    ErlNifEnv* /* env */, 
+    void* obj)
+{
+    NifDriver* inst = static_cast<NifDriver*>( obj );
+    if (inst->drv != NULL)
+        delete inst->drv;
+    delete inst->arena;
+    enif_mutex_destroy(inst->lock);
+}
+
+XAPIAN_ERLANG_NS_END
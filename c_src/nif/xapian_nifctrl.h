@@ -0,0 +1,74 @@
+#ifndef XAPIAN_NIF_CONTROLLER_H
+#define XAPIAN_NIF_CONTROLLER_H
+#include "erl_nif.h"
+
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+class Driver;
+class ArenaMemoryManager;
+
+/**
+ * A resource object, that is owned by Erlang.
+ * It is deleted by the garbage collector.
+ */
+struct NifDriver
+{
+    /* NULL, if the instance was closed. */
+    Driver*         drv;
+
+    /* Only one command can be handled by the Driver at the same time. */
+    ErlNifMutex*    lock;
+
+    /* Result segments. It is reset after each command under the lock. */
+    ArenaMemoryManager* arena;
+};
+
+
+class NifController
+{
+    public:
+    /**
+     * The library is loaded.
+     * This is called only once.
+     */
+    static int 
+    load(ErlNifEnv* env, void** priv_data, ERL_NIF_TERM load_info);
+
+    /**
+     * The library is unloaded.
+     * This is called only once.
+     */
+    static void
+    unload(ErlNifEnv* env, void* priv_data);
+
+    /**
+     * Create a new Driver, wrapped into a resource.
+     * It is called from `xapian_nif:open/0'.
+     */
+    static ERL_NIF_TERM 
+    open(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]);
+
+    /**
+     * Delete the Driver. The resource object stays alive.
+     */
+    static ERL_NIF_TERM 
+    close(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]);
+
+    static ERL_NIF_TERM 
+    isAlive(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]);
+
+    /**
+     * Handle a command: (Resource, Command, Params) -> Result.
+     * It is called on a dirty scheduler.
+     */
+    static ERL_NIF_TERM 
+    control(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]);
+
+    /**
+     * Called by the garbage collector.
+     */
+    static void
+    destroy(ErlNifEnv* env, void* obj);
+};
+XAPIAN_ERLANG_NS_END
+#endif
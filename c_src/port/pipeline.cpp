@@ -0,0 +1,403 @@
+/* vim: set filetype=cpp shiftwidth=4 tabstop=4 expandtab tw=80: */
+
+#include <ios>
+#include <cstring>
+#include <assert.h>
+#include <unistd.h>
+
+#include "pipeline.h"
+#include "port_io.h"
+#include "xapian_core.h"
+#include "param_decoder.h"
+#include "result_encoder.h"
+
+XAPIAN_ERLANG_NS_BEGIN
+
+/* The length of the preallocated result buffer of each thread. */
+#define PIPELINE_RESULT_BUF_LEN 1024
+
+
+Pipeline::Pipeline(MemoryManager& mm, ThreadManager& tm, 
+    unsigned worker_count)
+    : m_mm(mm), m_tm(tm), m_arena(mm), m_in_flight(0), m_is_read_only(true),
+      m_is_replica_failed(false)
+{
+    pthread_mutex_init(&m_primary_lock, NULL);
+    pthread_mutex_init(&m_idle_lock, NULL);
+    pthread_cond_init(&m_idle, NULL);
+
+    m_primary = new Driver(m_mm, m_tm);
+
+    for (unsigned i = 0; i < worker_count; i++)
+    {
+        PipelineWorker* worker = new PipelineWorker();
+        worker->pipeline = this;
+        worker->drv = new Driver(m_mm, m_tm);
+        worker->drv->setReplica();
+        m_workers.push_back(worker);
+        pthread_create(&worker->thread, NULL, &Pipeline::workerMain, worker);
+    }
+    pthread_create(&m_writer, NULL, &Pipeline::writerMain, this);
+}
+
+
+/**
+ * Finish queued jobs, write all replies and stop threads.
+ */
+Pipeline::~Pipeline()
+{
+    m_jobs.close();
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        PipelineWorker* worker = m_workers[i];
+        pthread_join(worker->thread, NULL);
+        delete worker->drv;
+        delete worker;
+    }
+    m_replies.close();
+    pthread_join(m_writer, NULL);
+
+    delete m_primary;
+    pthread_cond_destroy(&m_idle);
+    pthread_mutex_destroy(&m_idle_lock);
+    pthread_mutex_destroy(&m_primary_lock);
+}
+
+
+void
+Pipeline::run()
+{
+    PacketReader input(STDIN_FILENO);
+    while(true)
+    {
+        uint32_t len;
+        char* buf = input.next(len);
+
+        /* The input buffer is reused, the job needs its own copy. */
+        ParamDecoder header(buf, len);
+        PipelineJob job;
+        job.request_id = header;
+        job.command    = header;
+        job.params_len = static_cast<uint32_t>( 
+            len - (header.currentPosition() - buf) );
+        job.params     = new char[job.params_len];
+        memcpy(job.params, header.currentPosition(), job.params_len);
+
+        if (isParallel(job.command))
+        {
+            pthread_mutex_lock(&m_idle_lock);
+            m_in_flight++;
+            pthread_mutex_unlock(&m_idle_lock);
+            m_jobs.push(job);
+        }
+        else
+        {
+            handleSerial(job);
+        }
+    }
+}
+
+
+/**
+ * These commands do not change the state of the driver and do not
+ * create resources.
+ */
+bool
+Pipeline::isParallel(uint32_t command) const
+{
+    if (!m_is_read_only || m_is_replica_failed || m_workers.empty())
+        return false;
+
+    switch (command)
+    {
+        case Driver::QUERY_PAGE:
+        case Driver::COUNT:
+        case Driver::DB_INFO:
+        case Driver::GET_DOCUMENT_BY_ID:
+        case Driver::DOCUMENT_INFO:
+        case Driver::IS_DOCUMENT_EXIST:
+        case Driver::LAST_DOC_ID:
+        case Driver::GET_SPELLING_CORRECTION:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+
+void
+Pipeline::handleOnPrimary(const PipelineJob& job, ResultEncoder& result)
+{
+    ParamDecoder params(job.params, job.params_len);
+    pthread_mutex_lock(&m_primary_lock);
+    m_primary->handleCommand(params, result, job.command);
+    pthread_mutex_unlock(&m_primary_lock);
+}
+
+
+void
+Pipeline::handleSerial(PipelineJob& job)
+{
+    PipelineReply rep = createReply(job);
+
+    /* Previous requests must see the old state. */
+    waitIdle();
+    handleOnPrimary(job, *rep.result);
+
+    /* The first byte is a status. */
+    if (rep.buf[0] == Driver::SUCCESS)
+        replicate(job, *rep.result, rep.buf);
+
+    m_replies.push(rep);
+    m_arena.reset();
+    delete[] job.params;
+}
+
+
+/**
+ * Returns the count of counters in the reply on a cache command
+ * or 0 for other commands.
+ */
+static unsigned
+cacheCounterCount(uint32_t command)
+{
+    switch (command)
+    {
+        /* Size, Hits, Misses, Evictions, see Driver::msetCache. */
+        case Driver::QUERY_CACHE:
+        case Driver::MSET_CACHE:
+            return 4;
+
+        /* The same and Memory, see Driver::filterCache. */
+        case Driver::FILTER_CACHE:
+            return 5;
+
+        default:
+            return 0;
+    }
+}
+
+
+/**
+ * Each replica has its own cache.
+ * Its counters are added to the reply of the primary driver.
+ * Both replies are: Status:8, Capacity:32, Counters:32...
+ */
+static void
+addCacheCounters(char* reply_buf, const char* replica_buf, unsigned count)
+{
+    const size_t offset = sizeof(uint8_t) + sizeof(uint32_t);
+    for (unsigned i = 0; i < count; i++)
+    {
+        const size_t pos = offset + i * sizeof(uint32_t);
+        uint32_t sum, value;
+        memcpy(&sum, reply_buf + pos, sizeof(sum));
+        memcpy(&value, replica_buf + pos, sizeof(value));
+        /* Memory is saturated by the driver, the sum is saturated too. */
+        sum = (sum + value < sum) ? ~static_cast<uint32_t>(0) : sum + value;
+        memcpy(reply_buf + pos, &sum, sizeof(sum));
+    }
+}
+
+
+/**
+ * Apply the same command to replicas.
+ * All workers are idle now.
+ *
+ * If a replica fails, its error replaces the reply of the primary driver
+ * in @a reply_result. Replicas are not in sync any more, so all next
+ * commands are handled by the primary driver.
+ *
+ * @a reply_buf is the preallocated buffer of @a reply_result.
+ */
+void
+Pipeline::replicate(const PipelineJob& job, ResultEncoder& reply_result,
+                    char* reply_buf)
+{
+    switch (job.command)
+    {
+        case Driver::OPEN:
+        case Driver::OPEN_PROG:
+        case Driver::OPEN_TCP:
+        {
+            /* The first parameter is a mode. */
+            ParamDecoder params(job.params, job.params_len);
+            const uint8_t mode = params;
+            if (mode != Driver::READ_OPEN)
+            {
+                m_is_read_only = false;
+                return;
+            }
+            break;
+        }
+
+        case Driver::SET_DEFAULT_STEMMER:
+        case Driver::SET_DEFAULT_PREFIXES:
+        case Driver::SHARD_SEARCH:
+        case Driver::QUERY_CACHE:
+        case Driver::MSET_CACHE:
+        case Driver::FILTER_CACHE:
+        case Driver::CLOSE:
+            break;
+
+        default:
+            return;
+    }
+
+    const unsigned counter_count = cacheCounterCount(job.command);
+
+    /* The arena is reset by handleSerial. */
+    char result_buf[PIPELINE_RESULT_BUF_LEN];
+    ResultEncoder result(m_arena, result_buf, PIPELINE_RESULT_BUF_LEN);
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        ParamDecoder params(job.params, job.params_len);
+        m_workers[i]->drv->handleCommand(params, result, job.command);
+        if (result_buf[0] != Driver::SUCCESS)
+        {
+            m_is_replica_failed = true;
+            reply_result.reset();
+            reply_result.append(result);
+            result.clear();
+            return;
+        }
+        addCacheCounters(reply_buf, result_buf, counter_count);
+        result.reset();
+    }
+}
+
+
+/**
+ * The result is encoded into the reply directly.
+ * Its segments are allocated by the upstream manager: the reply is 
+ * written and freed by the writer thread.
+ */
+PipelineReply
+Pipeline::createReply(const PipelineJob& job)
+{
+    PipelineReply rep;
+    rep.request_id = job.request_id;
+    rep.buf        = new char[PIPELINE_RESULT_BUF_LEN];
+    rep.result     = new ResultEncoder(m_mm, rep.buf, PIPELINE_RESULT_BUF_LEN);
+    return rep;
+}
+
+
+void
+Pipeline::destroyReply(PipelineReply& rep)
+{
+    rep.result->clear();
+    delete rep.result;
+    delete[] rep.buf;
+}
+
+
+void
+Pipeline::waitIdle()
+{
+    pthread_mutex_lock(&m_idle_lock);
+    while (m_in_flight != 0)
+        pthread_cond_wait(&m_idle, &m_idle_lock);
+    pthread_mutex_unlock(&m_idle_lock);
+}
+
+
+void
+Pipeline::jobDone()
+{
+    pthread_mutex_lock(&m_idle_lock);
+    if (--m_in_flight == 0)
+        pthread_cond_broadcast(&m_idle);
+    pthread_mutex_unlock(&m_idle_lock);
+}
+
+
+void*
+Pipeline::workerMain(void* e_worker)
+{
+    PipelineWorker& worker = * static_cast<PipelineWorker*>( e_worker );
+    Pipeline& pipeline = *worker.pipeline;
+    Driver& drv = *worker.drv;
+
+    PipelineJob job;
+    while (pipeline.m_jobs.pop(job))
+    {
+        PipelineReply rep = pipeline.createReply(job);
+        ResultEncoder& result = *rep.result;
+        ParamDecoder params(job.params, job.params_len);
+        drv.handleCommand(params, result, job.command);
+
+        /* A resource of the primary driver is required. */
+        if (drv.takeReplicaMiss())
+        {
+            result.reset();
+            pipeline.handleOnPrimary(job, result);
+        }
+
+        pipeline.m_replies.push(rep);
+        delete[] job.params;
+        pipeline.jobDone();
+    }
+    return NULL;
+}
+
+
+void*
+Pipeline::writerMain(void* e_pipeline)
+{
+    Pipeline& pipeline = * static_cast<Pipeline*>( e_pipeline );
+    try
+    {
+        pipeline.write();
+    } catch (std::ios_base::failure&)
+    {
+        /* The port is closed. The main thread will stop too. */
+    }
+    return NULL;
+}
+
+
+void
+Pipeline::write()
+{
+    PacketWriter output(STDOUT_FILENO);
+    std::vector<PipelineReply>          ready;
+    std::vector<const char*>            ids;
+    std::vector<const ResultEncoder*>   results;
+
+    PipelineReply rep;
+    while (m_replies.pop(rep))
+    {
+        /* All ready replies are written by one system call. */
+        ready.clear();
+        do
+            ready.push_back(rep);
+        while (m_replies.tryPop(rep));
+
+        ids.clear();
+        results.clear();
+        for (size_t i = 0; i < ready.size(); i++)
+        {
+            ids.push_back(
+                reinterpret_cast<const char*>( &ready[i].request_id ));
+            results.push_back(ready[i].result);
+        }
+
+        try
+        {
+            output.write(&ids[0], sizeof(uint32_t), &results[0], 
+                         results.size());
+        } catch (std::ios_base::failure&)
+        {
+            for (size_t i = 0; i < ready.size(); i++)
+                destroyReply(ready[i]);
+            throw;
+        }
+
+        for (size_t i = 0; i < ready.size(); i++)
+            destroyReply(ready[i]);
+    }
+}
+
+XAPIAN_ERLANG_NS_END
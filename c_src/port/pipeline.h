@@ -0,0 +1,242 @@
+#ifndef XAPIAN_PORT_PIPELINE_H
+#define XAPIAN_PORT_PIPELINE_H
+
+// External imports
+#include <deque>
+#include <vector>
+#include <stdint.h>
+#include <pthread.h>
+
+// Internal imports
+#include "xapian_config.h"
+#include "memory_manager.h"
+#include "thread_manager.h"
+#include "memory_arena.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+class Driver;
+class ResultEncoder;
+class Pipeline;
+
+
+// -------------------------------------------------------------------
+// Thread-safe FIFO
+// -------------------------------------------------------------------
+
+/**
+ * A queue, shared between threads.
+ * @ref pop blocks, while the queue is empty and open.
+ */
+template <class T>
+class BlockingQueue
+{
+    std::deque<T>   m_items;
+    pthread_mutex_t m_lock;
+    pthread_cond_t  m_not_empty;
+    bool            m_is_closed;
+
+    public:
+    BlockingQueue() : m_is_closed(false)
+    {
+        pthread_mutex_init(&m_lock, NULL);
+        pthread_cond_init(&m_not_empty, NULL);
+    }
+
+    ~BlockingQueue()
+    {
+        pthread_cond_destroy(&m_not_empty);
+        pthread_mutex_destroy(&m_lock);
+    }
+
+    void
+    push(const T& item)
+    {
+        pthread_mutex_lock(&m_lock);
+        m_items.push_back(item);
+        pthread_cond_signal(&m_not_empty);
+        pthread_mutex_unlock(&m_lock);
+    }
+
+    /**
+     * Returns false, if the queue is closed and empty.
+     */
+    bool
+    pop(T& item)
+    {
+        pthread_mutex_lock(&m_lock);
+        while (m_items.empty() && !m_is_closed)
+            pthread_cond_wait(&m_not_empty, &m_lock);
+        const bool is_found = !m_items.empty();
+        if (is_found)
+        {
+            item = m_items.front();
+            m_items.pop_front();
+        }
+        pthread_mutex_unlock(&m_lock);
+        return is_found;
+    }
+
+    /**
+     * Returns false immediately, if the queue is empty.
+     */
+    bool
+    tryPop(T& item)
+    {
+        pthread_mutex_lock(&m_lock);
+        const bool is_found = !m_items.empty();
+        if (is_found)
+        {
+            item = m_items.front();
+            m_items.pop_front();
+        }
+        pthread_mutex_unlock(&m_lock);
+        return is_found;
+    }
+
+    /**
+     * Wake up all waiting threads.
+     * Items, that are already in the queue, can still be popped.
+     */
+    void
+    close()
+    {
+        pthread_mutex_lock(&m_lock);
+        m_is_closed = true;
+        pthread_cond_broadcast(&m_not_empty);
+        pthread_mutex_unlock(&m_lock);
+    }
+};
+
+
+// -------------------------------------------------------------------
+// Pipeline
+// -------------------------------------------------------------------
+
+/**
+ * A request with its id.
+ * Packet format: RequestId:32, Command:32, Params.
+ */
+struct PipelineJob
+{
+    uint32_t    request_id;
+    uint32_t    command;
+    char*       params;
+    uint32_t    params_len;
+};
+
+
+/**
+ * A reply: RequestId:32, Result.
+ * The result is not merged, the writer thread writes its preallocated
+ * buffer and segments as they are and frees them.
+ */
+struct PipelineReply
+{
+    uint32_t        request_id;
+    char*           buf;
+    ResultEncoder*  result;
+};
+
+
+/**
+ * A thread with its own read-only copy of the driver.
+ */
+struct PipelineWorker
+{
+    Pipeline*   pipeline;
+    Driver*     drv;
+    pthread_t   thread;
+};
+
+
+/**
+ * Pipelined protocol.
+ *
+ * The main thread reads requests.
+ * Read-only commands are handled by the pool of workers concurrently.
+ * Each worker has its own Driver (and its own Xapian::Database handles).
+ * Other commands are handled by the primary driver in the main thread,
+ * after all running jobs are finished. Commands, which change defaults,
+ * settings of caches or open read-only databases, are repeated for 
+ * each worker. Cache counters in replies are summed over all drivers.
+ *
+ * Replies are written by the writer thread in the order of completion.
+ */
+class Pipeline
+{
+    MemoryManager&                  m_mm;
+    ThreadManager&                  m_tm;
+
+    /* Results of replicas (the main thread only).
+       Replies are allocated by m_mm, they are freed by the writer. */
+    ArenaMemoryManager              m_arena;
+
+    /* Owns resources and writable databases. */
+    Driver*                         m_primary;
+    pthread_mutex_t                 m_primary_lock;
+
+    std::vector<PipelineWorker*>    m_workers;
+    pthread_t                       m_writer;
+
+    BlockingQueue<PipelineJob>      m_jobs;
+    BlockingQueue<PipelineReply>    m_replies;
+
+    /* The count of jobs, that are queued or running. */
+    unsigned                        m_in_flight;
+    pthread_mutex_t                 m_idle_lock;
+    pthread_cond_t                  m_idle;
+
+    /* False, if a writable database was open.
+       Replicas cannot see uncommitted changes. */
+    bool                            m_is_read_only;
+
+    /* True, if a replica could not repeat a command of the primary 
+       driver. Workers are not used since then. */
+    bool                            m_is_replica_failed;
+
+    static void*
+    workerMain(void* worker);
+
+    static void*
+    writerMain(void* pipeline);
+
+    bool
+    isParallel(uint32_t command) const;
+
+    void
+    handleSerial(PipelineJob& job);
+
+    void
+    replicate(const PipelineJob& job, ResultEncoder& reply_result,
+              char* reply_buf);
+
+    void
+    handleOnPrimary(const PipelineJob& job, ResultEncoder& result);
+
+    PipelineReply
+    createReply(const PipelineJob& job);
+
+    static void
+    destroyReply(PipelineReply& rep);
+
+    void
+    waitIdle();
+
+    void
+    jobDone();
+
+    void
+    write();
+
+    public:
+    Pipeline(MemoryManager& mm, ThreadManager& tm, unsigned worker_count);
+    ~Pipeline();
+
+    /**
+     * Read and dispatch requests until the input is closed.
+     */
+    void run();
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
@@ -0,0 +1,251 @@
+/* vim: set filetype=cpp shiftwidth=4 tabstop=4 expandtab tw=80: */
+
+#include <ios>
+#include <new>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <unistd.h>
+
+#include "port_io.h"
+#include "result_encoder.h"
+
+XAPIAN_ERLANG_NS_BEGIN
+
+/* The initial size of the input buffer. */
+#define INPUT_BUF_LEN 4096
+
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+
+
+int is_big_endian()
+{
+    union {
+        uint32_t i;
+        char c[4];
+    } bint = {0x01020304};
+
+    return bint.c[0] == 1; 
+}
+
+
+uint32_t swapByteOrder(uint32_t ui)
+{
+    ui = (ui >> 24) |
+         ((ui<<8) & 0x00FF0000) |
+         ((ui>>8) & 0x0000FF00) |
+         (ui << 24);
+    return ui;
+}
+
+
+static uint32_t 
+to_network_order(uint32_t len)
+{
+    return is_big_endian() ? len : swapByteOrder(len);
+}
+
+
+// -------------------------------------------------------------------
+// PacketReader
+// -------------------------------------------------------------------
+
+PacketReader::PacketReader(int fd)
+    : m_fd(fd), m_capacity(INPUT_BUF_LEN), m_begin(0), m_end(0)
+{
+    m_buf = static_cast<char*>( malloc(m_capacity) );
+    if (m_buf == NULL)
+        throw std::bad_alloc();
+}
+
+
+PacketReader::~PacketReader()
+{
+    free(m_buf);
+}
+
+
+void
+PacketReader::fill(size_t need)
+{
+    if (m_end - m_begin >= need)
+        return;
+
+    if (m_capacity - m_begin < need)
+    {
+        /* Move the unprocessed tail to the beginning. */
+        const size_t buffered = m_end - m_begin;
+        memmove(m_buf, m_buf + m_begin, buffered);
+        m_begin = 0;
+        m_end = buffered;
+
+        if (m_capacity < need)
+        {
+            /* Room for the next packet of the same size, so one read
+               can fetch the rest of this packet and the next header. */
+            size_t new_capacity = m_capacity * 2;
+            if (new_capacity < need * 2)
+                new_capacity = need * 2;
+            char* new_buf = static_cast<char*>( realloc(m_buf, new_capacity) );
+            if (new_buf == NULL)
+                throw std::bad_alloc();
+            m_buf = new_buf;
+            m_capacity = new_capacity;
+        }
+    }
+
+    while (m_end - m_begin < need)
+    {
+        const ssize_t n = ::read(m_fd, m_buf + m_end, m_capacity - m_end);
+        if (n > 0)
+            m_end += static_cast<size_t>(n);
+        else if (n == 0)
+            throw std::ios_base::failure("The input is closed.");
+        else if (errno != EINTR)
+            throw std::ios_base::failure("Cannot read the input.");
+    }
+}
+
+
+char*
+PacketReader::next(uint32_t& len)
+{
+    fill(sizeof(len));
+    memcpy(&len, m_buf + m_begin, sizeof(len));
+    len = to_network_order(len);
+    m_begin += sizeof(len);
+
+    fill(len);
+    char* packet = m_buf + m_begin;
+    m_begin += len;
+    return packet;
+}
+
+
+// -------------------------------------------------------------------
+// PacketWriter
+// -------------------------------------------------------------------
+
+/**
+ * Appends chunks of the result to the I/O vector.
+ */
+class IOVecAppender : public ResultVisitor
+{
+    std::vector<struct iovec>& m_iov;
+
+    public:
+    IOVecAppender(std::vector<struct iovec>& iov) : m_iov(iov) {}
+
+    void 
+    visit(void* /* block */, const char* data, size_t len)
+    {
+        if (len == 0)
+            return;
+        struct iovec chunk;
+        chunk.iov_base = const_cast<char*>( data );
+        chunk.iov_len  = len;
+        m_iov.push_back(chunk);
+    }
+};
+
+
+PacketWriter::PacketWriter(int fd) : m_fd(fd)
+{}
+
+
+void
+PacketWriter::write(const char* prefix, uint32_t prefix_len, 
+                    const ResultEncoder& result)
+{
+    const ResultEncoder* p_result = &result;
+    write(&prefix, prefix_len, &p_result, 1);
+}
+
+
+void
+PacketWriter::write(const char* const* prefixes, uint32_t prefix_len, 
+                    const ResultEncoder* const* results, size_t count)
+{
+    /* Headers must not be moved, while m_iov points on them. */
+    m_headers.resize(count);
+    m_iov.clear();
+    IOVecAppender appender(m_iov);
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t result_len = results[i]->finalSize();
+        m_headers[i] = to_network_order(
+            static_cast<uint32_t>( prefix_len + result_len ));
+
+        struct iovec chunk;
+        chunk.iov_base = &m_headers[i];
+        chunk.iov_len  = sizeof(uint32_t);
+        m_iov.push_back(chunk);
+
+        if (prefix_len != 0)
+        {
+            chunk.iov_base = const_cast<char*>( prefixes[i] );
+            chunk.iov_len  = prefix_len;
+            m_iov.push_back(chunk);
+        }
+
+        results[i]->visit(appender);
+    }
+    writeAll();
+}
+
+
+void
+PacketWriter::writeEmpty()
+{
+    m_headers.resize(1);
+    m_headers[0] = 0;
+
+    m_iov.clear();
+    struct iovec chunk;
+    chunk.iov_base = &m_headers[0];
+    chunk.iov_len  = sizeof(uint32_t);
+    m_iov.push_back(chunk);
+    writeAll();
+}
+
+
+/**
+ * Write m_iov, continue after partial writes.
+ */
+void
+PacketWriter::writeAll()
+{
+    struct iovec* iov = &m_iov[0];
+    size_t left = m_iov.size();
+
+    while (left != 0)
+    {
+        const int count = static_cast<int>( left < IOV_MAX ? left : IOV_MAX );
+        ssize_t n = ::writev(m_fd, iov, count);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::ios_base::failure("Cannot write the output.");
+        }
+
+        /* Skip written chunks. */
+        size_t written = static_cast<size_t>(n);
+        while (left != 0 && written >= iov->iov_len)
+        {
+            written -= iov->iov_len;
+            iov++;
+            left--;
+        }
+        if (left != 0)
+        {
+            iov->iov_base = static_cast<char*>( iov->iov_base ) + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+XAPIAN_ERLANG_NS_END
@@ -0,0 +1,104 @@
+#ifndef XAPIAN_PORT_IO_H
+#define XAPIAN_PORT_IO_H
+
+// External imports
+#include <vector>
+#include <stdint.h>
+#include <sys/uio.h>
+
+// Internal imports
+#include "xapian_config.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+class ResultEncoder;
+
+/* Packets consist of a header specifying the number of bytes in the 
+   packet, followed by that number of bytes. The length of header can 
+   be one, two, or four bytes; the order of the bytes is big-endian. 
+   The header will be stripped off when the packet is returned.
+*/
+
+int is_big_endian();
+
+/**
+ * Reverse bytes in the unsigned integer.
+ */
+uint32_t swapByteOrder(uint32_t ui);
+
+
+/**
+ * Reads packets with read(2).
+ * The buffer is reused between packets. It grows, if a packet is larger.
+ * Few small packets can be read by one system call.
+ *
+ * Throws std::ios_base::failure, when the input is closed.
+ */
+class PacketReader
+{
+    int     m_fd;
+    char*   m_buf;
+    size_t  m_capacity;
+
+    /* Unprocessed data is between m_begin and m_end. */
+    size_t  m_begin;
+    size_t  m_end;
+
+    /**
+     * Read, until at least @a need bytes are buffered.
+     */
+    void fill(size_t need);
+
+    public:
+    PacketReader(int fd);
+    ~PacketReader();
+
+    /**
+     * Returns a pointer on the body of the next packet.
+     * The pointer is valid until the next call.
+     */
+    char* next(uint32_t& len);
+};
+
+
+/**
+ * Writes packets with writev(2).
+ * The length header and all chunks of the result are written by one 
+ * system call without merging.
+ *
+ * Throws std::ios_base::failure, when the output is closed.
+ */
+class PacketWriter
+{
+    int                         m_fd;
+
+    /* They are reused between packets. */
+    std::vector<struct iovec>   m_iov;
+    std::vector<uint32_t>       m_headers;
+
+    void writeAll();
+
+    public:
+    PacketWriter(int fd);
+
+    /**
+     * Write a packet: Header, Prefix, Result.
+     * @a prefix can be NULL.
+     */
+    void write(const char* prefix, uint32_t prefix_len, 
+               const ResultEncoder& result);
+
+    /**
+     * Write few packets at once, each is Header, Prefix, Result.
+     * All prefixes are @a prefix_len bytes long.
+     */
+    void write(const char* const* prefixes, uint32_t prefix_len, 
+               const ResultEncoder* const* results, size_t count);
+
+    /**
+     * Write a packet with the zero length.
+     */
+    void writeEmpty();
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
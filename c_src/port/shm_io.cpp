@@ -0,0 +1,49 @@
+/* vim: set filetype=cpp shiftwidth=4 tabstop=4 expandtab tw=80: */
+
+#include <ios>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm_io.h"
+
+XAPIAN_ERLANG_NS_BEGIN
+
+SharedRings::SharedRings(const char* path)
+{
+    const int fd = ::open(path, O_RDWR);
+    if (fd < 0)
+        throw std::ios_base::failure("Cannot open the shared memory.");
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        throw std::ios_base::failure("Cannot open the shared memory.");
+    }
+    m_size = static_cast<size_t>( info.st_size );
+
+    void* base = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    /* The mapping stays valid after closing. */
+    ::close(fd);
+    if (base == MAP_FAILED)
+        throw std::ios_base::failure("Cannot map the shared memory.");
+
+    /* Rings are already initialized by the creator. */
+    m_base = static_cast<char*>( base );
+    if (m_size < 2 * sizeof(RingHeader))
+        throw std::ios_base::failure("The shared memory is too small.");
+    char* pos = m_requests.attach(m_base);
+    if (pos + sizeof(RingHeader) > m_base + m_size
+     || m_replies.attach(pos) > m_base + m_size)
+        throw std::ios_base::failure("The shared memory is too small.");
+}
+
+
+SharedRings::~SharedRings()
+{
+    munmap(m_base, m_size);
+}
+
+XAPIAN_ERLANG_NS_END
@@ -0,0 +1,37 @@
+#ifndef XAPIAN_PORT_SHM_IO_H
+#define XAPIAN_PORT_SHM_IO_H
+
+// External imports
+#include <cstddef>
+
+// Internal imports
+#include "xapian_config.h"
+#include "ring_buffer.h"
+XAPIAN_ERLANG_NS_BEGIN
+
+/**
+ * A pair of rings in a memory-mapped file, created by `xapian_shm'.
+ * Layout: RequestRing, ReplyRing.
+ *
+ * Throws std::ios_base::failure, if the file cannot be mapped.
+ */
+class SharedRings
+{
+    char*       m_base;
+    size_t      m_size;
+    RingBuffer  m_requests;
+    RingBuffer  m_replies;
+
+    public:
+    SharedRings(const char* path);
+    ~SharedRings();
+
+    /* Erlang writes, the port reads. */
+    RingBuffer& requests() { return m_requests; }
+
+    /* The port writes, Erlang reads. */
+    RingBuffer& replies()  { return m_replies; }
+};
+
+XAPIAN_ERLANG_NS_END
+#endif
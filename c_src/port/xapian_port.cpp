@@ -1,11 +1,19 @@
-#include <iostream>
+#include <ios>
+#include <cstdlib>
+#include <cstring>
 #include <stdint.h>
 #include <assert.h>
+#include <unistd.h>
 
 #include "xapian_core.h"
 #include "memory_manager.h"
+#include "thread_manager.h"
+#include "memory_arena.h"
 #include "param_decoder.h"
 #include "result_encoder.h"
+#include "port_io.h"
+#include "pipeline.h"
+#include "shm_io.h"
 
 
 // -------------------------------------------------------------------
@@ -14,123 +22,154 @@
 
 XAPIAN_ERLANG_NS_BEGIN
 
-/* Packets consist of a header specifying the number of bytes in the 
-   packet, followed by that number of bytes. The length of header can 
-   be one, two, or four bytes; the order of the bytes is big-endian. 
-   The header will be stripped off when the packet is returned.
-*/
-
-int is_big_endian()
-{
-    union {
-        uint32_t i;
-        char c[4];
-    } bint = {0x01020304};
-
-    return bint.c[0] == 1; 
-}
-
-
 /**
- * Reverse bytes in the unsigned integer.
+ * Create global variables
  */
-uint32_t swapByteOrder(uint32_t ui)
+void run()
 {
-    ui = (ui >> 24) |
-         ((ui<<8) & 0x00FF0000) |
-         ((ui>>8) & 0x0000FF00) |
-         (ui << 24);
-    return ui;
-}
+    MemoryManager mm;
+    ThreadManager tm;
+    Driver drv(mm, tm);
+    // Segments of the result live until the reply is written.
+    ArenaMemoryManager arena(mm);
+    ResultEncoder result(arena);
+    PacketReader input(STDIN_FILENO);
+    PacketWriter output(STDOUT_FILENO);
 
-uint32_t read_packet_length(std::istream& s)
-{
-    uint32_t len;
-    s.read(reinterpret_cast<char*>(&len), sizeof(len));
-    if (!is_big_endian()) 
-        len = swapByteOrder(len);
-    return len;
-}
+    // Place to collect result, can be extended
+    const size_t result_buf_len = 1024;
+    char result_buf[1024];
 
-std::ostream&  write_packet_length(std::ostream& s, uint32_t len)
-{
-    if (!is_big_endian()) 
-        len = swapByteOrder(len);
-    s.write(reinterpret_cast<char*>(&len), sizeof(len));
-    return s;
-}
+    while(true)
+    {
+        // The packet stays in the input buffer until the next call.
+        uint32_t len;
+        char* buf = input.next(len);
+        
+        // Handle a command
+        ParamDecoder params(buf, len); 
+        result.setBuffer(result_buf, result_buf_len);
+        const uint32_t command = params;
+        drv.handleCommand(params, result, command);
 
+        // The header, the preallocated buffer and all extended segments 
+        // are written without merging.
+        output.write(NULL, 0, result);
 
+        // Free memory, if it was allocated by ResultEncoder.
+        result.clear();
+        arena.reset();
+    }
+}
 
 /**
- * Create global variables
+ * Requests and replies are passed through the shared rings.
+ * An empty packet in the pipe is a doorbell: the message is in the ring.
+ * A non-empty packet is an ordinary request or reply. It is used, 
+ * when the message does not fit into the ring.
  */
-void run()
+void run_shm(const char* path)
 {
     MemoryManager mm;
-    Driver drv(mm);
-    ResultEncoder result(mm);
-
-    // Place to collect result, can be extended
+    ThreadManager tm;
+    Driver drv(mm, tm);
+    // Segments of the result live until the reply is written.
+    ArenaMemoryManager arena(mm);
+    ResultEncoder result(arena);
+    PacketReader input(STDIN_FILENO);
+    PacketWriter output(STDOUT_FILENO);
+    SharedRings rings(path);
+    RingBuffer& requests = rings.requests();
+    RingBuffer& replies  = rings.replies();
+
+    // Used, if the reply ring is full
     const size_t result_buf_len = 1024;
     char result_buf[1024];
 
-    // Read buffer's length
     while(true)
     {
-        // read len, 4 bytes
-        const uint32_t len = read_packet_length(std::cin);
+        uint32_t len;
+        char* buf = input.next(len);
+        const bool is_ring_request = (len == 0);
+        if (is_ring_request)
+        {
+            buf = requests.peek(len);
+            if (buf == NULL)
+                throw std::ios_base::failure("The request ring is empty.");
+        }
 
-        // read data, len bytes
-        char* buf = new char[len];
-        std::cin.read(buf, len);
-        
-        // Handle a command
+        // The result is encoded directly into the reply ring.
+        uint32_t ring_len;
+        char* ring_buf = replies.reserve(ring_len);
+        if (ring_buf != NULL)
+            result.setBuffer(ring_buf, ring_len);
+        else
+            result.setBuffer(result_buf, result_buf_len);
+
+        // Params are decoded in place
         ParamDecoder params(buf, len); 
-        result.setBuffer(result_buf, result_buf_len);
         const uint32_t command = params;
         drv.handleCommand(params, result, command);
-        delete[] buf;
 
-        /* The real length of data */
-        const uint32_t result_len = static_cast<uint32_t>( result.finalSize() );
+        if (is_ring_request)
+            requests.release();
 
-        write_packet_length(std::cout, result_len);
-        /* It is too long */
-        if (result.isExtended())
+        if (ring_buf != NULL && !result.isExtended())
         {
-            // Copy few segments into one large buffer
-            char* large_buf = new char[result_len];
-            result.finalize(large_buf);
-            std::cout.write(large_buf, result_len);
-            delete[] large_buf;
-        } else {
-            // Result is in the preallocated memory space.
-            std::cout.write(result_buf, result_len);
+            replies.commit(static_cast<uint32_t>( result.finalSize() ));
+            output.writeEmpty();
         }
+        else
+            // Fallback: the default framing.
+            output.write(NULL, 0, result);
 
-        std::cout.flush();
-
-        // Free memory, if it was allocated by ResultEncoder.
         result.clear();
+        arena.reset();
     }
 }
 
+/**
+ * Handle requests concurrently.
+ * @see Pipeline
+ */
+void run_pipeline(unsigned worker_count)
+{
+    MemoryManager mm;
+    ThreadManager tm;
+    Pipeline pipeline(mm, tm, worker_count);
+    pipeline.run();
+}
+
 XAPIAN_ERLANG_NS_END
 
 
-int main(void)
+/**
+ * Arguments:
+ * `--pipeline [WorkerCount]' - each request has an id, requests are handled
+ * by a pool of threads, replies can be out of order.
+ * `--shm Path' - messages are passed through the shared memory file.
+ */
+int main(int argc, char* argv[])
 {
-    std::cin.exceptions  ( std::istream::failbit | std::istream::badbit );
-    std::cout.exceptions ( std::ostream::failbit | std::ostream::badbit );
+    const bool is_pipeline = (argc > 1) && (strcmp(argv[1], "--pipeline") == 0);
+    const bool is_shm = (argc > 2) && (strcmp(argv[1], "--shm") == 0);
+    long worker_count = (is_pipeline && argc > 2) ? atol(argv[2]) : 0;
+    if (worker_count <= 0)
+        worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (worker_count <= 0)
+        worker_count = 1;
 
     try
     {
-        XapianErlang::run();
-    } catch (std::ios_base::failure e)
+        if (is_pipeline)
+            XapianErlang::run_pipeline(static_cast<unsigned>(worker_count));
+        else if (is_shm)
+            XapianErlang::run_shm(argv[2]);
+        else
+            XapianErlang::run();
+    } catch (std::ios_base::failure& e)
     {
 //      std::cerr << "Caught an exception: " << e.what() << std::endl;
-//      std::cout.flush();
         return 1;
     }
     return 0;
@@ -0,0 +1,223 @@
+/* vim: set filetype=cpp shiftwidth=4 tabstop=4 expandtab tw=80: */
+
+/**
+ * The Erlang side of the shared memory transport.
+ * It creates the rings and copies messages in and out.
+ * It does not depend on Xapian.
+ */
+
+// -------------------------------------------------------------------
+// Includes
+// -------------------------------------------------------------------
+
+#include "erl_nif.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "ring_buffer.h"
+
+XAPIAN_ERLANG_NS_BEGIN
+
+/* The longest path of the shared memory file. */
+#define SHM_PATH_LEN 4096
+
+
+/**
+ * A resource object. 
+ * It is used only by the owner of the port, so it is not locked.
+ */
+struct SharedRingsRes
+{
+    /* NULL, if the rings were closed. */
+    char*       base;
+    size_t      size;
+    RingBuffer  requests;
+    RingBuffer  replies;
+    char        path[SHM_PATH_LEN];
+};
+
+static ErlNifResourceType* gp_shmType = NULL;
+
+
+static void
+unmap(SharedRingsRes* res)
+{
+    if (res->base == NULL)
+        return;
+    munmap(res->base, res->size);
+    unlink(res->path);
+    res->base = NULL;
+}
+
+
+static void
+destroy(ErlNifEnv* /* env */, void* obj)
+{
+    unmap(static_cast<SharedRingsRes*>( obj ));
+}
+
+
+static SharedRingsRes*
+get_rings(ErlNifEnv* env, ERL_NIF_TERM term)
+{
+    void* obj;
+    if (!enif_get_resource(env, term, gp_shmType, &obj))
+        return NULL;
+    SharedRingsRes* res = static_cast<SharedRingsRes*>( obj );
+    return res->base == NULL ? NULL : res;
+}
+
+
+static ERL_NIF_TERM
+make_error(ErlNifEnv* env, const char* reason)
+{
+    return enif_make_tuple2(env, 
+        enif_make_atom(env, "error"), enif_make_atom(env, reason));
+}
+
+
+static int 
+load(ErlNifEnv* env, void** /* priv_data */, ERL_NIF_TERM /* load_info */)
+{
+    ErlNifResourceFlags flags = 
+        static_cast<ErlNifResourceFlags>(ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER);
+    gp_shmType = enif_open_resource_type(env, NULL, "xapian_shm", 
+        &destroy, flags, NULL);
+    return gp_shmType == NULL ? -1 : 0;
+}
+
+
+/**
+ * (Path, Capacity) -> {ok, Rings} | {error, Reason}
+ * Create the file with two rings of @a Capacity bytes each.
+ */
+static ERL_NIF_TERM 
+create(ErlNifEnv* env, int /* argc */, const ERL_NIF_TERM argv[])
+{
+    ErlNifBinary path;
+    unsigned int capacity;
+    if (!enif_inspect_iolist_as_binary(env, argv[0], &path)
+     || path.size >= SHM_PATH_LEN
+     || !enif_get_uint(env, argv[1], &capacity)
+     || capacity == 0)
+        return enif_make_badarg(env);
+
+    SharedRingsRes* res = static_cast<SharedRingsRes*>( 
+        enif_alloc_resource(gp_shmType, sizeof(SharedRingsRes)) );
+    res->base = NULL;
+    memcpy(res->path, path.data, path.size);
+    res->path[path.size] = '\0';
+    ERL_NIF_TERM term = enif_make_resource(env, res);
+    enif_release_resource(res);
+
+    const size_t ring_size = RingBuffer::mappingSize(capacity);
+    res->size = 2 * ring_size;
+
+    const int fd = open(res->path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return make_error(env, "cannot_create");
+
+    if (ftruncate(fd, static_cast<off_t>( res->size )) != 0)
+    {
+        close(fd);
+        unlink(res->path);
+        return make_error(env, "cannot_resize");
+    }
+
+    void* base = mmap(NULL, res->size, PROT_READ | PROT_WRITE, 
+                      MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        unlink(res->path);
+        return make_error(env, "cannot_map");
+    }
+
+    res->base = static_cast<char*>( base );
+    char* pos = res->requests.attach(res->base, capacity);
+    res->replies.attach(pos, capacity);
+    return enif_make_tuple2(env, enif_make_atom(env, "ok"), term);
+}
+
+
+/**
+ * (Rings, Command, Params) -> boolean()
+ * Copy a request into the ring. Returns false, if it does not fit.
+ */
+static ERL_NIF_TERM 
+write_request(ErlNifEnv* env, int /* argc */, const ERL_NIF_TERM argv[])
+{
+    SharedRingsRes* res = get_rings(env, argv[0]);
+    unsigned int command;
+    ErlNifBinary data;
+    if (res == NULL
+     || !enif_get_uint(env, argv[1], &command)
+     || !enif_inspect_binary(env, argv[2], &data))
+        return enif_make_badarg(env);
+
+    const uint32_t prefix = command;
+    const bool is_written = res->requests.write(
+        reinterpret_cast<const char*>( &prefix ), sizeof(prefix),
+        reinterpret_cast<const char*>( data.data ), 
+        static_cast<uint32_t>( data.size ));
+    return enif_make_atom(env, is_written ? "true" : "false");
+}
+
+
+/**
+ * (Rings) -> binary()
+ * Copy the oldest reply out of the ring and free its space.
+ */
+static ERL_NIF_TERM 
+read_reply(ErlNifEnv* env, int /* argc */, const ERL_NIF_TERM argv[])
+{
+    SharedRingsRes* res = get_rings(env, argv[0]);
+    if (res == NULL)
+        return enif_make_badarg(env);
+
+    uint32_t len;
+    const char* src = res->replies.peek(len);
+    if (src == NULL)
+        return enif_make_badarg(env);
+
+    ERL_NIF_TERM term;
+    unsigned char* dest = enif_make_new_binary(env, len, &term);
+    memcpy(dest, src, len);
+    res->replies.release();
+    return term;
+}
+
+
+/**
+ * (Rings) -> ok
+ * Unmap and delete the file.
+ */
+static ERL_NIF_TERM 
+close_rings(ErlNifEnv* env, int /* argc */, const ERL_NIF_TERM argv[])
+{
+    void* obj;
+    if (!enif_get_resource(env, argv[0], gp_shmType, &obj))
+        return enif_make_badarg(env);
+    unmap(static_cast<SharedRingsRes*>( obj ));
+    return enif_make_atom(env, "ok");
+}
+
+XAPIAN_ERLANG_NS_END
+
+
+// -------------------------------------------------------------------
+// Meta information for Erlang
+// -------------------------------------------------------------------
+
+static ErlNifFunc xapian_shm_funcs[] = {
+    {"create",        2, XapianErlang::create,        0},
+    {"write_request", 3, XapianErlang::write_request, 0},
+    {"read_reply",    1, XapianErlang::read_reply,    0},
+    {"close",         1, XapianErlang::close_rings,   0}
+};
+
+ERL_NIF_INIT(xapian_shm, xapian_shm_funcs, 
+             XapianErlang::load, NULL, NULL, NULL)
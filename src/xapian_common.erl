@@ -23,7 +23,8 @@
          append_boolean/2,
          append_binary/2,
          append_weight/2,
-         append_percent/2
+         append_percent/2,
+         append_timeout/2
         ]).
 
 %% Advanced decoding functions
@@ -45,6 +46,17 @@
          read_slot_and_values/1
         ]).
 
+%% Compact decoding functions (see `FieldEncoder')
+-export([read_varint/1,
+         read_compact_string/1,
+         read_compact_document_id/1,
+         read_compact_position_list/1,
+         read_compact_unknown_type_value/1,
+         read_compact_strings/1,
+         read_compact_strings_and_positions/1,
+         read_compact_slot_and_values/1
+        ]).
+
 %% Advanced encoding functions
 -export([append_document_id/2,
          append_docids/2,
@@ -414,6 +426,17 @@ read_percent(Bin) ->
 append_percent(Value, Bin) ->
     append_uint8(Value, Bin).
 
+%% @doc Encode a time budget in milliseconds (uint32_t).
+%% 0 means "no limit", so the zero timeout is rounded up.
+append_timeout(infinity, Bin) ->
+    append_uint(0, Bin);
+
+append_timeout(undefined, Bin) ->
+    append_uint(0, Bin);
+
+append_timeout(Timeout, Bin) when is_integer(Timeout), Timeout >= 0 ->
+    append_uint(max(Timeout, 1), Bin).
+
 %% @doc Read a document count (uint32_t).
 read_doccount(Bin) ->
     read_uint(Bin).
@@ -483,6 +506,19 @@ index_one_of_test_() ->
     , ?_assertEqual(index_one_of([x], [a,b,c]), not_found)
     ].
 
+read_varint_test_() ->
+    [ ?_assertEqual(read_varint(<<0, 1>>), {0, <<1>>})
+    , ?_assertEqual(read_varint(<<127>>), {127, <<>>})
+    , ?_assertEqual(read_varint(<<128, 1>>), {128, <<>>})
+    , ?_assertEqual(read_varint(<<255, 255, 255, 255, 15>>), {16#FFFFFFFF, <<>>})
+    ].
+
+read_compact_position_list_test_() ->
+    [ ?_assertEqual(read_compact_position_list(<<3, 1, 1, 200, 1>>), 
+                    {[1, 2, 202], <<>>})
+    , ?_assertEqual(read_compact_position_list(<<0>>), {[], <<>>})
+    ].
+
 -endif.
 
 
@@ -575,6 +611,100 @@ read_unknown_type_value(Bin1) ->
     read_value(xapian_const:value_type_name(Type), Bin2).
 
 
+%% ------------------------------------------------------------------
+%% Compact encoding
+%% ------------------------------------------------------------------
+
+%% @doc Read an unsigned LEB128 varint.
+%% 7 bits per byte, the high bit is set, if more bytes follow.
+read_varint(Bin) ->
+    read_varint(Bin, 0, 0).
+
+read_varint(<<1:1, Low:7, Bin/binary>>, Shift, Acc) ->
+    read_varint(Bin, Shift + 7, Acc bor (Low bsl Shift));
+
+read_varint(<<0:1, Low:7, Bin/binary>>, Shift, Acc) ->
+    {Acc bor (Low bsl Shift), Bin}.
+
+
+%% @doc Read a string with a varint length.
+read_compact_string(Bin) ->
+    {Num, Bin2} = read_varint(Bin),
+    <<Str:Num/binary, Bin3/binary>> = Bin2,
+    {Str, Bin3}.
+
+
+read_compact_document_id(Bin) ->
+    case read_varint(Bin) of
+        {0, Bin1} -> {undefined, Bin1};
+        Other -> Other
+    end.
+
+
+%% @doc Read a delta-coded list of positions.
+read_compact_position_list(Bin@) ->
+    {Count, Bin@} = read_varint(Bin@),
+    read_compact_position_list(Count, 0, [], Bin@).
+
+
+read_compact_position_list(Count, Prev, Acc, Bin@) when Count > 0 ->
+    {Delta, Bin@} = read_varint(Bin@),
+    Pos = Prev + Delta,
+    read_compact_position_list(Count - 1, Pos, [Pos|Acc], Bin@);
+
+read_compact_position_list(0, _Prev, Acc, Bin@) ->
+    {lists:reverse(Acc), Bin@}.
+
+
+%% @doc Only the length of a string is compact, doubles are not changed.
+read_compact_unknown_type_value(Bin1) ->
+    {Type, Bin2} = read_uint8(Bin1), 
+    case xapian_const:value_type_name(Type) of
+        string -> 
+            case read_compact_string(Bin2) of
+                {<<>>, Bin3} -> {undefined, Bin3};
+                Other -> Other
+            end;
+        double -> 
+            save_read_double(Bin2)
+    end.
+
+
+read_compact_strings(Bin@) ->
+    {Size, Bin@} = read_varint(Bin@),
+    read_compact_strings(Size, Bin@, []).
+
+read_compact_strings(0, Bin, Acc) ->
+    {lists:reverse(Acc), Bin};
+read_compact_strings(N, Bin@, Acc) when N > 0 ->
+    {Str, Bin@} = read_compact_string(Bin@),
+    read_compact_strings(N-1, Bin@, [Str|Acc]).
+
+
+read_compact_strings_and_positions(Bin@) ->
+    {Size, Bin@} = read_varint(Bin@),
+    read_compact_strings_and_positions(Size, Bin@, []).
+
+read_compact_strings_and_positions(0, Bin, Acc) ->
+    {lists:reverse(Acc), Bin};
+read_compact_strings_and_positions(N, Bin@, Acc) when N > 0 ->
+    {Str, Bin@} = read_compact_string(Bin@),
+    {Pos, Bin@} = read_compact_position_list(Bin@),
+    read_compact_strings_and_positions(N-1, Bin@, [{Str, Pos}|Acc]).
+
+
+read_compact_slot_and_values(Bin@) ->
+    {Size, Bin@} = read_varint(Bin@),
+    read_compact_slot_and_values(Size, Bin@, []).
+
+read_compact_slot_and_values(0, Bin, Acc) ->
+    {lists:reverse(Acc), Bin};
+read_compact_slot_and_values(N, Bin@, Acc) when N > 0 ->
+    {Slot, Bin@} = read_varint(Bin@),
+    {Value, Bin@} = read_compact_string(Bin@),
+    read_compact_slot_and_values(N-1, Bin@, [{Slot, Value}|Acc]).
+
+
 %% It is a black box.
 -type x_resource_appender() :: {xapian_type:x_state(), pid()}.
 
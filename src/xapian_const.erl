@@ -83,7 +83,15 @@ command_id(add_synonym)                 -> 39;
 command_id(remove_synonym)              -> 40;
 command_id(clear_synonyms)              -> 41;
 command_id(create_term_generator)       -> 42;
-command_id(get_spelling_suggestion)     -> 43.
+command_id(get_spelling_suggestion)     -> 43;
+command_id(batch)                       -> 44;
+command_id(resource_limits)             -> 45;
+command_id(resource_info)               -> 46;
+command_id(query_cache)                 -> 47;
+command_id(mset_cache)                  -> 48;
+command_id(shard_search)                -> 49;
+command_id(count)                       -> 50;
+command_id(filter_cache)                -> 51.
 
 
 %% Open modes of the DB
@@ -105,7 +113,9 @@ qlc_type_id(database_terms)       -> 4.
 test_id(result_encoder) -> 1;
 test_id(exception)      -> 2;
 test_id(echo)           -> 3;
-test_id(memory)         -> 4.
+test_id(memory)         -> 4;
+test_id(result_growth)  -> 5;
+test_id(expired_deadline) -> 6.
 
 
 %% ------------------------------------------------------------
@@ -366,7 +376,9 @@ mset_info_param_id(size)                            -> 7;
 mset_info_param_id(max_possible)                    -> 8;
 mset_info_param_id(max_attained)                    -> 9;
 mset_info_param_id(term_weight)                     -> 10;
-mset_info_param_id(term_freq)                       -> 11.
+mset_info_param_id(term_freq)                       -> 11;
+mset_info_param_id(is_truncated)                    -> 12;
+mset_info_param_id(cursor)                          -> 13.
 
 spy_info_param_id(stop)                             -> 0;
 spy_info_param_id(document_count)                   -> 1;
@@ -383,7 +395,8 @@ enquire_command_id(order)                    -> 3;
 enquire_command_id(docid_order)              -> 4;
 enquire_command_id(weighting_scheme)         -> 5;
 enquire_command_id(cutoff)                   -> 6;
-enquire_command_id(collapse_key)             -> 7.
+enquire_command_id(collapse_key)             -> 7;
+enquire_command_id(timeout)                  -> 8.
 
 
 -spec order_type_id(xapian_type:x_order_type()) -> non_neg_integer().
@@ -431,7 +444,9 @@ term_field_id(wdf)             -> 2;
 term_field_id(freq)            -> 3;
 term_field_id(positions)       -> 4;
 term_field_id(position_count)  -> 5;
-term_field_id(float_value)     -> 6.
+term_field_id(float_value)     -> 6;
+%% Not a field: next fields are encoded compactly.
+term_field_id(compact)         -> 7.
 
    
 %% used with a record
@@ -451,7 +466,9 @@ document_field_id(collapse_key)   -> 10;
 document_field_id(collapse_count) -> 11;
 document_field_id(all_terms)      -> 12;
 document_field_id(all_values)     -> 13;
-document_field_id(all_terms_pos)  -> 14.
+document_field_id(all_terms_pos)  -> 14;
+%% Not a field: next fields are encoded compactly.
+document_field_id(compact)        -> 15.
 
 
 resource_encoding_schema_id(reference)    -> 56;
@@ -11,7 +11,8 @@
     append_slot/3,
     append_boolean/2,
     append_percent/2,
-    append_weight/2]).
+    append_weight/2,
+    append_timeout/2]).
 
 -import(xapian_const, [
     sort_order_value_type/1,
@@ -33,7 +34,8 @@ encode(Enquire=#x_enquire{}, N2S, S2T, RA, Bin@) ->
         percent_cutoff = PercentCutoff,
         weight_cutoff = WeightCuttoff,
         collapse_key = CollapseKey,
-        collapse_max = CollapseMax
+        collapse_max = CollapseMax,
+        timeout = Timeout
     } = Enquire,
     Bin@ = append_query_len(QueryLen, Bin@),
     Bin@ = append_query(Query, N2S, S2T, RA, Bin@),
@@ -42,6 +44,7 @@ encode(Enquire=#x_enquire{}, N2S, S2T, RA, Bin@) ->
     Bin@ = append_weighting_scheme(Weight, RA, Bin@),
     Bin@ = append_cutoff(PercentCutoff, WeightCuttoff, Bin@),
     Bin@ = append_collapse_key(CollapseKey, CollapseMax, N2S, Bin@),
+    Bin@ = append_enquire_timeout(Timeout, Bin@),
     Bin@ = append_command(stop, Bin@),
     Bin@;
 
@@ -127,6 +130,15 @@ append_cutoff(PercentCutoff, WeightCutoff, Bin@) ->
     Bin@.
 
 
+append_enquire_timeout(infinity, Bin) ->
+    Bin;
+
+append_enquire_timeout(Timeout, Bin@) ->
+    Bin@ = append_command(timeout, Bin@),
+    Bin@ = append_timeout(Timeout, Bin@),
+    Bin@.
+
+
 %% `CollapseMax' is meaningful only when `CollapseKey' is defined.
 append_collapse_key(undefined, _CollapseMax, _N2S, Bin) ->
     Bin;
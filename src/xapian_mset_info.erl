@@ -4,13 +4,15 @@
          properties/0]).
 
 -import(xapian_common, [
+    read_string/1,
     append_param/2,
     append_stop/1,
     append_string/2,
     append_double/2,
     read_document_count/1,
     read_weight/1,
-    read_percent/1
+    read_percent/1,
+    read_boolean/1
 ]).
 
 -import(xapian_const, [mset_info_param_id/1]).
@@ -36,6 +38,11 @@ decode(Param, Bin) ->
     decode_mset_info_param2(Param, Bin).
 
 
+%% The cursor is not in `properties()', because it is only useful 
+%% for the next page.
+append_mset_info_param(cursor, Bin) ->
+    append_param(mset_info_param_id(cursor), Bin);
+
 append_mset_info_param(Param, Bin) when is_atom(Param) ->
     true = lists:member(Param, properties()),
     append_param(mset_info_param_id(Param), Bin);
@@ -63,7 +70,8 @@ decode_mset_info_param2({Param, _Term}, Bin) when is_atom(Param) ->
 %% @doc Return the ordered list of properties.
 %% These properties can be accessed without an additional parameter.
 properties() ->
-    [ matches_estimated
+    [ is_truncated
+    , matches_estimated
     , matches_lower_bound
     , matches_upper_bound
     , max_attained
@@ -116,4 +124,13 @@ decode_param(term_freq, Bin) ->
     read_document_count(Bin);
 
 decode_param(weight_to_percent, Bin) ->
-    read_percent(Bin).
+    read_percent(Bin);
+
+decode_param(is_truncated, Bin) ->
+    read_boolean(Bin);
+
+decode_param(cursor, Bin) ->
+    case read_string(Bin) of
+        {<<>>, RemBin} -> {undefined, RemBin};
+        {Cursor, RemBin} -> {Cursor, RemBin}
+    end.
@@ -0,0 +1,44 @@
+%% @doc The NIF front-end of the C-part.
+%% It is used by `xapian_port' with the type `nif'.
+%% Each `open/0' call creates a new independent Driver.
+-module(xapian_nif).
+-export([open/0,
+         close/1,
+         is_alive/1,
+         dirty_io_control/3,
+         dirty_cpu_control/3]).
+
+-on_load(init/0).
+
+-define(NIF_NAME, "xapian_nif").
+
+
+%% @doc Find and load the so file.
+init() ->
+    PrivDir = code:priv_dir(xapian),
+    erlang:load_nif(filename:join(PrivDir, ?NIF_NAME), 0).
+
+
+%% @doc Create a new Driver, wrapped into a resource object.
+open() ->
+    erlang:nif_error(nif_not_loaded).
+
+
+%% @doc Release the Driver. 
+%% Next calls with this resource will fail with `badarg'.
+close(_Res) ->
+    erlang:nif_error(nif_not_loaded).
+
+
+is_alive(_Res) ->
+    erlang:nif_error(nif_not_loaded).
+
+
+%% @doc Handle a command on a dirty I/O scheduler.
+dirty_io_control(_Res, _Command, _Data) ->
+    erlang:nif_error(nif_not_loaded).
+
+
+%% @doc Handle a command on a dirty CPU scheduler.
+dirty_cpu_control(_Res, _Command, _Data) ->
+    erlang:nif_error(nif_not_loaded).
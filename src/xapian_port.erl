@@ -3,6 +3,11 @@
          close/1,
          connect/2,
          control/3,
+         async_control/3,
+         send_request/3,
+         parse_reply/2,
+         is_pipelined/1,
+         is_async/1,
          is_port_alive/1]).
 
 -export_type([x_port/0]).
@@ -10,9 +15,19 @@
 -define(DRIVER_NAME, "xapian_drv").
 -define(PORT_NAME,   "xapian_port").
 
+%% The reply of the driver, when an async job holds the Driver.
+%% See `Driver::BUSY'.
+-define(DRIVER_BUSY, 3).
+
+%% The default capacity of each ring of the `shm' port.
+-define(SHM_RING_CAPACITY, 1048576).
+
 -record(port_rec, {
-        port :: port(), 
-        type :: atom()
+        %% A NIF resource, if type = nif.
+        port :: port() | term(), 
+        type :: atom(),
+        %% Shared memory rings, if type = shm.
+        rings :: term()
 }).
 
 -type x_port() :: #port_rec{}.
@@ -34,6 +49,17 @@ load_driver() ->
 
 
 %% @doc Open an instance (port).
+%% `{shm, Capacity}' sets the capacity of each ring in bytes.
+%% Messages, which are larger than the free space of the ring, 
+%% are passed through the pipe.
+
+open(shm) ->
+    open({shm, ?SHM_RING_CAPACITY});
+
+open({shm, Capacity}) ->
+    Path = shm_path(),
+    {ok, Rings} = xapian_shm:create(Path, Capacity),
+    #port_rec{type = shm, port = open_shm_port(Path), rings = Rings};
 
 open(Type) ->
     #port_rec{type = Type, port = open_port(Type)}.
@@ -45,19 +71,82 @@ open(Type) ->
 %% 
 %% If port = driver:
 %% * Release resources.
+%%
+%% If Port = pipeline, it is the same as for port.
+%%
+%% If Port = shm, it is the same as for port, and the shared file is deleted.
+%%
+%% If Port = nif:
+%% * Release resources, the resource object will be deleted by GC.
+
+close(#port_rec{port = Res, type = nif}) ->
+    xapian_nif:close(Res);
+
+close(#port_rec{port = Port, type = shm, rings = Rings}) ->
+    erlang:port_close(Port),
+    xapian_shm:close(Rings);
 
 close(#port_rec{port = Port}) ->
     erlang:port_close(Port).
 
 
 %% @doc Change the process's owner.
+%% A NIF resource is not linked with any process.
+connect(#port_rec{type = nif}, _NewOwnerPid) ->
+    true;
+
 connect(#port_rec{port = Port}, NewOwnerPid) ->
     erlang:port_connect(Port, NewOwnerPid).
 
 
 %% @doc Send a command.
-control(#port_rec{port = Port, type = driver}, Command, Data) ->
-    erlang:port_control(Port, Command, Data);
+%% If async jobs are queued or running, the driver replies BUSY and the
+%% command is queued after them: commands are handled in order and 
+%% the scheduler never waits for a job.
+control(#port_rec{port = Port, type = driver} = PortRec, Command, Data) ->
+    case erlang:port_control(Port, Command, Data) of
+        <<?DRIVER_BUSY:8/native-unsigned-integer>> ->
+            async_control(PortRec, Command, Data);
+        AnswerData ->
+            AnswerData
+    end;
+
+%% Most commands access the database, they are run on a dirty I/O scheduler.
+control(#port_rec{port = Res, type = nif}, Command, Data) ->
+    xapian_nif:dirty_io_control(Res, Command, Data);
+
+control(#port_rec{port = Port, type = pipeline} = PortRec, Command, Data) ->
+    ReqId = send_request(PortRec, Command, Data),
+    %% Replies on other requests stay in the mailbox.
+    receive
+        {Port, {data, <<ReqId:32/unsigned-native-integer, 
+                        AnswerData/binary>>}} ->
+            AnswerData;
+        {'EXIT', Port, Reason} ->
+            erlang:error({port_exit, Reason});
+        {Port, {exit_status, _Status}} ->
+            erlang:error(port_exit)
+    end;
+
+%% The request is passed through the ring, the pipe is used for notification.
+%% An empty packet means, that the message is in the ring.
+%% If the message does not fit, it is sent through the pipe.
+control(#port_rec{port = Port, type = shm, rings = Rings}, Command, Data) ->
+    case xapian_shm:write_request(Rings, Command, Data) of
+        true  -> port_command(Port, <<>>);
+        false -> port_command(Port, <<Command:32/unsigned-native-integer, 
+                                       Data/binary>>)
+    end,
+    receive
+        {Port, {data, <<>>}} ->
+            xapian_shm:read_reply(Rings);
+        {Port, {data, AnswerData}} ->
+            AnswerData;
+        {'EXIT', Port, Reason} ->
+            erlang:error({port_exit, Reason});
+        {Port, {exit_status, _Status}} ->
+            erlang:error(port_exit)
+    end;
 
 control(#port_rec{port = Port, type = port}, Command, Data) ->
     Mess = <<Command:32/unsigned-native-integer, Data/binary>>,
@@ -72,22 +161,145 @@ control(#port_rec{port = Port, type = port}, Command, Data) ->
     after 1000 ->
             erlang:error(port_timeout)
     end.
+
+
+%% @doc Send a long-running command.
+%% The driver handles it in the async thread pool and does not block 
+%% the scheduler. The port program handles all commands in the same way.
+%%
+%% The driver can reply with a list of binaries (chunks). They are not 
+%% merged: documents are never split between chunks, so records are decoded
+%% chunk by chunk, see `xapian_record:decode_list/3'.
+%%
+%% Replies on other queued requests stay in the mailbox.
+async_control(#port_rec{port = Port, type = driver} = PortRec, Command, Data) ->
+    ReqId = send_request(PortRec, Command, Data),
+    receive
+        {Port, {data, [<<ReqId:32/unsigned-native-integer, Head/binary>> 
+                       | Chunks]}} ->
+            async_answer(Head, Chunks);
+        {Port, {data, <<ReqId:32/unsigned-native-integer, 
+                        AnswerData/binary>>}} ->
+            AnswerData;
+        {'EXIT', Port, Reason} ->
+            erlang:error({port_exit, Reason})
+    end;
+
+%% Matching is run on a dirty CPU scheduler.
+async_control(#port_rec{port = Res, type = nif}, Command, Data) ->
+    xapian_nif:dirty_cpu_control(Res, Command, Data);
+
+async_control(PortRec, Command, Data) ->
+    control(PortRec, Command, Data).
+
+
+%% @doc Send a request to a pipelined port or to the async queue of 
+%% the driver without waiting for the reply.
+%% The reply is a message `{Port, {data, <<ReqId:32, Answer>>}}', 
+%% that can be parsed with `parse_reply/2'.
+%% Replies can be delivered in any order.
+send_request(#port_rec{port = Port, type = Type}, Command, Data)
+    when Type =:= pipeline; Type =:= driver ->
+    ReqId = erlang:unique_integer([positive]) band 16#FFFFFFFF,
+    Mess = <<ReqId:32/unsigned-native-integer, 
+             Command:32/unsigned-native-integer, Data/binary>>,
+    port_command(Port, Mess),
+    ReqId.
+
+
+%% @doc Extract the request id and the answer from the port message.
+parse_reply(#port_rec{port = Port, type = pipeline}, 
+            {Port, {data, <<ReqId:32/unsigned-native-integer, 
+                            AnswerData/binary>>}}) ->
+    {ok, ReqId, AnswerData};
+
+%% The request id is the first chunk of an async reply of the driver.
+parse_reply(#port_rec{port = Port, type = driver}, 
+            {Port, {data, [<<ReqId:32/unsigned-native-integer, Head/binary>> 
+                           | Chunks]}}) ->
+    {ok, ReqId, async_answer(Head, Chunks)};
+
+parse_reply(#port_rec{port = Port, type = driver}, 
+            {Port, {data, <<ReqId:32/unsigned-native-integer, 
+                            AnswerData/binary>>}}) ->
+    {ok, ReqId, AnswerData};
+
+parse_reply(_PortRec, _Mess) ->
+    false.
+
+
+%% Chunks are not merged, see `async_control/3'.
+async_answer(<<>>, [AnswerData]) ->
+    AnswerData;
+
+async_answer(<<>>, Chunks) ->
+    Chunks;
+
+async_answer(Head, Chunks) ->
+    [Head | Chunks].
+
+
+%% @doc Return true, if a few requests can be handled at the same time.
+is_pipelined(#port_rec{type = Type}) ->
+    Type =:= pipeline.
+
+
+%% @doc Return true, if long commands can be queued with `send_request/3',
+%% while other commands are handled by `control/3'.
+is_async(#port_rec{type = Type}) ->
+    Type =:= driver.
             
 
 
+%% Create a Driver, that is called directly from the calling process.
+%% The library is loaded by `xapian_nif'.
+open_port(nif) ->
+    xapian_nif:open();
+
 %% Load erlang port driver (ddl).
 open_port(driver) ->
     load_driver(),
-    erlang:open_port({spawn, ?DRIVER_NAME}, []);
+    erlang:open_port({spawn, ?DRIVER_NAME}, [binary]);
 
 %% Run erlang port (exe).
 open_port(port) ->
     PrivDir = code:priv_dir(xapian),
     Exe = filename:join(PrivDir, ?PORT_NAME),
     Opts = [{packet, 4}, binary, exit_status, use_stdio],
+    erlang:open_port({spawn_executable, Exe}, Opts);
+
+%% Run erlang port (exe) in the pipelined mode.
+open_port(pipeline) ->
+    PrivDir = code:priv_dir(xapian),
+    Exe = filename:join(PrivDir, ?PORT_NAME),
+    Opts = [{packet, 4}, binary, exit_status, use_stdio, 
+            {args, ["--pipeline"]}],
+    erlang:open_port({spawn_executable, Exe}, Opts).
+
+
+%% Run erlang port (exe), that maps the shared file.
+open_shm_port(Path) ->
+    PrivDir = code:priv_dir(xapian),
+    Exe = filename:join(PrivDir, ?PORT_NAME),
+    Opts = [{packet, 4}, binary, exit_status, use_stdio, 
+            {args, ["--shm", Path]}],
     erlang:open_port({spawn_executable, Exe}, Opts).
 
 
+%% A unique name in the memory file system.
+shm_path() ->
+    Dir = case filelib:is_dir("/dev/shm") of
+            true  -> "/dev/shm";
+            false -> os:getenv("TMPDIR", "/tmp")
+          end,
+    Name = io_lib:format("xapian_port_~s_~w", 
+                         [os:getpid(), erlang:unique_integer([positive])]),
+    filename:join(Dir, lists:flatten(Name)).
+
+
 %% @doc Return true, if the passed port is active.
+is_port_alive(#port_rec{port = Res, type = nif}) ->
+    xapian_nif:is_alive(Res);
+
 is_port_alive(#port_rec{port = Port}) ->
     undefined =/= erlang:port_info(Port, id).
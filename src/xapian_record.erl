@@ -2,6 +2,7 @@
 %%% It is used with MSet.
 -module(xapian_record).
 -export([record/2, 
+         record/3, 
          encode/4, 
          decode/3, 
          decode_list/3, 
@@ -12,7 +13,7 @@
 
 -compile({parse_transform, gin}).
 -compile({parse_transform, seqbind}).
--record(rec, {name, fields}).
+-record(rec, {name, fields, is_compact = false}).
 -import(xapian_common, [ 
         append_uint/2,
         append_uint8/2,
@@ -28,6 +29,13 @@
         read_percent/1,
         read_uint8/1,
         read_unknown_type_value/1,
+        read_varint/1,
+        read_compact_string/1,
+        read_compact_document_id/1,
+        read_compact_strings/1,
+        read_compact_strings_and_positions/1,
+        read_compact_slot_and_values/1,
+        read_compact_unknown_type_value/1,
         slot_type/2,
         index_of/2]).
 
@@ -69,6 +77,24 @@ record(TupleName, TupleFields) ->
     #rec{name=TupleName, fields=TupleFields}.
 
 
+%% @doc The same as `record/2', but with options:
+%% 
+%% <ul><li>
+%% `compact' - integers and lengths of strings are encoded as varints,
+%% positions are delta-coded. It makes replies with many terms, positions or
+%% short strings smaller.
+%% </li></ul>
+-spec record(TupleName, TupleFields, Opts) -> Meta when
+    TupleName :: atom(),
+    TupleFields :: [atom()],
+    Opts :: [compact],
+    Meta :: x_document_meta().
+
+record(TupleName, TupleFields, Opts) ->
+    #rec{name=TupleName, fields=TupleFields, 
+         is_compact=lists:member(compact, Opts)}.
+
+
 %% @doc Return an index of the `Field' or `undefined' if there is no a key.
 -spec key_position(Meta, Field) -> Pos when
     Meta :: x_document_meta(),
@@ -89,10 +115,15 @@ tuple(#rec{name=TupleName, fields=TupleFields}) ->
 
 
 %% Append information about fields to `Bin'.
-encode(Meta, Name2Slot, Value2TypeArray, Bin) ->
-    #rec{name=_TupleName, fields=TupleFields} = Meta,
-    enc(TupleFields, Name2Slot, Value2TypeArray, 
-        append_uint8(encoder_source_type_id(TupleFields), Bin)).
+encode(Meta, Name2Slot, Value2TypeArray, Bin@) ->
+    #rec{name=_TupleName, fields=TupleFields, is_compact=IsCompact} = Meta,
+    Bin@ = append_uint8(encoder_source_type_id(TupleFields), Bin@),
+    Bin@ = append_compact(IsCompact, Bin@),
+    enc(TupleFields, Name2Slot, Value2TypeArray, Bin@).
+
+
+append_compact(true, Bin)  -> append_type(compact, Bin);
+append_compact(false, Bin) -> Bin.
 
 
 encoder_source_type_id(TupleFields) ->
@@ -112,42 +143,68 @@ encoder_source_type([_|_] = TupleFields) ->
 -spec decode(term(), orddict:orddict(), binary()) -> {term(), binary()}.
 
 decode(Meta, I2N, Bin) ->
-    #rec{name=TupleName, fields=TupleFields} = Meta,
-    dec(TupleFields, I2N, Bin, [TupleName]).
+    #rec{name=TupleName, fields=TupleFields, is_compact=IsCompact} = Meta,
+    case IsCompact of
+        false -> dec(TupleFields, I2N, Bin, [TupleName]);
+        true  -> dec_compact(TupleFields, I2N, Bin, [TupleName])
+    end.
 
 
 %% @doc Read a list of records from a binary.
-decode_list(Meta, I2N, Bin@) ->
+%% An async reply of the driver is a list of chunks. A record is never split
+%% between chunks, so each record is a sub-binary of one chunk.
+decode_list(Meta, I2N, [Bin@ | Chunks]) ->
     {Count, Bin@} = read_doccount(Bin@),
-    decode_cycle(Count, Meta, I2N, Bin@, []).
+    decode_cycle(Count, Meta, I2N, [Bin@ | Chunks], []);
 
+decode_list(Meta, I2N, Bin) ->
+    decode_list(Meta, I2N, [Bin]).
 
-decode_cycle(0, _Meta, _I2N, Bin, Acc) ->
-    {lists:reverse(Acc), Bin};
 
-decode_cycle(Count, Meta, I2N, Bin@, Acc) 
+decode_cycle(Count, Meta, I2N, [<<>>, Bin | Chunks], Acc) ->
+    decode_cycle(Count, Meta, I2N, [Bin | Chunks], Acc);
+
+decode_cycle(0, _Meta, _I2N, Chunks, Acc) ->
+    {lists:reverse(Acc), iolist_to_binary(Chunks)};
+
+decode_cycle(Count, Meta, I2N, [Bin@ | Chunks], Acc) 
     when Count > 0 ->
     {Rec, Bin@} = decode(Meta, I2N, Bin@),
-    decode_cycle(Count-1, Meta, I2N, Bin@, [Rec|Acc]).
+    decode_cycle(Count-1, Meta, I2N, [Bin@ | Chunks], [Rec|Acc]).
 
 
 
 %% @doc This encoding schema is used when a total size is unknown.
+decode_list2(Meta, I2N, Chunks) when is_list(Chunks) ->
+    decode_list2(Meta, I2N, Chunks, []);
+
 decode_list2(Meta, I2N, Bin) ->
-    decode_list2(Meta, I2N, Bin, []).
+    decode_list2(Meta, I2N, [Bin], []).
 
 
-decode_list2(Meta, I2N, Bin@, Acc) ->
+decode_list2(Meta, I2N, [<<>>, Bin | Chunks], Acc) ->
+    decode_list2(Meta, I2N, [Bin | Chunks], Acc);
+
+decode_list2(Meta, I2N, [Bin@ | Chunks], Acc) ->
     {Flag, Bin@} = read_uint8(Bin@),
     case Flag of
         1 -> 
-            {Rec, Bin@} = decode(Meta, I2N, Bin@),
-            decode_list2(Meta, I2N, Bin@, [Rec|Acc]);
+            {Rec, Rest} = decode_chunk(Meta, I2N, [Bin@ | Chunks]),
+            decode_list2(Meta, I2N, Rest, [Rec|Acc]);
         0 -> 
-            {lists:reverse(Acc), Bin@}
+            {lists:reverse(Acc), iolist_to_binary([Bin@ | Chunks])}
     end.
 
 
+%% The flag and the record can be in different chunks.
+decode_chunk(Meta, I2N, [<<>>, Bin | Chunks]) ->
+    decode_chunk(Meta, I2N, [Bin | Chunks]);
+
+decode_chunk(Meta, I2N, [Bin@ | Chunks]) ->
+    {Rec, Bin@} = decode(Meta, I2N, Bin@),
+    {Rec, [Bin@ | Chunks]}.
+
+
 
 %% ------------------------------------------------------------------
 %% Encode data helpers (Bin will be passed into a port)
@@ -247,10 +304,39 @@ dec([], _I2N, Rem, Acc) ->
     {erlang:list_to_tuple(lists:reverse(Acc)), Rem}.
 
 
+%% Integers and lengths are varints, see `FieldEncoder'.
+dec_compact([H|T], I2N, Bin, Acc) ->
+    {Val, NewBin} =
+        case H of
+            data             -> read_compact_string(Bin);
+            docid            -> read_compact_document_id(Bin);
+            weight           -> read_weight(Bin);  % double
+            rank             -> read_varint(Bin);
+            percent          -> read_percent(Bin); % uint8_t
+            collapse_key     -> read_compact_string(Bin); 
+            collapse_count   -> read_varint(Bin); 
+            multi_docid      -> read_compact_document_id(Bin);
+            db_number        -> read_varint(Bin);
+            db_name          -> read_compact_db_name(Bin, I2N);
+            all_terms        -> read_compact_strings(Bin);
+            all_terms_pos    -> read_compact_strings_and_positions(Bin);
+            all_values       -> read_compact_slot_and_values(Bin);
+            _ValueField      -> read_compact_unknown_type_value(Bin)
+        end,
+    dec_compact(T, I2N, NewBin, [Val|Acc]);
+
+dec_compact([], _I2N, Rem, Acc) -> 
+    {erlang:list_to_tuple(lists:reverse(Acc)), Rem}.
+
+
 read_db_name(Bin, I2N) ->
     {Id, NewBin} = read_db_id(Bin),
     {db_id_to_name(Id, I2N), NewBin}.
 
+read_compact_db_name(Bin, I2N) ->
+    {Id, NewBin} = read_varint(Bin),
+    {db_id_to_name(Id, I2N), NewBin}.
+
 db_id_to_name(Id, I2N) ->
     get_tuple_value(Id, I2N, Id).
 
@@ -32,8 +32,14 @@
          remove_synonym/3,
          clear_synonyms/2]).
 
+%% Few commands at once
+-export([batch/2]).
+
 %% Queries
--export([query_page/5]). 
+-export([query_page/5,
+         query_page/6,
+         count/2,
+         count/3]). 
 
 %% Resources
 -export([enquire/2,
@@ -48,8 +54,25 @@
 %% Resources
 -export([create_resource/2,
          release_resource/2,
-         release_table/2]).
-
+         release_table/2,
+         resource_limits/1,
+         set_resource_limits/2,
+         resource_info/1]).
+
+
+%% Caches
+-export([query_cache_info/1,
+         set_query_cache_capacity/2,
+         mset_cache_info/1,
+         set_mset_cache_capacity/2,
+         filter_cache_info/1,
+         set_filter_cache_capacity/2,
+         set_filter_cache_max_memory/2]).
+
+%% Parallel search
+-export([shard_search_info/1,
+         set_shard_search_threads/2,
+         set_shard_search_threads/3]).
 
 %% Information
 -export([mset_info/2,
@@ -78,6 +101,7 @@
 -export([internal_qlc_init/4,
          internal_register_qlc_table/3,
          internal_qlc_get_next_portion/4,
+         internal_qlc_get_next_portion/5,
          internal_qlc_lookup/3,
 
          internal_transaction_lock_server/2,
@@ -121,11 +145,13 @@
 
 -import(xapian_common, [ 
     append_binary/2,
+    append_boolean/2,
     append_int8/2,
     append_uint8/2,
     append_uint16/2,
     append_uint/2,
     append_string/2,
+    append_timeout/2,
     append_document_id/2,
     append_unique_document_id/2,
     resource_appender/2,
@@ -205,7 +231,11 @@ resource_reference_to_number(Register, ClientPid, ResRef) ->
     %% be master.
     master :: pid() | undefined,
     %% Stores information about active resources of this server.
-    register = xapian_register:new()
+    register = xapian_register:new(),
+
+    %% Requests, sent to the pipelined port, which are waiting for replies.
+    %% Maps a request id to `{From, Operation, Data, Decoder}'.
+    pending_requests = dict:new()
 }).
 
 
@@ -283,6 +313,9 @@ resource_reference_to_number(Register, ClientPid, ResRef) ->
 
 -type multi_db_path() :: [#x_database{}|#x_prog_database{}|#x_tcp_database{}].
 -type db_path() :: x_string() | multi_db_path().
+-type resource_limits_pair() :: 
+    {max_memory | idle_ttl | count | memory 
+    | evicted_by_budget | evicted_by_ttl, non_neg_integer()}.
 
 
 %% ------------------------------------------------------------------
@@ -330,6 +363,19 @@ resource_reference_to_number(Register, ClientPid, ResRef) ->
 %% </li><li>
 %% An interface to work: `port' (or `driver' by default).
 %% </li><li>
+%% `shm' is a `port', that passes messages through shared memory rings.
+%% It is useful for large result pages. `{shm, Capacity}' sets the size 
+%% of each ring in bytes, the default is 1 MiB. A request or a reply, 
+%% that does not fit into the free space of its ring, is passed through 
+%% the pipe, as for `port';
+%% </li><li>
+%% `nif' calls the C-part directly from the server process on dirty 
+%% schedulers. There is no port lock, so few servers with read-only 
+%% databases do not block each other;
+%% </li><li>
+%% `pipeline' is a `port', that handles read-only commands of few clients 
+%% concurrently. It is useful for read-only databases;
+%% </li><li>
 %% `{name, Atom}' allows to register the server under the local name `Atom';
 %% </li><li>
 %% `{name, {local, Atom}}' does the same;
@@ -411,7 +457,48 @@ document_info(Server, DocumentConstructor, RecordMetaDefinition) ->
 -spec query_page(x_server(), non_neg_integer(), non_neg_integer(), 
         x_sub_query(), x_meta()) -> [x_record()].
 query_page(Server, Offset, PageSize, Query, RecordMetaDefinition) ->
-    call(Server, {query_page, Offset, PageSize, Query, RecordMetaDefinition}).
+    query_page(Server, Offset, PageSize, Query, RecordMetaDefinition, []).
+
+
+%% @doc Return a list of records.
+%% Options are:
+%% <ul> <li>
+%% `{timeout, Milliseconds}' - the time budget of the match. 
+%% If the budget is spent, the result is truncated and 
+%% `{truncated, Records}' is returned. Records are the best of documents,
+%% that were checked before the deadline.
+%% The budget does not bound the time of the call: other documents
+%% are still visited by the matcher, but they are rejected cheaply.
+%% </li></ul>
+-spec query_page(x_server(), non_neg_integer(), non_neg_integer(), 
+        x_sub_query(), x_meta(), [{timeout, timeout()}]) -> 
+        [x_record()] | {truncated, [x_record()]}.
+query_page(Server, Offset, PageSize, Query, RecordMetaDefinition, Opts) ->
+    call(Server, {query_page, Offset, PageSize, Query, RecordMetaDefinition, 
+                  Opts}).
+
+
+%% @doc Return the exact count of documents, that match the query.
+-spec count(x_server(), x_sub_query()) -> non_neg_integer().
+count(Server, Query) ->
+    Counts = count(Server, Query, [{exact, true}]),
+    proplists:get_value(matches_estimated, Counts).
+
+
+%% @doc Return bounds of the count of documents, that match the query.
+%% No documents are retrieved and no match set is stored.
+%% A term and an `AND' or `OR' group of terms are counted from term 
+%% frequencies. Other queries are matched without weights.
+%% Options are:
+%% <ul> <li>
+%% `{exact, Bool}' - if `true', documents are matched, when term 
+%% frequencies give only bounds. It is `false' by default.
+%% </li></ul>
+-spec count(x_server(), x_sub_query(), [{exact, boolean()}]) -> [Pair] when
+    Pair :: {matches_lower_bound | matches_estimated | matches_upper_bound,
+             non_neg_integer()}.
+count(Server, Query, Opts) ->
+    call(Server, {count, Query, Opts}).
 
 
 
@@ -480,7 +567,9 @@ document(Server, DocId) -> %% DocId can be an unique term.
 %%     offset = Offset, 
 %%     max_items = MaxItems, 
 %%     check_at_least = CheckAtLeast, 
-%%     spies = Spies
+%%     spies = Spies,
+%%     timeout = Timeout,
+%%     search_after = Cursor
 %% }
 %% '''
 %%
@@ -498,7 +587,21 @@ document(Server, DocId) -> %% DocId can be an unique term.
 %% It is `undefined' by default, 
 %% that means all items will be selected;
 %% </li><li>
-%% `Spies' is a list of MatchSpy resources {@link xapian_match_spy}.
+%% `Spies' is a list of MatchSpy resources {@link xapian_match_spy};
+%% </li><li>
+%% `Timeout' is the time budget of the match in milliseconds.
+%% It is `undefined' by default, that means the `timeout' field of 
+%% `#x_enquire{}' is used. If the budget is spent, the match set contains
+%% the best of documents, that were checked before the deadline. 
+%% `mset_info(Server, MSet, is_truncated)' returns `true' in this case;
+%% </li><li>
+%% `Cursor' is `mset_info(Server, PrevMSet, cursor)' of the previous page.
+%% Only documents after the last document of that page are matched,
+%% so `Offset' is usually `0'. The matcher keeps only one page, 
+%% it is cheaper than a big offset for deep paging.
+%% Cursors work for one database, if the enquire is sorted by value
+%% (`#x_sort_order{type = value}') or uses `xapian_resource:bool_weight()'
+%% without a sort order. A cursor of an empty page is `undefined'.
 %% </li></ul>
 %%
 %% @see enquire/2
@@ -565,6 +668,171 @@ release_resource(Server, ResourceRef) when is_reference(ResourceRef) ->
 create_resource(Server, Con) ->
     xapian_resource:create(Server, Con).
 
+%% @doc Return limits and counters of the resource register.
+%% @see set_resource_limits/2
+-spec resource_limits(x_server()) -> [resource_limits_pair()].
+resource_limits(Server) ->
+    call(Server, {resource_limits, undefined}).
+
+%% @doc Set a memory budget and an idle TTL for resources of the server.
+%%
+%% `max_memory' is an approximate budget in bytes, `idle_ttl' is 
+%% in milliseconds, `0' disables the limit.
+%% Each resource is counted once, without attached children (for example,
+%% the MSet of a QLC table is counted by its own resource).
+%% If one of the limits is passed, the least recently used resources are 
+%% evicted, when a new resource is created. Idle resources are also 
+%% evicted, when any resource is used. There is no timer, so a server 
+%% without requests keeps its idle resources until the next request.
+%% A later use of an evicted resource fails with 
+%% `#x_error{type = <<"ElementEvictedDriverError">>}'.
+%% Evicted resources still should be released.
+%%
+%% Returns the same as {@link resource_limits/1}.
+-spec set_resource_limits(Server, Limits) -> [resource_limits_pair()] when
+    Server :: x_server(),
+    Limits :: [{max_memory | idle_ttl, non_neg_integer()}].
+set_resource_limits(Server, Limits) ->
+    MaxMemory = proplists:get_value(max_memory, Limits, 0),
+    IdleTtl   = proplists:get_value(idle_ttl, Limits, 0),
+    call(Server, {resource_limits, {MaxMemory, IdleTtl}}).
+
+%% @doc Return live resources of the server, grouped by type.
+%%
+%% `oldest_age' is the age of the oldest resource in milliseconds.
+%% `types' is a list of `{TypeName, Count, Bytes}', where `Bytes' is
+%% an approximate memory footprint of resources of this type
+%% (including attached children).
+-spec resource_info(x_server()) -> [Pair] when
+    Pair :: {oldest_age, non_neg_integer()}
+          | {types, [{binary(), non_neg_integer(), non_neg_integer()}]}.
+resource_info(Server) ->
+    call(Server, resource_info).
+
+%% @doc Return the state of the cache of parsed queries.
+%%
+%% Queries from `#x_query_string{}' are cached by the server, if 
+%% the database is read-only. The cache is cleared, when the database
+%% is opened or the default stemmer or prefixes are changed.
+%% In the `pipeline' mode each worker has its own cache of this capacity,
+%% `size' and counters are summed over all workers.
+-spec query_cache_info(x_server()) -> [Pair] when
+    Pair :: {capacity | size | hits | misses | evictions, non_neg_integer()}.
+query_cache_info(Server) ->
+    call(Server, {query_cache, undefined}).
+
+%% @doc Set the maximum count of cached queries, `0' disables the cache.
+%% Returns the same as {@link query_cache_info/1}.
+-spec set_query_cache_capacity(x_server(), non_neg_integer()) -> [Pair] when
+    Pair :: {capacity | size | hits | misses | evictions, non_neg_integer()}.
+set_query_cache_capacity(Server, Capacity) ->
+    call(Server, {query_cache, Capacity}).
+
+%% @doc Return the state of the cache of match results.
+%%
+%% Results of {@link match_set/2} and {@link query_page/5} are cached by 
+%% the server, if the capacity of the cache is set. It is disabled by 
+%% default. Matches with spies and matches stopped by the timeout are 
+%% not cached. The cache is cleared, when the database is opened or 
+%% changed. In the `pipeline' mode each worker has its own cache of 
+%% this capacity, `size' and counters are summed over all workers.
+-spec mset_cache_info(x_server()) -> [Pair] when
+    Pair :: {capacity | size | hits | misses | evictions, non_neg_integer()}.
+mset_cache_info(Server) ->
+    call(Server, {mset_cache, undefined}).
+
+%% @doc Set the maximum count of cached match results, `0' disables 
+%% the cache. Returns the same as {@link mset_cache_info/1}.
+-spec set_mset_cache_capacity(x_server(), non_neg_integer()) -> [Pair] when
+    Pair :: {capacity | size | hits | misses | evictions, non_neg_integer()}.
+set_mset_cache_capacity(Server, Capacity) ->
+    call(Server, {mset_cache, Capacity}).
+
+%% @doc Return the state of the cache of filters.
+%%
+%% If the capacity of the cache is set and one database is opened, 
+%% then docids of filters of scored queries are cached by the server. 
+%% Filters are right sub-queries of `FILTER' and `AND NOT' and sub-queries
+%% without weights (for example, value ranges) of `AND'. The cache is 
+%% cleared, when the database is opened or changed. `memory' and `max_memory' are 
+%% in bytes. In the `pipeline' mode each worker has its own cache with 
+%% these limits, `size', `memory' and counters are summed over all 
+%% workers.
+-spec filter_cache_info(x_server()) -> [Pair] when
+    Pair :: {capacity | size | hits | misses | evictions | memory 
+            | max_memory, non_neg_integer()}.
+filter_cache_info(Server) ->
+    call(Server, {filter_cache, undefined}).
+
+%% @doc Set the maximum count of cached filters, `0' disables the cache.
+%% Returns the same as {@link filter_cache_info/1}.
+-spec set_filter_cache_capacity(x_server(), non_neg_integer()) -> [Pair] when
+    Pair :: {capacity | size | hits | misses | evictions | memory 
+            | max_memory, non_neg_integer()}.
+set_filter_cache_capacity(Server, Capacity) ->
+    call(Server, {filter_cache, {capacity, Capacity}}).
+
+%% @doc Set the memory budget of the cache of filters in bytes, 
+%% `0' removes the limit. 
+%% The least recently used filters are evicted to fit the budget,
+%% a filter, which is larger than the whole budget, is not cached.
+%% Returns the same as {@link filter_cache_info/1}.
+-spec set_filter_cache_max_memory(x_server(), non_neg_integer()) -> [Pair] when
+    Pair :: {capacity | size | hits | misses | evictions | memory 
+            | max_memory, non_neg_integer()}.
+set_filter_cache_max_memory(Server, MaxMemory) ->
+    call(Server, {filter_cache, {max_memory, MaxMemory}}).
+
+%% @doc Return the state of the fan-out search.
+%%
+%% If few databases are opened read-only from local paths and threads
+%% are set, then {@link query_page/5} runs the query on each database
+%% in parallel and merges pages. 
+%%
+%% Xapian cannot rank a database with statistics of other ones, so 
+%% weights of different databases are not comparable. That is why only
+%% unweighted queries (filters, see `#x_query_scale_weight{factor = 0}')
+%% are matched on databases by default, their result is the same, as of
+%% the serial search. Weighted queries are matched on databases only 
+%% with `{local_weights, true}', each database is ranked with its own 
+%% statistics then.
+%%
+%% Pages of the fan-out search are not cached by the MSet cache.
+%%
+%% `searches' is the count of queries, that were matched on databases.
+-spec shard_search_info(x_server()) -> [Pair] when
+    Pair :: {threads | shards | searches, non_neg_integer()} 
+          | {local_weights, boolean()}.
+shard_search_info(Server) ->
+    call(Server, {shard_search, undefined}).
+
+%% @doc Set the count of search threads, `0' disables the fan-out search.
+%% Returns the same as {@link shard_search_info/1}.
+%% @equiv set_shard_search_threads(Server, ThreadCount, [])
+-spec set_shard_search_threads(x_server(), non_neg_integer()) -> [Pair] when
+    Pair :: {threads | shards | searches, non_neg_integer()} 
+          | {local_weights, boolean()}.
+set_shard_search_threads(Server, ThreadCount) ->
+    set_shard_search_threads(Server, ThreadCount, []).
+
+%% @doc Set the count of search threads and options of the fan-out search.
+%%
+%% Options:
+%% <ul>
+%% <li>`{local_weights, true}' - match weighted queries on databases too,
+%%  ranking each one with its own statistics; 
+%%  the default is `false'.</li>
+%% </ul>
+%% Returns the same as {@link shard_search_info/1}.
+-spec set_shard_search_threads(x_server(), non_neg_integer(), [Opt]) -> 
+    [Pair] when
+    Opt  :: {local_weights, boolean()},
+    Pair :: {threads | shards | searches, non_neg_integer()} 
+          | {local_weights, boolean()}.
+set_shard_search_threads(Server, ThreadCount, Opts) ->
+    IsLocalWeights = proplists:get_bool(local_weights, Opts),
+    call(Server, {shard_search, {ThreadCount, IsLocalWeights}}).
+
 %% @doc Clean resources allocated by the QLC table.
 -spec release_table(x_server(), x_table()) -> ok.
 release_table(Server, Table) ->
@@ -754,6 +1022,36 @@ delete_document(Server, DocIdOrUniqueTerm) ->
     call(Server, {delete_document, DocIdOrUniqueTerm}).
 
 
+%% @doc Run few commands using one call to the port.
+%% It is faster, than calling the same functions one by one.
+%%
+%% `Commands' is a list of:
+%% <ul> <li>
+%% `{add_document, Document}' - returns a document id (see `add_document/2');
+%% </li><li>
+%% `{delete_document, DocIdOrUniqueTerm}' - returns a boolean 
+%% (see `delete_document/2');
+%% </li><li>
+%% `{database_info, Params}' - see `database_info/2';
+%% </li><li>
+%% `{batch, Commands}' - batches cannot be nested, the result is always
+%% `#x_error{}'.
+%% </li></ul>
+%%
+%% Commands are executed in order. Results are returned in the same order.
+%% If a command fails, its result is `#x_error{}' and next commands are 
+%% still executed.
+-spec batch(x_server(), [BatchCommand]) -> [Result] when
+    BatchCommand :: {add_document, x_document_constructor()}
+                  | {delete_document, x_unique_document_id()}
+                  | {database_info, term()}
+                  | {batch, list()},
+    Result :: term().
+
+batch(Server, Commands) ->
+    call(Server, {batch, Commands}).
+
+
 %% @doc Return `true', if the document with a specified id exists.
 -spec is_document_exist(x_server(), x_unique_document_id()) -> boolean().
 
@@ -847,6 +1145,8 @@ internal_transaction_cancel(Server, Ref) ->
       | size
       | max_possible
       | max_attained
+      | is_truncated
+      | cursor
       | {term_weight, string_term()}
       | {term_freq, string_term()}.
 
@@ -867,7 +1167,9 @@ internal_transaction_cancel(Server, Ref) ->
       | {uncollapsed_matches_upper_bound, C}
       | {size, C}
       | {max_possible, W}
-      | {max_attained, W}.
+      | {max_attained, W}
+      | {is_truncated, boolean()}
+      | {cursor, binary() | undefined}.
 
 
 -type mset_info_result_pair2() ::
@@ -898,6 +1200,7 @@ mset_info(Server, MSetResource) ->
 %% </li><li> `size'; 
 %% </li><li> `max_possible'; 
 %% </li><li> `max_attained';
+%% </li><li> `cursor' (see `search_after' in {@link match_set/2});
 %% </li><li> `{term_weight, Term}';
 %% </li><li> `{term_freq, Term}'.
 %% </li></ul>
@@ -1234,10 +1537,20 @@ internal_qlc_init(Server, Type, ResourceRef, EncoderFun) ->
 %% @private
 -spec internal_qlc_get_next_portion(x_server(), 
     non_neg_integer(), non_neg_integer(), non_neg_integer()) ->
-    binary().
+    binary() | [binary()].
 
 internal_qlc_get_next_portion(Server, QlcResNum, From, Count) ->
-    call(Server, {qlc_next_portion, QlcResNum, From, Count}).
+    internal_qlc_get_next_portion(Server, QlcResNum, From, Count, infinity).
+
+
+%% @doc The same, but the scan is stopped, when `Timeout' is passed.
+%% @private
+-spec internal_qlc_get_next_portion(x_server(), 
+    non_neg_integer(), non_neg_integer(), non_neg_integer(), timeout()) ->
+    binary() | [binary()].
+
+internal_qlc_get_next_portion(Server, QlcResNum, From, Count, Timeout) ->
+    call(Server, {qlc_next_portion, QlcResNum, From, Count, Timeout}).
 
 
 %% @private
@@ -1327,9 +1640,13 @@ init([Path, Params]) ->
 
     %% Select an interface for communicate with the C-part.
     PortType = 
-        case lists:member(port, Params) of
-            true -> port;
-            false -> driver
+        case {lists:member(port, Params), lists:member(pipeline, Params),
+              lists:member(nif, Params), shm_type(Params)} of
+            {_, true, _, _} -> pipeline;
+            {_, _, _, ShmType} when ShmType =/= false -> ShmType;
+            {true, _, _, _} -> port;
+            {_, _, true, _} -> nif;
+            _ -> driver
         end,
     Port = xapian_port:open(PortType),
 
@@ -1388,6 +1705,36 @@ hc({with_state, Fun}, _From, State) ->
 hc({with_state, Fun, Params}, _From, State) ->
     {reply, Fun(State, Params), State};
 
+hc({resource_limits, Limits}, _From, State) ->
+    #state{ port = Port } = State,
+    Reply = port_resource_limits(Port, Limits),
+    {reply, Reply, State};
+
+hc({query_cache, Capacity}, _From, State) ->
+    #state{ port = Port } = State,
+    Reply = port_cache(Port, query_cache, Capacity),
+    {reply, Reply, State};
+
+hc({mset_cache, Capacity}, _From, State) ->
+    #state{ port = Port } = State,
+    Reply = port_cache(Port, mset_cache, Capacity),
+    {reply, Reply, State};
+
+hc({filter_cache, Limit}, _From, State) ->
+    #state{ port = Port } = State,
+    Reply = port_filter_cache(Port, Limit),
+    {reply, Reply, State};
+
+hc({shard_search, Settings}, _From, State) ->
+    #state{ port = Port } = State,
+    Reply = port_shard_search(Port, Settings),
+    {reply, Reply, State};
+
+hc(resource_info, _From, State) ->
+    #state{ port = Port } = State,
+    Reply = port_resource_info(Port),
+    {reply, Reply, State};
+
 hc(last_document_id, _From, State) ->
     #state{ port = Port } = State,
     Reply = port_last_document_id(Port),
@@ -1466,6 +1813,12 @@ hc({delete_document, Id}, _From, State) ->
     Reply = port_delete_document(Port, Id),
     {reply, Reply, State};
 
+hc({batch, Commands}, From, State) ->
+    #state{ port = Port } = State,
+    Items = [batch_item(Command, From, State) || Command <- Commands],
+    Reply = port_batch(Port, Items),
+    {reply, Reply, State};
+
 hc({set_metadata, Key, Value}, _From, State) ->
     #state{ port = Port } = State,
     Reply = port_set_metadata(Port, Key, Value),
@@ -1490,20 +1843,29 @@ hc({document_info, Document, Meta}, From, State) ->
                                Meta, Name2Slot, Id2Name, Slot2Type),
     {reply, Reply, State};
 
-hc({read_document_by_id, Id, Meta}, _From, State) ->
-    #state{ port = Port, name_to_slot = Name2Slot,
+hc({read_document_by_id, Id, Meta}, From, State) ->
+    #state{ name_to_slot = Name2Slot,
           subdb_names = Id2Name, slot_to_type = Slot2Type } = State,
-    Reply = port_read_document_by_id(Port, Id, 
-                                     Meta, Name2Slot, Id2Name, Slot2Type),
-    {reply, Reply, State};
+    Bin = encode_read_document_by_id(Id, Meta, Name2Slot, Slot2Type),
+    Decoder = fun(Res) -> decode_record_result(Res, Meta, Id2Name) end,
+    reply_control(read_document_by_id, Bin, Decoder, From, State);
 
-hc({query_page, Offset, PageSize, Query, Meta}, From, State) ->
-    #state{ port = Port, name_to_slot = Name2Slot,
+hc({query_page, Offset, PageSize, Query, Meta, Opts}, From, State) ->
+    #state{ name_to_slot = Name2Slot,
         subdb_names = Id2Name, slot_to_type = Slot2Type } = State,
     RA = resource_appender(State, From),
-    Reply = port_query_page(Port, Offset, PageSize, Query, 
-                            Meta, Name2Slot, Id2Name, Slot2Type, RA),
-    {reply, Reply, State};
+    Timeout = proplists:get_value(timeout, Opts, infinity),
+    Bin = encode_query_page(Offset, PageSize, Timeout, Query, 
+                            Meta, Name2Slot, Slot2Type, RA),
+    Decoder = fun(Res) -> decode_query_page_result(Res, Meta, Id2Name) end,
+    reply_control(query_page, Bin, Decoder, From, State);
+
+hc({count, Query, Opts}, From, State) ->
+    #state{ name_to_slot = Name2Slot, slot_to_type = Slot2Type } = State,
+    RA = resource_appender(State, From),
+    IsExact = proplists:get_value(exact, Opts, false),
+    Bin = encode_count(IsExact, Query, Name2Slot, Slot2Type, RA),
+    reply_control(count, Bin, fun decode_count_result/1, From, State);
 
 hc({enquire, Query}, {FromPid, _FromRef}, State) ->
     #state{ 
@@ -1541,7 +1903,9 @@ hc(#x_match_set{} = Mess, {FromPid, _FromRef}, State) ->
         offset = Offset, 
         max_items = MaxItems, 
         check_at_least = CheckAtLeast, 
-        spies = SpyRefs
+        spies = SpyRefs,
+        timeout = Timeout,
+        search_after = Cursor
     } = Mess, 
     %% Enquire is an enquire resource, its constructor, or just `#x_enquire{}'.
     EnquireRes = maybe_convert_enquire_record_into_constructor(Enquire, FromPid),
@@ -1556,7 +1920,7 @@ hc(#x_match_set{} = Mess, {FromPid, _FromRef}, State) ->
 
         MSetNum <-
             port_match_set(Port, EnquireRF, Offset, 
-                MaxItems, CheckAtLeast, SpyRFs),
+                MaxItems, CheckAtLeast, Cursor, Timeout, SpyRFs),
 
         register_resource(State, FromPid, MSetNum)]));
 
@@ -1625,9 +1989,9 @@ hc({qlc_lookup, EncoderFun, QlcResNum}, _From, State) ->
     {reply, Reply, State};
     
 
-hc({qlc_next_portion, QlcResNum, From, Count}, _From, State) ->
+hc({qlc_next_portion, QlcResNum, From, Count, Timeout}, _From, State) ->
     #state{port = Port } = State,
-    Reply = port_qlc_next_portion(Port, QlcResNum, From, Count),
+    Reply = port_qlc_next_portion(Port, QlcResNum, From, Count, Timeout),
     {reply, Reply, State};
 
 
@@ -1670,10 +2034,11 @@ hc({match_spy_info, MatchSpyRef, Params}, From, State) ->
     ]),
     {reply, Reply, State};
 
-hc({database_info, Params}, _From, State) ->
-    #state{port = Port, name_to_slot = N2S} = State,
-    Reply = port_database_info(Port, Params, N2S),
-    {reply, Reply, State};
+hc({database_info, Params}, From, State) ->
+    #state{name_to_slot = N2S} = State,
+    Bin = xapian_db_info:encode(Params, N2S, <<>>),
+    Decoder = fun(Res) -> decode_database_info_result(Res, Params) end,
+    reply_control(database_info, Bin, Decoder, From, State);
 
 hc({transaction, Ref}, From, State) ->
     #state{ port = Port } = State,
@@ -1742,8 +2107,35 @@ stop_if_error(Other) ->
     Other.
 
 
+%% @doc Return `shm', `{shm, Capacity}' or `false'.
+shm_type(Params) ->
+    case lists:keyfind(shm, 1, Params) of
+        {shm, _Capacity} = ShmType -> ShmType;
+        false -> lists:member(shm, Params) andalso shm
+    end.
+
+
 %% @private
 %% Ref is created for each process that uses resources.
+%% Replies on unknown requests (for example, on requests of a closed
+%% transaction copy of the server) are dropped.
+handle_info({Port, {data, _}} = Mess, State) when is_port(Port) ->
+    #state{port = PortRec} = State,
+    case xapian_port:parse_reply(PortRec, Mess) of
+        {ok, ReqId, Answer} ->
+            {noreply, reply_pending(ReqId, Answer, State)};
+        false ->
+            {noreply, State}
+    end;
+
+%% The port program is dead, pending requests will never be answered.
+handle_info({Port, {exit_status, Status}}, State) when is_port(Port) ->
+    #state{pending_requests = Pending} = State,
+    [gen_server:reply(From, {error, port_closed}) 
+     || {_ReqId, {From, _Operation, _Data, _Decoder}} <- dict:to_list(Pending)],
+    NewState = State#state{pending_requests = dict:new()},
+    {stop, {port_exit, Status}, NewState};
+
 handle_info(#'DOWN'{ref=Ref, type=process, id=ClientPid}, State) ->
     case run_erase_context(Ref, ClientPid, State) of
         {error, _Reason} ->
@@ -1858,6 +2250,26 @@ append_resource_access(UserResourceNumber, ParamBin, Bin@) ->
     <<Bin@/binary, ParamBin/binary>>.
 
 
+%% Encode a command of the batch.
+batch_item({add_document, Document}, From, State) ->
+    {add_document, document_encode(Document, From, State), 
+     fun decode_docid_result/1};
+
+batch_item({delete_document, Id}, _From, _State) ->
+    {delete_document, append_unique_document_id(Id, <<>>), 
+     fun decode_boolean_result/1};
+
+batch_item({database_info, Params}, _From, #state{name_to_slot = N2S}) ->
+    {database_info, xapian_db_info:encode(Params, N2S, <<>>),
+     fun(Res) -> decode_database_info_result(Res, Params) end};
+
+%% The driver rejects it, only this item fails.
+batch_item({batch, Commands}, From, State) ->
+    Items = [batch_item(Command, From, State) || Command <- Commands],
+    {batch, encode_batch(Items), 
+     fun(Res) -> decode_batch_result(Res, Items) end}.
+
+
 document_encode(Document, From, #state{
         name_to_prefix = Name2Prefix,
         name_to_slot = Name2Slot,
@@ -1891,8 +2303,86 @@ control(Port, Operation) ->
 
 
 control(Port, Operation, Data) ->
-    <<Status:8/native-unsigned-integer, Result/binary>> = 
-        xapian_port:control(Port, command_id(Operation), Data),
+    Answer = xapian_port:control(Port, command_id(Operation), Data),
+    decode_control_result(Operation, Data, Answer).
+
+
+%% @doc Run a long command without blocking the scheduler.
+async_control(Port, Operation, Data) ->
+    Answer = xapian_port:async_control(Port, command_id(Operation), Data),
+    decode_control_result(Operation, Data, Answer).
+
+
+%% @doc Run a read-only command and reply to the client.
+%% If the port is pipelined or the command is queued by the driver, 
+%% the server does not wait for the result:
+%% other requests can be handled meanwhile, the reply will be sent from
+%% `handle_info/2'.
+reply_control(Operation, Data, Decoder, From, State) ->
+    #state{port = Port, pending_requests = Pending} = State,
+    case is_pending_control(Port, Operation) of
+        true ->
+            ReqId = xapian_port:send_request(Port, command_id(Operation), Data),
+            Req = {From, Operation, Data, Decoder},
+            NewPending = dict:store(ReqId, Req, Pending),
+            {noreply, State#state{pending_requests = NewPending}};
+        false ->
+            Reply = Decoder(run_control(Port, Operation, Data)),
+            {reply, Reply, State}
+    end.
+
+
+is_pending_control(Port, Operation) ->
+    xapian_port:is_pipelined(Port) orelse
+    (xapian_port:is_async(Port) andalso is_long_command(Operation)).
+
+
+is_long_command(query_page) -> true;
+is_long_command(count)      -> true;
+is_long_command(_)          -> false.
+
+
+%% Only long commands are handled by the async thread pool of the driver.
+run_control(Port, query_page, Data) ->
+    async_control(Port, query_page, Data);
+
+run_control(Port, count, Data) ->
+    async_control(Port, count, Data);
+
+run_control(Port, Operation, Data) ->
+    control(Port, Operation, Data).
+
+
+%% @doc Decode the reply on the pipelined request and send it to the client.
+%% A late reply with an unknown id is ignored.
+reply_pending(ReqId, Answer, State) ->
+    #state{pending_requests = Pending} = State,
+    case dict:find(ReqId, Pending) of
+        {ok, {From, Operation, Data, Decoder}} ->
+            Reply = 
+                try
+                    Decoder(decode_control_result(Operation, Data, Answer))
+                catch Type:Reason:Trace ->
+                    {exception_migration, Type, Reason, Trace}
+                end,
+            gen_server:reply(From, Reply),
+            State#state{pending_requests = dict:erase(ReqId, Pending)};
+        error ->
+            State
+    end.
+
+
+%% Chunks of an async reply of the driver are passed to the decoder as is.
+decode_control_result(_Operation, _Data, 
+                      [<<0:8/native-unsigned-integer, Result/binary>> | Chunks]) ->
+    {ok, [Result | Chunks]};
+
+%% An error is short, it is never split.
+decode_control_result(Operation, Data, Chunks) when is_list(Chunks) ->
+    decode_control_result(Operation, Data, iolist_to_binary(Chunks));
+
+decode_control_result(Operation, Data, 
+                      <<Status:8/native-unsigned-integer, Result/binary>>) ->
     case Status of
         %% SUCCESS
         0 -> {ok, Result};
@@ -2077,6 +2567,24 @@ port_delete_document(Port, Id) ->
         control(Port, delete_document, append_unique_document_id(Id, <<>>))).
 
 
+%% `Items' is a list of `{Operation, EncodedParams, Decoder}'.
+port_batch(Port, Items) ->
+    decode_batch_result(control(Port, batch, encode_batch(Items)), Items).
+
+
+encode_batch(Items) ->
+    Bin@ = <<>>,
+    Bin@ = append_uint(length(Items), Bin@),
+    lists:foldl(fun append_batch_item/2, Bin@, Items).
+
+
+append_batch_item({Operation, Data, _Decoder}, Bin@) ->
+    Bin@ = append_uint(command_id(Operation), Bin@),
+    Bin@ = append_uint(byte_size(Data), Bin@),
+    Bin@ = append_binary(Data, Bin@),
+    Bin@.
+
+
 port_is_document_exist(Port, Id) ->
     decode_boolean_result(
         control(Port, is_document_exist, append_unique_document_id(Id, <<>>))).
@@ -2092,6 +2600,53 @@ port_set_metadata(Port, Key, Value) ->
 port_last_document_id(Port) ->
     decode_docid_result(control(Port, last_document_id)).
 
+port_resource_limits(Port, undefined) ->
+    Bin = append_uint8(0, <<>>),
+    decode_resource_limits_result(control(Port, resource_limits, Bin));
+
+port_resource_limits(Port, {MaxMemory, IdleTtl}) ->
+    Bin@ = append_uint8(1, <<>>),
+    Bin@ = append_uint(MaxMemory, Bin@),
+    Bin@ = append_uint(IdleTtl, Bin@),
+    decode_resource_limits_result(control(Port, resource_limits, Bin@)).
+
+port_cache(Port, Command, undefined) ->
+    Bin = append_uint8(0, <<>>),
+    decode_cache_result(control(Port, Command, Bin));
+
+port_cache(Port, Command, Capacity) ->
+    Bin@ = append_uint8(1, <<>>),
+    Bin@ = append_uint(Capacity, Bin@),
+    decode_cache_result(control(Port, Command, Bin@)).
+
+%% see Driver::filterCache
+port_filter_cache(Port, undefined) ->
+    Bin = append_uint8(0, <<>>),
+    decode_filter_cache_result(control(Port, filter_cache, Bin));
+
+port_filter_cache(Port, {capacity, Capacity}) ->
+    Bin@ = append_uint8(1, <<>>),
+    Bin@ = append_uint(Capacity, Bin@),
+    decode_filter_cache_result(control(Port, filter_cache, Bin@));
+
+port_filter_cache(Port, {max_memory, MaxMemory}) ->
+    Bin@ = append_uint8(2, <<>>),
+    Bin@ = append_uint(MaxMemory, Bin@),
+    decode_filter_cache_result(control(Port, filter_cache, Bin@)).
+
+port_shard_search(Port, undefined) ->
+    Bin = append_uint8(0, <<>>),
+    decode_shard_search_result(control(Port, shard_search, Bin));
+
+port_shard_search(Port, {ThreadCount, IsLocalWeights}) ->
+    Bin@ = append_uint8(1, <<>>),
+    Bin@ = append_uint(ThreadCount, Bin@),
+    Bin@ = append_boolean(IsLocalWeights, Bin@),
+    decode_shard_search_result(control(Port, shard_search, Bin@)).
+
+port_resource_info(Port) ->
+    decode_resource_info_result(control(Port, resource_info)).
+
 port_test(Port, echo, ValueBin) ->
     Num = test_id(echo),
     Bin@ = <<>>,
@@ -2108,6 +2663,23 @@ port_test(Port, result_encoder, [From, To]) ->
     Bin@ = append_document_id(To, Bin@),
     control(Port, test, Bin@);
 
+port_test(Port, result_growth, [MaxSegmentLen, ReserveLen, Count]) ->
+    Num = test_id(result_growth),
+    Bin@ = <<>>,
+    Bin@ = append_int8(Num, Bin@),
+    Bin@ = append_uint(MaxSegmentLen, Bin@),
+    Bin@ = append_uint(ReserveLen, Bin@),
+    Bin@ = append_uint(Count, Bin@),
+    decode_result_growth(control(Port, test, Bin@));
+
+port_test(Port, expired_deadline, [Term, MaxItems]) ->
+    Num = test_id(expired_deadline),
+    Bin@ = <<>>,
+    Bin@ = append_int8(Num, Bin@),
+    Bin@ = append_string(Term, Bin@),
+    Bin@ = append_uint(MaxItems, Bin@),
+    decode_expired_deadline(control(Port, test, Bin@));
+
 port_test(Port, Type, _) when Type =:= exception; Type =:= memory ->
     Num = test_id(Type),
     Bin = append_int8(Num, <<>>),
@@ -2115,6 +2687,25 @@ port_test(Port, Type, _) when Type =:= exception; Type =:= memory ->
 
 
 
+decode_result_growth({ok, Bin@}) ->
+    {Segments, Bin@} = read_uint(Bin@),
+    {Reserved, Bin@} = read_uint(Bin@),
+    {Size,     <<>>} = read_uint(Bin@),
+    {ok, [{segments, Segments}, {reserved, Reserved}, {size, Size}]};
+
+decode_result_growth(Other) ->
+    Other.
+
+
+decode_expired_deadline({ok, Bin@}) ->
+    {Size,        Bin@} = read_uint(Bin@),
+    {IsTruncated, <<>>} = xapian_common:read_boolean(Bin@),
+    {ok, [{size, Size}, {is_truncated, IsTruncated}]};
+
+decode_expired_deadline(Other) ->
+    Other.
+
+
 %% @doc Helper for port_*_transaction.
 replace_result(Value, {ok, <<>>}) -> 
     Value;
@@ -2138,12 +2729,11 @@ port_cancel_transaction(Port) ->
 
 
 %% @doc Read and decode one document from the port.
-port_read_document_by_id(Port, Id, Meta, Name2Slot, Id2Name, 
-                         Slot2Type) ->
+encode_read_document_by_id(Id, Meta, Name2Slot, Slot2Type) ->
     Bin@ = <<>>,
     Bin@ = append_document_id(Id, Bin@),
     Bin@ = xapian_record:encode(Meta, Name2Slot, Slot2Type, Bin@),
-    decode_record_result(control(Port, read_document_by_id, Bin@), Meta, Id2Name).
+    Bin@.
 
 
 port_document_info(Port, EncodedDocument, 
@@ -2156,14 +2746,22 @@ port_document_info_resource(Port, EncodedDocument) ->
     decode_resource_result(control(Port, document_info_resource, EncodedDocument)).
 
 
-port_query_page(Port, Offset, PageSize, Query, Meta, Name2Slot, Id2Name, 
-                Slot2Type, RA) ->
+encode_query_page(Offset, PageSize, Timeout, Query, Meta, 
+                  Name2Slot, Slot2Type, RA) ->
     Bin@ = <<>>,
     Bin@ = append_uint(Offset, Bin@),
     Bin@ = append_uint(PageSize, Bin@),
+    Bin@ = append_timeout(Timeout, Bin@),
     Bin@ = xapian_query:encode(Query, Name2Slot, Slot2Type, RA, Bin@),
     Bin@ = xapian_record:encode(Meta, Name2Slot, Slot2Type, Bin@),
-    decode_records_result(control(Port, query_page, Bin@), Meta, Id2Name).
+    Bin@.
+
+
+encode_count(IsExact, Query, Name2Slot, Slot2Type, RA) ->
+    Bin@ = <<>>,
+    Bin@ = append_boolean(IsExact, Bin@),
+    Bin@ = xapian_query:encode(Query, Name2Slot, Slot2Type, RA, Bin@),
+    Bin@.
 
 
 port_enquire(Port, Enquire, Name2Slot, Slot2TypeArray, RA) ->
@@ -2178,15 +2776,18 @@ port_document(Port, DocId) ->
     decode_resource_result(control(Port, document, Bin@)).
 
 
-port_match_set(Port, EnqRF, From, MaxItems, CheckAtLeast, SpyRFs) ->
+port_match_set(Port, EnqRF, From, MaxItems, CheckAtLeast, Cursor, Timeout, 
+               SpyRFs) ->
     Bin@ = <<>>,
     Bin@ = append_compiled_resource(EnqRF, Bin@),
     Bin@ = append_uint(From, Bin@),
     Bin@ = append_max_items(MaxItems, Bin@),
     Bin@ = append_uint(CheckAtLeast, Bin@),
+    Bin@ = append_cursor(Cursor, Bin@),
+    Bin@ = append_timeout(Timeout, Bin@),
     Bin@ = append_uint(length(SpyRFs), Bin@),
     Bin@ = lists:foldl(fun append_compiled_resource/2, Bin@, SpyRFs),
-    decode_resource_result(control(Port, match_set, Bin@)).
+    decode_resource_result(async_control(Port, match_set, Bin@)).
 
 
 port_parse_string(Port, RA, RR, QS, Fields) ->
@@ -2213,6 +2814,12 @@ append_max_items(MaxItems, Bin@)
 append_max_items(undefined, Bin@) ->
     append_uint8(1, Bin@).
 
+append_cursor(undefined, Bin) ->
+    append_string(<<>>, Bin);
+
+append_cursor(Cursor, Bin) when is_binary(Cursor) ->
+    append_string(Cursor, Bin).
+
 
 port_release_resource(Port, ResourceNum) ->
     Bin@ = <<>>,
@@ -2234,12 +2841,13 @@ port_release_resources(Port, ResourceNumbers) ->
     control(Port, release_resources, Bin@).
 
 
-port_qlc_next_portion(Port, QlcResNum, From, Count) ->
+port_qlc_next_portion(Port, QlcResNum, From, Count, Timeout) ->
     Bin@ = <<>>,
     Bin@ = append_resource_number(QlcResNum, Bin@),
     Bin@ = append_uint(From, Bin@),
     Bin@ = append_uint(Count, Bin@),
-    control(Port, qlc_next_portion, Bin@).
+    Bin@ = append_timeout(Timeout, Bin@),
+    async_control(Port, qlc_next_portion, Bin@).
 
 
 port_create_resource(Port, ParamBin) ->
@@ -2289,12 +2897,6 @@ port_match_spy_info(Port, MatchSpyNum, Params) ->
     Bin@ = xapian_spy_info:encode(Params, Bin@),
     decode_spy_info_result(control(Port, match_spy_info, Bin@), Params).
 
-port_database_info(Port, Params, N2S) ->
-    Bin@ = <<>>,
-    Bin@ = xapian_db_info:encode(Params, N2S, Bin@),
-    decode_database_info_result(control(Port, database_info, Bin@), Params).
-
-
 
 %% -----------------------------------------------------------------
 %% Helpers
@@ -2388,8 +2990,20 @@ decode_result_with_hof(Other, _Fn) ->
 decode_record_result(Data, Meta, I2N) ->
     decode_result_with_hof(Data, Meta, I2N, fun xapian_record:decode/3).
 
-decode_records_result(Data, Meta, I2N) ->
-    decode_result_with_hof(Data, Meta, I2N, fun xapian_record:decode_list/3).
+%% The list of records is prefixed with the truncation flag.
+decode_query_page_result(Data, Meta, I2N) ->
+    decode_result_with_hof(Data, Meta, I2N, fun decode_query_page/3).
+
+decode_query_page(Meta, I2N, [Bin@ | Chunks]) ->
+    {IsTruncated, Bin@} = xapian_common:read_boolean(Bin@),
+    {Recs, Bin@} = xapian_record:decode_list(Meta, I2N, [Bin@ | Chunks]),
+    case IsTruncated of
+        true  -> {{truncated, Recs}, Bin@};
+        false -> {Recs, Bin@}
+    end;
+
+decode_query_page(Meta, I2N, Bin) ->
+    decode_query_page(Meta, I2N, [Bin]).
 
 decode_mset_info_result(Data, Params) ->
     decode_result_with_hof(Data, Params, fun xapian_mset_info:decode/2).
@@ -2417,6 +3031,118 @@ decode_parse_string_result(Data, RR, Fields) ->
 
 
 
+decode_resource_limits_result({ok, Bin@}) ->
+    {MaxMemory,       Bin@} = read_uint(Bin@),
+    {IdleTtl,         Bin@} = read_uint(Bin@),
+    {Count,           Bin@} = read_uint(Bin@),
+    {Memory,          Bin@} = read_uint(Bin@),
+    {EvictedByBudget, Bin@} = read_uint(Bin@),
+    {EvictedByTtl,    <<>>} = read_uint(Bin@),
+    {ok, [{max_memory, MaxMemory}, {idle_ttl, IdleTtl},
+          {count, Count}, {memory, Memory},
+          {evicted_by_budget, EvictedByBudget},
+          {evicted_by_ttl, EvictedByTtl}]};
+
+decode_resource_limits_result(Other) ->
+    Other.
+
+
+decode_cache_result({ok, Bin@}) ->
+    {Capacity,  Bin@} = read_uint(Bin@),
+    {Size,      Bin@} = read_uint(Bin@),
+    {Hits,      Bin@} = read_uint(Bin@),
+    {Misses,    Bin@} = read_uint(Bin@),
+    {Evictions, <<>>} = read_uint(Bin@),
+    {ok, [{capacity, Capacity}, {size, Size}, {hits, Hits},
+          {misses, Misses}, {evictions, Evictions}]};
+
+decode_cache_result(Other) ->
+    Other.
+
+
+decode_filter_cache_result({ok, Bin@}) ->
+    {Capacity,  Bin@} = read_uint(Bin@),
+    {Size,      Bin@} = read_uint(Bin@),
+    {Hits,      Bin@} = read_uint(Bin@),
+    {Misses,    Bin@} = read_uint(Bin@),
+    {Evictions, Bin@} = read_uint(Bin@),
+    {Memory,    Bin@} = read_uint(Bin@),
+    {MaxMemory, <<>>} = read_uint(Bin@),
+    {ok, [{capacity, Capacity}, {size, Size}, {hits, Hits},
+          {misses, Misses}, {evictions, Evictions}, {memory, Memory},
+          {max_memory, MaxMemory}]};
+
+decode_filter_cache_result(Other) ->
+    Other.
+
+
+decode_shard_search_result({ok, Bin@}) ->
+    {ThreadCount, Bin@}     = read_uint(Bin@),
+    {ShardCount,  Bin@}     = read_uint(Bin@),
+    {IsLocalWeights, Bin@}  = xapian_common:read_boolean(Bin@),
+    {SearchCount, <<>>}     = read_uint(Bin@),
+    {ok, [{threads, ThreadCount}, {shards, ShardCount}, 
+          {local_weights, IsLocalWeights}, {searches, SearchCount}]};
+
+decode_shard_search_result(Other) ->
+    Other.
+
+
+decode_count_result({ok, Bin@}) ->
+    {Lower,     Bin@} = read_uint(Bin@),
+    {Estimated, Bin@} = read_uint(Bin@),
+    {Upper,     <<>>} = read_uint(Bin@),
+    {ok, [{matches_lower_bound, Lower}, {matches_estimated, Estimated},
+          {matches_upper_bound, Upper}]};
+
+decode_count_result(Other) ->
+    Other.
+
+
+decode_resource_info_result({ok, Bin@}) ->
+    {OldestAge, Bin@} = read_uint(Bin@),
+    {TypeCount, Bin@} = read_uint(Bin@),
+    {Types,     <<>>} = read_resource_types(TypeCount, Bin@, []),
+    {ok, [{oldest_age, OldestAge}, {types, Types}]};
+
+decode_resource_info_result(Other) ->
+    Other.
+
+
+read_resource_types(0, Bin, Acc) ->
+    {lists:reverse(Acc), Bin};
+
+read_resource_types(N, Bin@, Acc) ->
+    {Name,  Bin@} = read_string(Bin@),
+    {Count, Bin@} = read_uint(Bin@),
+    {Bytes, Bin@} = read_uint(Bin@),
+    read_resource_types(N - 1, Bin@, [{Name, Count, Bytes}|Acc]).
+
+
+decode_batch_result({ok, Bin}, Items) ->
+    {Count, Bin1} = read_uint(Bin),
+    Count = length(Items),
+    {ok, decode_batch_items(Items, Bin1)};
+
+decode_batch_result(Other, _Items) ->
+    Other.
+
+
+%% Each sub-result has its own status.
+decode_batch_items([{Operation, Data, Decoder}|Items], Bin) ->
+    {Len, Bin1} = read_uint(Bin),
+    <<SubBin:Len/binary, Bin2/binary>> = Bin1,
+    Result = 
+        case Decoder(decode_control_result(Operation, Data, SubBin)) of
+            {ok, Value} -> Value;
+            {error, Reason} -> Reason
+        end,
+    [Result | decode_batch_items(Items, Bin2)];
+
+decode_batch_items([], <<>>) ->
+    [].
+
+
 decode_qlc_info_result({ok, Bin@}) -> 
     {ResNum, Bin@} = read_uint(Bin@),
     {Size,   <<>>} = read_uint(Bin@),
@@ -49,8 +49,48 @@ add_empty_document_benchmark(N) ->
 
 
 add_nonempty_document_benchmark(N) ->
-    Path = testdb_path(add_doc_bm),
-    Params = [write, create, overwrite],
+    add_nonempty_document(N, driver).
+
+
+simple_query_benchmark(N) ->
+    simple_query(N, driver).
+
+
+%% The same workloads through other transports.
+%% `driver' is serialized by the port lock, `port' copies data through pipes,
+%% `nif' runs commands on dirty schedulers of the calling process.
+add_nonempty_document_port_benchmark(N) ->
+    add_nonempty_document(N, port).
+
+add_nonempty_document_nif_benchmark(N) ->
+    add_nonempty_document(N, nif).
+
+simple_query_port_benchmark(N) ->
+    simple_query(N, port).
+
+simple_query_nif_benchmark(N) ->
+    simple_query(N, nif).
+
+driver_echo_benchmark(N) ->
+    echo(N, driver).
+
+nif_echo_benchmark(N) ->
+    echo(N, nif).
+
+nif_large_reply_benchmark(N) ->
+    large_reply(N, nif).
+
+%% The port program with shared memory rings.
+shm_echo_benchmark(N) ->
+    echo(N, shm).
+
+shm_large_reply_benchmark(N) ->
+    large_reply(N, shm).
+
+
+add_nonempty_document(N, Transport) ->
+    Path = testdb_path(bm_name(add_doc_bm, Transport)),
+    Params = [write, create, overwrite | transport_params(Transport)],
     {ok, Server} = ?SRV:open(Path, Params),
     emark:start(?SRV, add_document, 2),
     [ ?SRV:add_document(Server, [#x_text{value="haskell erlang scala"}]) 
@@ -59,9 +99,9 @@ add_nonempty_document_benchmark(N) ->
     ok.
 
 
-simple_query_benchmark(N) ->
-    Path = testdb_path(simple_query_bm),
-    Params = [write, create, overwrite],
+simple_query(N, Transport) ->
+    Path = testdb_path(bm_name(simple_query_bm, Transport)),
+    Params = [write, create, overwrite | transport_params(Transport)],
     {ok, Server} = ?SRV:open(Path, Params),
     %% Add 1000 documents.
     [ ?SRV:add_document(Server, [#x_term{value=integer_to_list(X)}]) 
@@ -75,4 +115,115 @@ simple_query_benchmark(N) ->
     ok.
 
 
+-record(page_record, {docid, data}).
+
+%% QUERY_PAGE with 100 results per call.
+%% The reply (about 100 records with data) does not fit into the default
+%% buffer, so each call allocates result segments.
+query_page_benchmark(N) ->
+    query_page(N, driver).
+
+query_page_port_benchmark(N) ->
+    query_page(N, port).
+
+query_page_nif_benchmark(N) ->
+    query_page(N, nif).
+
+
+query_page(N, Transport) ->
+    Path = testdb_path(bm_name(query_page_bm, Transport)),
+    Params = [write, create, overwrite | transport_params(Transport)],
+    {ok, Server} = ?SRV:open(Path, Params),
+    Data = binary:copy(<<"x">>, 50),
+    [ ?SRV:add_document(Server, [#x_term{value="all"}, #x_data{value=Data}]) 
+        || _ <- lists:seq(1, 1000) ],
+    Meta = xapian_record:record(page_record, record_info(fields, page_record)),
+
+    emark:start(?SRV, query_page, 5),
+    [ 100 = length(?SRV:query_page(Server, 0, 100, "all", Meta))
+        || _ <- lists:seq(1, N) ],
+%   ?SRV:close(Server),
+    ok.
+
+
+%% ENQUIRE with a 1000-term query.
+%% The match is not run: decoding of terms and building of the query dominate.
+large_query_benchmark(N) ->
+    Path = testdb_path(large_query_bm),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:open(Path, Params),
+    Terms = [integer_to_list(X) || X <- lists:seq(1, 1000)],
+    Query = #x_query{op = 'OR', value = Terms},
+    emark:start(?SRV, enquire, 2),
+    [ ?SRV:release_resource(Server, ?SRV:enquire(Server, Query)) 
+        || _ <- lists:seq(1, N) ],
+%   ?SRV:close(Server),
+    ok.
+
+
+%% Create, extract and release resources, while 100k resources are alive.
+%% Each step creates a weight, uses it by reference for an Enquire and
+%% releases both.
+resource_churn_benchmark(N) ->
+    Path = testdb_path(resource_churn_bm),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:open(Path, Params),
+    Con = xapian_resource:bool_weight(),
+    _Live = [ ?SRV:create_resource(Server, Con) || _ <- lists:seq(1, 100000) ],
+    emark:start(?SRV, release_resource, 2),
+    [ resource_churn_step(Server, Con) || _ <- lists:seq(1, N) ],
+%   ?SRV:close(Server),
+    ok.
+
+
+resource_churn_step(Server, Con) ->
+    Weight = ?SRV:create_resource(Server, Con),
+    Enquire = ?SRV:enquire(Server, 
+        #x_enquire{value = "term", weighting_scheme = Weight}),
+    ?SRV:release_resource(Server, Enquire),
+    ?SRV:release_resource(Server, Weight).
+
+
+%% These benchmarks measure the I/O loop of the port program.
+%% Run them under `strace -c -f' to count system calls per request.
+port_echo_benchmark(N) ->
+    echo(N, port).
+
+
+%% An extended result: about 200Kb are encoded in few segments.
+port_large_reply_benchmark(N) ->
+    large_reply(N, port).
+
+
+echo(N, Transport) ->
+    Path = testdb_path(bm_name(echo_bm, Transport)),
+    Params = [write, create, overwrite | transport_params(Transport)],
+    {ok, Server} = ?SRV:open(Path, Params),
+    Bin = binary:copy(<<"x">>, 100),
+    emark:start(?SRV, internal_test_run, 3),
+    [ ?SRV:internal_test_run(Server, echo, Bin) || _ <- lists:seq(1, N) ],
+%   ?SRV:close(Server),
+    ok.
+
+
+large_reply(N, Transport) ->
+    Path = testdb_path(bm_name(large_reply_bm, Transport)),
+    Params = [write, create, overwrite | transport_params(Transport)],
+    {ok, Server} = ?SRV:open(Path, Params),
+    emark:start(?SRV, internal_test_run, 3),
+    [ ?SRV:internal_test_run(Server, result_encoder, [1, 50000]) 
+        || _ <- lists:seq(1, N) ],
+%   ?SRV:close(Server),
+    ok.
+
+
+%% Servers are not closed, each transport writes its own database.
+bm_name(Name, Transport) ->
+    atom_to_list(Name) ++ "_" ++ atom_to_list(Transport).
+
+
+transport_params(driver) -> [];
+transport_params(Transport) -> [Transport].
+
+
 -endif.
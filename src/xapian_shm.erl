@@ -0,0 +1,39 @@
+%% @doc Shared memory rings for the `shm' port type.
+%% The port program maps the same file with the `--shm Path' argument.
+%% Only the owner of the port can use the rings.
+-module(xapian_shm).
+-export([create/2,
+         write_request/3,
+         read_reply/1,
+         close/1]).
+
+-on_load(init/0).
+
+-define(NIF_NAME, "xapian_shm").
+
+
+%% @doc Find and load the so file.
+init() ->
+    PrivDir = code:priv_dir(xapian),
+    erlang:load_nif(filename:join(PrivDir, ?NIF_NAME), 0).
+
+
+%% @doc Create a file with two rings of `Capacity' bytes each.
+create(_Path, _Capacity) ->
+    erlang:nif_error(nif_not_loaded).
+
+
+%% @doc Copy the request into the ring. 
+%% Return false, if there is not enough free space.
+write_request(_Rings, _Command, _Data) ->
+    erlang:nif_error(nif_not_loaded).
+
+
+%% @doc Copy the oldest reply out of the ring.
+read_reply(_Rings) ->
+    erlang:nif_error(nif_not_loaded).
+
+
+%% @doc Unmap and delete the file.
+close(_Rings) ->
+    erlang:nif_error(nif_not_loaded).
@@ -275,6 +275,10 @@ document_term_table(Server, DocId, Meta, UserParams) ->
 %% {page_size, non_neg_integer()}
 %% </li><li>
 %% {from, non_neg_integer()}
+%% </li><li>
+%% {timeout, timeout()} - the time budget of one portion in milliseconds.
+%% If it is spent, a shorter portion is returned and the scan continues
+%% with the next call.
 %% </li></ul>
 %%
 %% IterRes stands for an iterable resource (Document or MatchSpy).
@@ -340,7 +344,8 @@ init_not_empty_table(Server, Info, Meta, UserParams, SortedValue) ->
     KeyName = xapian_term_record:field_position_to_name(Meta, KeyPos),
     From = proplists:get_value(from, UserParams, 0),
     Len = proplists:get_value(page_size, UserParams, 20),
-    TraverseFun = traverse_fun(Server, ResNum, Meta, From, Len, Size),
+    Timeout = proplists:get_value(timeout, UserParams, infinity),
+    TraverseFun = traverse_fun(Server, ResNum, Meta, From, Len, Size, Timeout),
     TableId = xapian_qlc_table_hash:get_table_id(),
     InfoFun = 
     fun(num_of_objects) -> Size;
@@ -370,13 +375,23 @@ lookup_fun(Server, ResNum, Meta, KeyPos, KeyName) ->
 
 %% Maximum `Len' records can be retrieve for a call.
 %% `From' records will be skipped from the beginning of the collection.
-traverse_fun(Server, ResNum, Meta, From, Len, TotalLen) ->
+traverse_fun(Server, ResNum, Meta, From, Len, TotalLen, Timeout) ->
     fun() ->
-        Bin = xapian_server:internal_qlc_get_next_portion(Server, ResNum, From, Len),
-        NextFrom = From+Len,
-        MoreFun = traverse_fun(Server, ResNum, Meta, NextFrom, Len, TotalLen),
-        {Records, <<>>} = xapian_term_record:decode_list3(Meta, Bin),
+        Reply = xapian_server:internal_qlc_get_next_portion(Server, ResNum, 
+                                                            From, Len, Timeout),
+        %% Terms are not aligned by chunks, chunks of the reply are merged.
+        Bin = iolist_to_binary(Reply),
+        {Records, IsPaused, <<>>} = xapian_term_record:decode_page(Meta, Bin),
+        %% A paused portion is shorter, the next one starts after it.
+        NextFrom = case IsPaused of
+                       true  -> From + length(Records);
+                       false -> From + Len
+                   end,
+        MoreFun = traverse_fun(Server, ResNum, Meta, NextFrom, Len, TotalLen, 
+                               Timeout),
         if
+            IsPaused ->
+                lists:reverse(lists:reverse(Records), MoreFun);
             %% Last group of records of the iterator with unknown size
             TotalLen =:= undefined andalso length(Records) < Len ->
                 Records;
@@ -1,18 +1,20 @@
 %% It contains helpers for extracting.
 -module(xapian_term_record).
 -export([record/2, 
+        record/3, 
         encoder/2,
         encode/2, 
         decode/2, 
         decode_list/2, 
         decode_list2/2,
-        decode_list3/2]).
+        decode_list3/2,
+        decode_page/2]).
 -export([key_position/1,
          field_position_to_name/2,
          fix_spy_meta/3]).
 
 -compile({parse_transform, seqbind}).
--record(rec, {name, fields}).
+-record(rec, {name, fields, is_compact = false}).
 -import(xapian_common, [ 
     append_uint8/2,
     read_document_count/1,
@@ -21,6 +23,9 @@
     read_double/1,
     read_position_list/1,
     read_uint8/1,
+    read_varint/1,
+    read_compact_string/1,
+    read_compact_position_list/1,
     index_one_of/2]).
 
 -import(xapian_const, [term_field_id/1]).
@@ -88,6 +93,13 @@ record(TupleName, TupleFields) ->
     #rec{name=TupleName, fields=TupleFields}.
 
 
+%% @doc The same as `record/2', but with options:
+%% `compact' - counts and lengths are varints, positions are delta-coded.
+record(TupleName, TupleFields, Opts) ->
+    #rec{name=TupleName, fields=TupleFields, 
+         is_compact=lists:member(compact, Opts)}.
+
+
 key_position(#rec{fields=TupleFields}) ->
     case index_one_of([value, float_value], TupleFields) of
     not_found -> undefined;
@@ -126,15 +138,21 @@ elem_at_test_() ->
 
 %% Creates tuples {Name, Field1, ....}
 encode(Meta, Bin) ->
-    #rec{fields=TupleFields} = Meta,
-    enc(TupleFields, Bin).
+    #rec{fields=TupleFields, is_compact=IsCompact} = Meta,
+    case IsCompact of
+        false -> enc(TupleFields, Bin);
+        true  -> enc(TupleFields, append_type(compact, Bin))
+    end.
 
 
 -spec decode(term(), binary()) -> {term(), binary()}.
 
 decode(Meta, Bin) ->
-    #rec{name=TupleName, fields=TupleFields} = Meta,
-    dec(TupleFields, Bin, [TupleName]).
+    #rec{name=TupleName, fields=TupleFields, is_compact=IsCompact} = Meta,
+    case IsCompact of
+        false -> dec(TupleFields, Bin, [TupleName]);
+        true  -> dec_compact(TupleFields, Bin, [TupleName])
+    end.
 
 
 %% The count is known.
@@ -149,15 +167,38 @@ decode_list2(Meta, Bin) ->
 
 
 %% The count can be known or not.
-decode_list3(Meta, Bin@) ->
+decode_list3(Meta, Bin) ->
+    {Records, _IsPaused, RemBin} = decode_page(Meta, Bin),
+    {Records, RemBin}.
+
+
+%% @doc Decode a portion of a QLC table.
+%% `IsPaused' is true, if the portion was cut by the deadline 
+%% and more records can follow.
+decode_page(Meta, Bin@) ->
     %% see QlcTable::UNKNOWN_SIZE (0), KNOWN_SIZE (1)
     {Flag, Bin@} = read_uint8(Bin@),
     %% Select an encoding  schema
     case Flag of
         0 -> 
-            decode_list2(Meta, Bin@);
+            decode_page2(Meta, Bin@, []);
         1 -> 
-            decode_list(Meta, Bin@)
+            {Records, Bin@} = decode_list(Meta, Bin@),
+            {Records, false, Bin@}
+    end.
+
+
+decode_page2(Meta, Bin@, Acc) ->
+    {Flag, Bin@} = read_uint8(Bin@),
+    %% see QlcTable::MORE, QlcTable::STOP and QlcTable::PAUSE
+    case Flag of
+        1 -> 
+            {Rec, Bin@} = decode(Meta, Bin@),
+            decode_page2(Meta, Bin@, [Rec|Acc]);
+        0 -> 
+            {lists:reverse(Acc), false, Bin@};
+        2 -> 
+            {lists:reverse(Acc), true, Bin@}
     end.
 
 
@@ -215,3 +256,20 @@ dec([H|T], Bin, Acc) ->
 
 dec([], Rem, Acc) -> 
     {erlang:list_to_tuple(lists:reverse(Acc)), Rem}.
+
+
+%% Integers and lengths are varints, see `FieldEncoder'.
+dec_compact([H|T], Bin, Acc) ->
+    {Val, NewBin} =
+        case H of
+            freq        -> read_varint(Bin);    
+            wdf         -> read_varint(Bin); 
+            value       -> read_compact_string(Bin);
+            float_value -> read_double(Bin);
+            positions   -> read_compact_position_list(Bin);
+            position_count -> read_varint(Bin)
+        end,
+    dec_compact(T, NewBin, [Val|Acc]);
+
+dec_compact([], Rem, Acc) -> 
+    {erlang:list_to_tuple(lists:reverse(Acc)), Rem}.
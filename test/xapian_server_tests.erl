@@ -53,6 +53,31 @@ result_encoder_test() ->
     ok.
     
 
+%% @doc Segments of `ResultEncoder' grow from 1KB twice at once until
+%% the ceiling. A reservation is limited by the ceiling too.
+result_growth_test() ->
+    {ok, Server} = ?SRV:start_link([], []),
+    try
+        %% 16 bytes are in the buffer, 1024 * (2^9 - 1) in 9 segments.
+        Growth = ?SRV:internal_test_run(Server, result_growth, 
+                                        [1048576, 0, 100000]),
+        %% 1024 + 2048, then 97 segments of 4096 bytes.
+        Ceiling = ?SRV:internal_test_run(Server, result_growth, 
+                                         [4096, 0, 100000]),
+        %% A huge reservation gets one segment of the ceiling length.
+        Reserved = ?SRV:internal_test_run(Server, result_growth, 
+                                          [4096, 100000000, 1000]),
+        ?assertEqual([{segments, 9}, {reserved, 523264}, {size, 400000}],
+                     Growth),
+        ?assertEqual([{segments, 99}, {reserved, 400384}, {size, 400000}],
+                     Ceiling),
+        ?assertEqual([{segments, 1}, {reserved, 4096}, {size, 4000}],
+                     Reserved)
+    after
+        ?SRV:close(Server)
+    end.
+
+
 %% @doc Check an exception.
 exception_test() ->
     {ok, Server} = ?SRV:start_link([], []),
@@ -2570,6 +2595,735 @@ metadata_gen() ->
     ].
 
 
+batch_gen() ->
+    Path = testdb_path(batch),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Doc = [#x_term{value = "batch"}],
+        [Id1, Id2, Id3, Count1] = 
+            ?SRV:batch(Server, [{add_document, Doc}, 
+                                {add_document, Doc}, 
+                                {add_document, Doc},
+                                {database_info, document_count}]),
+        [Deleted, NotFound, Count2] = 
+            ?SRV:batch(Server, [{delete_document, Id2},
+                                {delete_document, Id2},
+                                {database_info, document_count}]),
+        %% The docid 0 is invalid, the error does not stop the batch.
+        [Id4, Failed, Id5, Count3] = 
+            ?SRV:batch(Server, [{add_document, Doc}, 
+                                {delete_document, 0},
+                                {add_document, Doc},
+                                {database_info, document_count}]),
+        %% A nested batch fails, but the outer batch goes on.
+        [Id6, Nested, Count4] = 
+            ?SRV:batch(Server, [{add_document, Doc}, 
+                                {batch, [{add_document, Doc}]},
+                                {database_info, document_count}]),
+        Empty = ?SRV:batch(Server, []),
+        [ ?_assertEqual([1, 2, 3], [Id1, Id2, Id3])
+        , ?_assertEqual(3, Count1)
+        , ?_assert(Deleted)
+        , ?_assertNot(NotFound)
+        , ?_assertEqual(2, Count2)
+        , ?_assertEqual([4, 5], [Id4, Id5])
+        , ?_assertMatch(#x_error{type = <<"InvalidArgumentError">>}, Failed)
+        , ?_assertEqual(4, Count3)
+        , ?_assertEqual(6, Id6)
+        , ?_assertMatch(#x_error{type = <<"BadCommandDriverError">>}, Nested)
+        , ?_assertEqual(5, Count4)
+        , ?_assertEqual([], Empty)
+        ]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+%% Long commands (query_page) are handled by the async thread pool,
+%% short commands (database_info) are handled on the scheduler thread.
+async_query_page_gen() ->
+    Path = testdb_path(async_query_page),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        [?SRV:add_document(Server, [#x_term{value = "async"}])
+         || _ <- lists:seq(1, 50)],
+        Meta = xapian_record:record(document, record_info(fields, document)),
+        Query = "async",
+        Parent = self(),
+        Worker = fun() ->
+            Recs  = ?SRV:query_page(Server, 0, 100, Query, Meta),
+            Count = ?SRV:database_info(Server, document_count),
+            Parent ! {async_query_page, length(Recs), Count}
+            end,
+        [spawn_link(Worker) || _ <- lists:seq(1, 10)],
+        Results = [receive {async_query_page, L, C} -> {L, C} end
+                   || _ <- lists:seq(1, 10)],
+        [?_assertEqual(lists:duplicate(10, {50, 50}), Results)]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+%% Long queries are queued by the driver, while the server handles
+%% synchronous commands. A write, that follows queued or running jobs,
+%% is queued after them.
+async_sync_mix_gen() ->
+    Path = testdb_path(async_sync_mix),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        [?SRV:add_document(Server, [#x_term{value = "mix"}])
+         || _ <- lists:seq(1, 1000)],
+        Meta = xapian_record:record(document, record_info(fields, document)),
+        Parent = self(),
+        Reader = fun() ->
+            Lens = [length(?SRV:query_page(Server, 0, 2000, "mix", Meta))
+                    || _ <- lists:seq(1, 5)],
+            Parent ! {mix_reader, Lens}
+            end,
+        Writer = fun() ->
+            DocIds = [?SRV:add_document(Server, [#x_term{value = "mix"}])
+                      || _ <- lists:seq(1, 100)],
+            Count = ?SRV:database_info(Server, document_count),
+            Parent ! {mix_writer, DocIds, Count}
+            end,
+        [spawn_link(Reader) || _ <- lists:seq(1, 10)],
+        spawn_link(Writer),
+        Lens = lists:append([receive {mix_reader, L} -> L end
+                             || _ <- lists:seq(1, 10)]),
+        {DocIds, Count} = receive {mix_writer, D, C} -> {D, C} end,
+        Final = length(?SRV:query_page(Server, 0, 2000, "mix", Meta)),
+
+        %% A write, that follows a queued query, is not seen by the query.
+        Before = spawn_link(fun() ->
+            Parent ! {mix_before, 
+                      length(?SRV:query_page(Server, 0, 2000, "mix", Meta))}
+            end),
+        wait_for_call(Before),
+        ?SRV:add_document(Server, [#x_term{value = "mix"}]),
+        BeforeLen = receive {mix_before, BL} -> BL end,
+        IsValidLen = fun(L) -> L >= 1000 andalso L =< 1100 end,
+        [?_assertEqual(lists:seq(1001, 1100), DocIds)
+        ,?_assertEqual(1100, Count)
+        ,?_assertEqual(50, length(Lens))
+        ,?_assert(lists:all(IsValidLen, Lens))
+        ,?_assertEqual(1100, Final)
+        ,?_assertEqual(1100, BeforeLen)
+        ]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+%% Wait, while the process sends a call and waits for the reply.
+wait_for_call(Pid) ->
+    case erlang:process_info(Pid, status) of
+        {status, waiting} -> ok;
+        _ -> timer:sleep(1), wait_for_call(Pid)
+    end.
+
+
+%% Read-only requests are handled concurrently by the pipelined port.
+pipeline_gen() ->
+    Path = testdb_path(pipeline),
+    {ok, Writer} = ?SRV:start_link(Path, [write, create, overwrite]),
+    [?SRV:add_document(Writer, [#x_term{value = "pipeline"}])
+     || _ <- lists:seq(1, 20)],
+    ?SRV:close(Writer),
+
+    {ok, Server} = ?SRV:start_link(Path, [read, pipeline]),
+    try
+        Meta = xapian_record:record(document, record_info(fields, document)),
+        Parent = self(),
+        Worker = fun() ->
+            Recs  = ?SRV:query_page(Server, 0, 100, "pipeline", Meta),
+            Count = ?SRV:database_info(Server, document_count),
+            Parent ! {pipeline, length(Recs), Count}
+            end,
+        [spawn_link(Worker) || _ <- lists:seq(1, 10)],
+        Results = [receive {pipeline, L, C} -> {L, C} end
+                   || _ <- lists:seq(1, 10)],
+
+        %% Each worker has its own MSet cache, so a repeated query misses
+        %% at most once per worker. The port runs a worker per CPU.
+        Info0 = ?SRV:set_mset_cache_capacity(Server, 16),
+        Repeats = erlang:system_info(logical_processors_online) + 1,
+        [?SRV:query_page(Server, 0, 100, "pipeline", Meta)
+         || _ <- lists:seq(1, Repeats)],
+        Info1 = ?SRV:mset_cache_info(Server),
+        Delta = fun(Key) -> proplists:get_value(Key, Info1) 
+                          - proplists:get_value(Key, Info0) end,
+        [?_assertEqual(lists:duplicate(10, {20, 20}), Results)
+        ,?_assertEqual(16, proplists:get_value(capacity, Info1))
+        ,?_assertEqual(Repeats, Delta(hits) + Delta(misses))
+        ,?_assert(Delta(hits) >= 1)
+        ]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+%% A reply on an unknown request is dropped.
+%% The server stops, when the port program dies.
+pipeline_port_exit_test() ->
+    Path = testdb_path(pipeline_port_exit),
+    {ok, Writer} = ?SRV:start_link(Path, [write, create, overwrite]),
+    ?SRV:close(Writer),
+
+    OldTrapExit = process_flag(trap_exit, true),
+    {ok, Server} = ?SRV:start_link(Path, [read, pipeline]),
+    try
+        [Port] = [P || P <- erlang:ports(), 
+                       erlang:port_info(P, connected) =:= {connected, Server}],
+        Server ! {Port, {data, <<16#FFFFFFFF:32/unsigned-native-integer, 0>>}},
+        ?assertEqual(0, ?SRV:database_info(Server, document_count)),
+
+        {os_pid, OsPid} = erlang:port_info(Port, os_pid),
+        os:cmd("kill -9 " ++ integer_to_list(OsPid)),
+        receive
+            {'EXIT', Server, Reason} ->
+                ?assertMatch({port_exit, _}, Reason)
+        after 5000 ->
+                erlang:error(server_is_alive)
+        end
+    after
+        process_flag(trap_exit, OldTrapExit)
+    end.
+
+
+%% Each server owns its own NIF resource with an independent Driver.
+nif_gen() ->
+    Path = testdb_path(nif),
+    {ok, Server} = ?SRV:start_link(Path, [write, create, overwrite, nif]),
+    try
+        DocId = ?SRV:add_document(Server, [#x_term{value = "nif"}]),
+        Meta = xapian_record:record(document, record_info(fields, document)),
+        Recs = ?SRV:query_page(Server, 0, 10, "nif", Meta),
+        Count = ?SRV:database_info(Server, document_count),
+        [?_assertEqual([#document{docid = DocId}], Recs)
+        ,?_assertEqual(1, Count)]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+-record(large_data, {docid, data}).
+
+%% A large data value gets its own segment, that is passed to the VM by
+%% reference. Chunks of the reply are not merged: each value is 
+%% a sub-binary of a chunk, which is shorter than the whole reply.
+large_data_gen() ->
+    Path = testdb_path(large_data),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Data = binary:copy(<<"0123456789">>, 10000),
+        [?SRV:add_document(Server, [#x_term{value = "large"}, 
+                                    #x_data{value = Data}])
+         || _ <- lists:seq(1, 3)],
+        Meta = xapian_record:record(large_data, 
+                                    record_info(fields, large_data)),
+        Recs = ?SRV:query_page(Server, 0, 10, "large", Meta),
+        Refs = [binary:referenced_byte_size(D) || #large_data{data=D} <- Recs],
+        [ ?_assertEqual(3, length(Recs))
+        , ?_assertEqual([Data, Data, Data], [D || #large_data{data=D} <- Recs])
+        , ?_assert(lists:all(fun(Ref) -> Ref < 3 * byte_size(Data) end, Refs))
+        ]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+%% Small replies are passed through the ring, a large one through the pipe.
+shm_gen() ->
+    Path = testdb_path(shm),
+    {ok, Server} = ?SRV:start_link(Path, [write, create, overwrite, shm]),
+    try
+        Data = binary:copy(<<"0123456789">>, 200000),
+        [?SRV:add_document(Server, [#x_term{value = "shm"}, 
+                                    #x_data{value = Data}])
+         || _ <- lists:seq(1, 3)],
+        Meta = xapian_record:record(large_data, 
+                                    record_info(fields, large_data)),
+        Recs = ?SRV:query_page(Server, 0, 10, "shm", Meta),
+        Count = ?SRV:database_info(Server, document_count),
+        [?_assertEqual(3, Count)
+        ,?_assertEqual(lists:duplicate(3, Data), 
+                       [D || #large_data{data = D} <- Recs])]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+%% With a small ring, short replies are passed through the ring and
+%% replies and requests, which do not fit, are passed through the pipe.
+shm_small_ring_gen() ->
+    Path = testdb_path(shm_small_ring),
+    Params = [write, create, overwrite, {shm, 4096}],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Data = binary:copy(<<"0123456789">>, 1000),
+        DocId1 = ?SRV:add_document(Server, [#x_term{value = "small"}]),
+        DocId2 = ?SRV:add_document(Server, [#x_term{value = "large"}, 
+                                            #x_data{value = Data}]),
+        Meta = xapian_record:record(large_data, 
+                                    record_info(fields, large_data)),
+        [Small] = ?SRV:query_page(Server, 0, 10, "small", Meta),
+        [Large] = ?SRV:query_page(Server, 0, 10, "large", Meta),
+        Count = ?SRV:database_info(Server, document_count),
+        [?_assertEqual(2, Count)
+        ,?_assertEqual({1, 2}, {DocId1, DocId2})
+        ,?_assertEqual(<<>>, Small#large_data.data)
+        ,?_assertEqual(Data, Large#large_data.data)]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+%% A generous time budget does not change results.
+deadline_gen() ->
+    Path = testdb_path(deadline),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Terms = [#x_term{value = integer_to_list(X)} || X <- lists:seq(1, 50)],
+        [?SRV:add_document(Server, [#x_term{value = "deadline"} | Terms])
+         || _ <- lists:seq(1, 10)],
+        Meta = xapian_record:record(document, record_info(fields, document)),
+        Recs = ?SRV:query_page(Server, 0, 100, "deadline", Meta, 
+                               [{timeout, 60000}]),
+
+        EnquireRes = ?SRV:enquire(Server, #x_enquire{value = "deadline", 
+                                                     timeout = 60000}),
+        MSetRes = ?SRV:match_set(Server, EnquireRes),
+        MSetInfo = ?SRV:mset_info(Server, MSetRes, [size, is_truncated]),
+
+        TermMeta = xapian_term_record:record(term, record_info(fields, term)),
+        Table = xapian_term_qlc:document_term_table(Server, 1, TermMeta, 
+                    [{page_size, 7}, {timeout, 60000}]),
+        TermCount = length(qlc:e(Table)),
+        [?_assertEqual(10, length(Recs))
+        ,?_assertEqual([{size, 10}, {is_truncated, false}], MSetInfo)
+        ,?_assertEqual(51, TermCount)]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+%% A deadline, which has already passed, truncates the match.
+%% Real timeouts depend on the speed of the machine, so only the flag
+%% and the size of their results are checked against each other.
+expired_deadline_gen() ->
+    Path = testdb_path(expired_deadline),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        DocCount = 1000,
+        [?SRV:add_document(Server, [#x_term{value = "expired"}])
+         || _ <- lists:seq(1, DocCount)],
+        Expired = ?SRV:internal_test_run(Server, expired_deadline, 
+                                         ["expired", DocCount]),
+        [{size, ExpiredSize}, {is_truncated, IsExpired}] = Expired,
+
+        Meta = xapian_record:record(document, record_info(fields, document)),
+        PageRes = ?SRV:query_page(Server, 0, DocCount, "expired", Meta, 
+                                  [{timeout, 1}]),
+        {IsPageTruncated, Recs} = 
+            case PageRes of
+                {truncated, TruncatedRecs} -> {true, TruncatedRecs};
+                AllRecs                    -> {false, AllRecs}
+            end,
+
+        EnquireRes = ?SRV:enquire(Server, #x_enquire{value = "expired", 
+                                                     timeout = 1}),
+        MSetRes = ?SRV:match_set(Server, EnquireRes),
+        [{size, Size}, {is_truncated, IsTruncated}] = 
+            ?SRV:mset_info(Server, MSetRes, [size, is_truncated]),
+        [?_assert(IsExpired)
+        ,?_assert(ExpiredSize < DocCount)
+        ,?_assertEqual(IsPageTruncated, length(Recs) < DocCount)
+        ,?_assertEqual(IsTruncated, Size < DocCount)]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+-record(compact_doc, {docid, data, all_terms_pos, all_values}).
+
+%% The compact encoding returns the same records.
+compact_encoding_gen() ->
+    Path = testdb_path(compact_encoding),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Doc = [ #x_term{value = "compact", position = [1, 200, 70000]}
+              , #x_term{value = "encoding", position = [5]}
+              , #x_value{slot = 1, value = "value"}
+              , #x_data{value = binary:copy(<<"d">>, 300)}
+              ],
+        DocId = ?SRV:add_document(Server, Doc),
+        Fields = record_info(fields, compact_doc),
+        Meta1 = xapian_record:record(compact_doc, Fields),
+        Meta2 = xapian_record:record(compact_doc, Fields, [compact]),
+        Recs1 = ?SRV:query_page(Server, 0, 10, "compact", Meta1),
+        Recs2 = ?SRV:query_page(Server, 0, 10, "compact", Meta2),
+
+        TermFields = record_info(fields, term_ext),
+        TermMeta1 = xapian_term_record:record(term_ext, TermFields),
+        TermMeta2 = xapian_term_record:record(term_ext, TermFields, [compact]),
+        Terms1 = qlc:e(xapian_term_qlc:document_term_table(Server, DocId, 
+                                                           TermMeta1)),
+        Terms2 = qlc:e(xapian_term_qlc:document_term_table(Server, DocId, 
+                                                           TermMeta2)),
+        [?_assertEqual(Recs1, Recs2)
+        ,?_assertMatch([#compact_doc{docid = DocId}], Recs2)
+        ,?_assertEqual(Terms1, Terms2)
+        ,?_assertMatch([#term_ext{value = <<"compact">>, 
+                                  positions = [1, 200, 70000]}|_], Terms2)]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+resource_limits_gen() ->
+    Path = testdb_path(resource_limits),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Con = xapian_resource:bool_weight(),
+        %% The budget is enough for one weight.
+        Info1 = ?SRV:set_resource_limits(Server, [{max_memory, 300}]),
+        Weight1 = ?SRV:create_resource(Server, Con),
+        Weight2 = ?SRV:create_resource(Server, Con),
+        Info2 = ?SRV:resource_limits(Server),
+        Enquire = #x_enquire{value = "erlang", weighting_scheme = Weight1},
+        Error = 
+            try ?SRV:enquire(Server, Enquire), ok
+            catch error:Reason -> Reason end,
+        %% Evicted resources are released as usual.
+        ?SRV:release_resource(Server, Weight1),
+        ?SRV:release_resource(Server, Weight2),
+        Info3 = ?SRV:set_resource_limits(Server, []),
+        [?_assertEqual(300, proplists:get_value(max_memory, Info1))
+        ,?_assertEqual(1, proplists:get_value(count, Info2))
+        ,?_assertEqual(1, proplists:get_value(evicted_by_budget, Info2))
+        ,?_assertMatch(#x_error{type = <<"ElementEvictedDriverError">>}, Error)
+        ,?_assertEqual(0, proplists:get_value(max_memory, Info3))
+        ,?_assertEqual(0, proplists:get_value(count, Info3))]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+%% An idle resource is evicted, when it is used after the TTL,
+%% even if no resources were created since then.
+resource_idle_ttl_gen() ->
+    Path = testdb_path(resource_idle_ttl),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Con = xapian_resource:bool_weight(),
+        Info1 = ?SRV:set_resource_limits(Server, [{idle_ttl, 100}]),
+        Weight = ?SRV:create_resource(Server, Con),
+        Enquire = #x_enquire{value = "erlang", weighting_scheme = Weight},
+        %% It is used before the TTL.
+        Enquire1 = ?SRV:enquire(Server, Enquire),
+        timer:sleep(300),
+        Error = 
+            try ?SRV:enquire(Server, Enquire), ok
+            catch error:Reason -> Reason end,
+        Info2 = ?SRV:resource_limits(Server),
+        ?SRV:release_resource(Server, Weight),
+        ?SRV:release_resource(Server, Enquire1),
+        Info3 = ?SRV:set_resource_limits(Server, []),
+        [?_assertEqual(100, proplists:get_value(idle_ttl, Info1))
+        ,?_assert(is_reference(Enquire1))
+        ,?_assertMatch(#x_error{type = <<"ElementEvictedDriverError">>}, Error)
+        %% The enquire resource is idle too.
+        ,?_assertEqual(2, proplists:get_value(evicted_by_ttl, Info2))
+        ,?_assertEqual(0, proplists:get_value(count, Info2))
+        ,?_assertEqual(0, proplists:get_value(idle_ttl, Info3))]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+resource_info_gen() ->
+    Path = testdb_path(resource_info),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Info1 = ?SRV:resource_info(Server),
+        Enquire = ?SRV:enquire(Server, "erlang"),
+        MSet1 = ?SRV:match_set(Server, Enquire),
+        MSet2 = ?SRV:match_set(Server, Enquire),
+        Info2 = ?SRV:resource_info(Server),
+        Types = proplists:get_value(types, Info2),
+        ?SRV:release_resource(Server, MSet1),
+        ?SRV:release_resource(Server, MSet2),
+        ?SRV:release_resource(Server, Enquire),
+        [?_assertEqual([], proplists:get_value(types, Info1))
+        ,?_assertEqual(0, proplists:get_value(oldest_age, Info1))
+        ,?_assertMatch({_, 2, _}, 
+                       lists:keyfind(<<"Resource::MatchSet">>, 1, Types))
+        ,?_assertMatch({_, 1, _}, 
+                       lists:keyfind(<<"Resource::Enquire">>, 1, Types))]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+%% Both servers get the same stopper from the process-wide registry.
+%% It stays alive, while at least one server uses it.
+shared_stopper_gen() ->
+    Params = [write, create, overwrite,
+              #x_stemmer{language = <<"english">>}],
+    {ok, Server1} = ?SRV:start_link(testdb_path(shared_stopper1), Params),
+    {ok, Server2} = ?SRV:start_link(testdb_path(shared_stopper2), Params),
+    Meta = xapian_term_record:record(term, record_info(fields, term)),
+    Con = xapian_resource:simple_stopper(["my", "as", "the", "a", "an"]),
+    try
+        Stopper1 = ?SRV:create_resource(Server1, Con),
+        Stopper2 = ?SRV:create_resource(Server2, Con),
+        ?SRV:release_resource(Server2, Stopper2),
+        Document =
+            [ #x_term_generator{stopper = Stopper1}
+            , #x_text{value = "My text is inside the #x_text record."} 
+            ],
+        DocId = ?SRV:add_document(Server1, Document),
+        TermTable = xapian_term_qlc:document_term_table(Server1, DocId, Meta),
+        Terms = qlc:e(qlc:q([Val || #term{value = Val} <- TermTable])),
+        ?SRV:release_resource(Server1, Stopper1),
+        [?_assert(lists:member(<<"Ztext">>, Terms))
+        ,?_assertNot(lists:member(<<"Zmy">>, Terms))]
+    after
+        ?SRV:close(Server1),
+        ?SRV:close(Server2)
+    end.
+
+
+query_cache_gen() ->
+    Path = testdb_path(query_cache),
+    {ok, Writer} = ?SRV:start_link(Path, [write, create, overwrite]),
+    ?SRV:add_document(Writer, [#x_term{value = "erlang"}]),
+    ?SRV:close(Writer),
+
+    {ok, Server} = ?SRV:start_link(Path, []),
+    try
+        Meta = xapian_record:record(document, record_info(fields, document)),
+        Query = #x_query_string{value = "erl*", 
+                                features = [default, wildcard]},
+        Recs1 = ?SRV:query_page(Server, 0, 10, Query, Meta),
+        Recs2 = ?SRV:query_page(Server, 0, 10, Query, Meta),
+        Info1 = ?SRV:query_cache_info(Server),
+        Info2 = ?SRV:set_query_cache_capacity(Server, 0),
+        [?_assertEqual(Recs1, Recs2)
+        ,?_assertMatch([#document{docid = 1}], Recs2)
+        ,?_assertEqual(1, proplists:get_value(hits, Info1))
+        ,?_assertEqual(1, proplists:get_value(misses, Info1))
+        ,?_assertEqual(1, proplists:get_value(size, Info1))
+        ,?_assertEqual(0, proplists:get_value(size, Info2))
+        ,?_assertEqual(1, proplists:get_value(evictions, Info2))]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+mset_cache_gen() ->
+    Path = testdb_path(mset_cache),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Info0 = ?SRV:mset_cache_info(Server),
+        ?SRV:set_mset_cache_capacity(Server, 16),
+        ?SRV:add_document(Server, [#x_text{value = "cat"}]),
+
+        Meta = xapian_record:record(document, record_info(fields, document)),
+        Query = #x_query_string{value = "cat"},
+        Enquire = #x_enquire{value = Query},
+        ?SRV:match_set(Server, Enquire),
+        ?SRV:match_set(Server, Enquire),
+        Recs1 = ?SRV:query_page(Server, 0, 10, Query, Meta),
+        Recs2 = ?SRV:query_page(Server, 0, 10, Query, Meta),
+        Info1 = ?SRV:mset_cache_info(Server),
+
+        %% A change of the database drops cached results.
+        ?SRV:add_document(Server, [#x_text{value = "cat"}]),
+        Info2 = ?SRV:mset_cache_info(Server),
+        Recs3 = ?SRV:query_page(Server, 0, 10, Query, Meta),
+        [?_assertEqual(0, proplists:get_value(capacity, Info0))
+        ,?_assertEqual(Recs1, Recs2)
+        ,?_assertEqual(2, proplists:get_value(hits, Info1))
+        ,?_assertEqual(2, proplists:get_value(misses, Info1))
+        ,?_assertEqual(2, proplists:get_value(size, Info1))
+        ,?_assertEqual(0, proplists:get_value(size, Info2))
+        ,?_assertEqual(2, length(Recs3))]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+%% The next page is selected by the cursor of the previous one.
+search_after_gen() ->
+    Path = testdb_path(search_after),
+    Params = [write, create, overwrite,
+        #x_value_name{slot = 1, name = title}],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Titles = ["d", "b", "e", "a", "c"],
+        [?SRV:add_document(Server, [#x_term{value = "page"},
+                                    #x_value{slot = title, value = T}])
+         || T <- Titles],
+        Order = #x_sort_order{type = value, value = title},
+        Enquire = #x_enquire{order = Order, value = "page"},
+        AllIds = all_record_ids(Server, Enquire),
+
+        PageIdsFn = fun(Cursor) ->
+            MSet = ?SRV:match_set(Server, #x_match_set{enquire = Enquire,
+                max_items = 2, search_after = Cursor}),
+            Meta = xapian_record:record(document,
+                                        record_info(fields, document)),
+            Table = xapian_mset_qlc:table(Server, MSet, Meta),
+            Ids = qlc:e(qlc:q([Id || #document{docid=Id} <- Table])),
+            Next = ?SRV:mset_info(Server, MSet, cursor),
+            ?SRV:release_resource(Server, MSet),
+            {Ids, Next}
+            end,
+        {Page1, Cursor1} = PageIdsFn(undefined),
+        {Page2, Cursor2} = PageIdsFn(Cursor1),
+        {Page3, _}       = PageIdsFn(Cursor2),
+
+        %% A relevance order has no cursors.
+        RelMSet = ?SRV:match_set(Server, #x_match_set{
+            enquire = #x_enquire{value = "page"}, max_items = 2}),
+        RelCursor = ?SRV:mset_info(Server, RelMSet, cursor),
+        [?_assertEqual([4, 2, 5, 1, 3], AllIds)
+        ,?_assertEqual(AllIds, Page1 ++ Page2 ++ Page3)
+        ,?_assertEqual(undefined, RelCursor)
+        ,?_assertError(#x_server_error{reason=badarg},
+                       PageIdsFn(<<"bad">>))]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+count_gen() ->
+    Path = testdb_path(count),
+    Params = [write, create, overwrite],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Docs = [["cat"], ["dog"], ["cat", "dog"], ["bird"]],
+        [?SRV:add_document(Server, [#x_term{value = T} || T <- Terms])
+         || Terms <- Docs],
+        CatOrDog = #x_query{op = 'OR', value = ["cat", "dog"]},
+        CatAndDog = #x_query{op = 'AND', value = ["cat", "dog"]},
+        CatNotDog = #x_query{op = 'AND NOT', value = ["cat", "dog"]},
+        Bounds = ?SRV:count(Server, CatOrDog, []),
+        CatAndFish = #x_query{op = 'AND', value = ["cat", "fish"]},
+        Counts = [?SRV:count(Server, Q)
+                  || Q <- ["cat", "fish", CatOrDog, CatAndDog, CatNotDog, 
+                           CatAndFish]],
+        [?_assertEqual([2, 0, 3, 1, 1, 0], Counts)
+        ,?_assertEqual(2, proplists:get_value(matches_lower_bound, Bounds))
+        ,?_assertEqual(4, proplists:get_value(matches_upper_bound, Bounds))]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+
+%% Queries without weights are matched with `BoolWeight' in docid order.
+filter_query_gen() ->
+    Path = testdb_path(filter_query),
+    Params = [write, create, overwrite,
+        #x_value_name{slot = 1, name = color}],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Docs = [{"red", "cat"}, {"blue", "cat dog"}, {"red", "dog"},
+                {"red", "cat cat"}],
+        [?SRV:add_document(Server, [#x_value{slot = color, value = C},
+                                    #x_text{value = T}])
+         || {C, T} <- Docs],
+        Red = #x_query_value{op = equal, slot = color, value = "red"},
+        Filter = #x_enquire{value = Red},
+        Mixed = #x_enquire{value = #x_query{value = ["cat", Red]}},
+        FilterIds = all_record_ids(Server, Filter),
+        MixedIds = all_record_ids(Server, Mixed),
+        %% Cursors are available for docid-ordered results.
+        MSet = ?SRV:match_set(Server, #x_match_set{enquire = Filter,
+                                                   max_items = 1}),
+        Cursor = ?SRV:mset_info(Server, MSet, cursor),
+        [?_assertEqual([1, 3, 4], FilterIds)
+        ,?_assertEqual([1, 4], lists:sort(MixedIds))
+        ,?_assertMatch(<<_/binary>>, Cursor)]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+filter_cache_gen() ->
+    Path = testdb_path(filter_cache),
+    Params = [write, create, overwrite,
+        #x_value_name{slot = 1, name = color}],
+    {ok, Server} = ?SRV:start_link(Path, Params),
+    try
+        Docs = [{"red", "cat"}, {"blue", "cat dog"}, {"red", "dog"},
+                {"red", "cat cat"}],
+        [?SRV:add_document(Server, [#x_value{slot = color, value = C},
+                                    #x_text{value = T}])
+         || {C, T} <- Docs],
+        Info0 = ?SRV:set_filter_cache_capacity(Server, 8),
+        Red = #x_query_value{op = equal, slot = color, value = "red"},
+        Query = #x_query{op = 'FILTER', value = ["cat", Red]},
+        Ids1 = all_record_ids(Server, #x_enquire{value = Query}),
+        Ids2 = all_record_ids(Server, #x_enquire{value = Query}),
+        Info1 = ?SRV:filter_cache_info(Server),
+
+        %% A change of the database drops cached filters.
+        ?SRV:add_document(Server, [#x_value{slot = color, value = "red"},
+                                   #x_text{value = "cat"}]),
+        Info2 = ?SRV:filter_cache_info(Server),
+        Ids3 = all_record_ids(Server, #x_enquire{value = Query}),
+
+        %% The filter does not fit the budget, it is evicted.
+        Memory3 = proplists:get_value(memory, 
+                                      ?SRV:filter_cache_info(Server)),
+        Info4 = ?SRV:set_filter_cache_max_memory(Server, Memory3 - 1),
+        Ids4 = all_record_ids(Server, #x_enquire{value = Query}),
+        Info5 = ?SRV:filter_cache_info(Server),
+
+        %% A filter with a query string is cached too.
+        ?SRV:set_filter_cache_max_memory(Server, 0),
+        Dog = #x_query{op = 'FILTER', 
+                       value = ["cat", #x_query_string{value = "dog"}]},
+        Ids6 = all_record_ids(Server, #x_enquire{value = Dog}),
+        Ids7 = all_record_ids(Server, #x_enquire{value = Dog}),
+        Info7 = ?SRV:filter_cache_info(Server),
+        [?_assertEqual(0, proplists:get_value(size, Info0))
+        ,?_assertEqual([1, 4], lists:sort(Ids1))
+        ,?_assertEqual(Ids1, Ids2)
+        ,?_assertEqual(1, proplists:get_value(hits, Info1))
+        ,?_assertEqual(1, proplists:get_value(misses, Info1))
+        ,?_assertEqual(1, proplists:get_value(size, Info1))
+        ,?_assert(proplists:get_value(memory, Info1) > 0)
+        ,?_assertEqual(0, proplists:get_value(size, Info2))
+        ,?_assertEqual([1, 4, 5], lists:sort(Ids3))
+        ,?_assertEqual(Memory3 - 1, proplists:get_value(max_memory, Info4))
+        ,?_assertEqual(0, proplists:get_value(size, Info4))
+        ,?_assertEqual(0, proplists:get_value(memory, Info4))
+        ,?_assertEqual(Ids3, Ids4)
+        ,?_assertEqual(0, proplists:get_value(size, Info5))
+        ,?_assertEqual([2], Ids6)
+        ,?_assertEqual(Ids6, Ids7)
+        ,?_assertEqual(1, proplists:get_value(size, Info7))
+        ,?_assertEqual(proplists:get_value(hits, Info5) + 1, 
+                       proplists:get_value(hits, Info7))]
+    after
+        ?SRV:close(Server)
+    end.
+
 %% http://trac.xapian.org/wiki/FAQ/ExtraWeight
 extra_weight_gen() ->
     Path = testdb_path(extra_weight),
@@ -2766,6 +3520,68 @@ multi_docid_gen() ->
     ].
 
 
+%% The fan-out search finds the same documents as the serial one.
+%% Weights can differ, because shards have their own statistics.
+-record(shard_doc, {docid, rank, weight, percent}).
+
+shard_search_gen() ->
+    Path1 = #x_database{name=shard1, path=testdb_path(shard1)},
+    Path2 = #x_database{name=shard2, path=testdb_path(shard2)},
+    Params = [write, create, overwrite],
+    {ok, Server1} = ?SRV:start_link(Path1, Params),
+    {ok, Server2} = ?SRV:start_link(Path2, Params),
+    %% Documents of different lengths have different weights.
+    [?SRV:add_document(Server1, shard_terms(N)) || N <- lists:seq(0, 2)],
+    [?SRV:add_document(Server2, shard_terms(N)) || N <- lists:seq(3, 4)],
+    ?SRV:close(Server1),
+    ?SRV:close(Server2),
+
+    {ok, Server} = ?SRV:start_link([Path1, Path2], []),
+    try
+        Meta = xapian_record:record(shard_doc, 
+                                    record_info(fields, shard_doc)),
+        Filter = #x_query_scale_weight{value = "test", factor = 0.0},
+        SerialFilter   = ?SRV:query_page(Server, 0, 10, Filter, Meta),
+        SerialPage     = ?SRV:query_page(Server, 1, 3, Filter, Meta),
+        SerialRanked   = ?SRV:query_page(Server, 0, 10, "test", Meta),
+        Info1          = ?SRV:set_shard_search_threads(Server, 2),
+        ParallelFilter = ?SRV:query_page(Server, 0, 10, Filter, Meta),
+        ParallelPage   = ?SRV:query_page(Server, 1, 3, Filter, Meta),
+        %% Weighted queries are matched serially by default.
+        StrictRanked   = ?SRV:query_page(Server, 0, 10, "test", Meta),
+        Info2          = ?SRV:shard_search_info(Server),
+        Info3          = ?SRV:set_shard_search_threads(Server, 2, 
+                                                       [{local_weights, true}]),
+        LocalRanked    = ?SRV:query_page(Server, 0, 10, "test", Meta),
+        Info4          = ?SRV:set_shard_search_threads(Server, 0),
+        LocalWeights   = elements(#shard_doc.weight, LocalRanked),
+        [?_assertEqual(SerialFilter, ParallelFilter)
+        ,?_assertEqual(SerialPage, ParallelPage)
+        ,?_assertEqual(5, length(ParallelFilter))
+        ,?_assertEqual(3, length(ParallelPage))
+        ,?_assertEqual(SerialRanked, StrictRanked)
+        %% Local weights give the same documents, ordered by their weights.
+        ,?_assertEqual(lists:sort(elements(#shard_doc.docid, SerialRanked)),
+                       lists:sort(elements(#shard_doc.docid, LocalRanked)))
+        ,?_assertEqual(lists:reverse(lists:sort(LocalWeights)), LocalWeights)
+        ,?_assertEqual([{threads, 2}, {shards, 2}, 
+                        {local_weights, false}, {searches, 0}], Info1)
+        ,?_assertEqual([{threads, 2}, {shards, 2}, 
+                        {local_weights, false}, {searches, 2}], Info2)
+        ,?_assertEqual([{threads, 2}, {shards, 2}, 
+                        {local_weights, true}, {searches, 2}], Info3)
+        ,?_assertEqual([{threads, 0}, {shards, 2}, 
+                        {local_weights, false}, {searches, 3}], Info4)]
+    after
+        ?SRV:close(Server)
+    end.
+
+
+shard_terms(N) ->
+    [#x_term{value = "test"} 
+    |[#x_term{value = "pad" ++ integer_to_list(X)} || X <- lists:seq(1, N)]].
+
+
 elements(Pos, Records) ->
     [erlang:element(Pos, Rec) || Rec <- Records].
 